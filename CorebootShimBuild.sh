@@ -1,13 +1,29 @@
 #!/bin/bash
 BuildTarget="DEBUG"
+BuildArch="IA32"
 
 export WORKSPACE=$(cd `dirname $0`; pwd)
 echo $WORKSPACE
 
 while [ $# -gt 0 ]; do
+  case "$1" in
+    -a|--arch)
+      BuildArch="$2"
+      shift
+      ;;
+  esac
   shift
 done
 
+case "$BuildArch" in
+  IA32|X64)
+    ;;
+  *)
+    echo "Unsupported architecture $BuildArch, use IA32 or X64"
+    exit 1
+    ;;
+esac
+
 cd $WORKSPACE/CorebootUplShimPkg
-make cleanall
-make
+make cleanall ARCH=$BuildArch
+make ARCH=$BuildArch
@@ -45,8 +45,19 @@ typedef unsigned char BOOLEAN;
 typedef unsigned char UINT8;
 typedef char CHAR8;
 typedef signed char INT8;
+///
+/// The natural width of the build, MDE_CPU_X64 for the x86-64 flavor of the
+/// shim and MDE_CPU_IA32 for the i686 one.
+///
+#if defined (__x86_64__)
+#define MDE_CPU_X64
+typedef UINT64 UINTN;
+typedef INT64 intn;
+#else
+#define MDE_CPU_IA32
 typedef UINT32 UINTN;
 typedef INT32 intn;
+#endif
 typedef UINT64 ADDRESS;
 
 ///
@@ -195,7 +206,12 @@ typedef struct {
   //
 } HOB_MEMORY_ALLOCATION;
 
+#if defined (MDE_CPU_X64)
+#define MAX_BIT      0x8000000000000000ULL
+#else
 #define MAX_BIT      0x80000000
+#endif
+
 //
 // Return the maximum of two operands.
 // This macro returns the maximum of two operand specified by a and b.
@@ -212,6 +228,15 @@ typedef struct {
 #define MIN(a, b)                       \
   (((a) < (b)) ? (a) : (b))
 
+///
+/// Variable argument lists, as the compiler passes them.
+///
+typedef __builtin_va_list  VA_LIST;
+
+#define VA_START(Marker, Parameter)  __builtin_va_start (Marker, Parameter)
+#define VA_ARG(Marker, TYPE)         ((sizeof (TYPE) < sizeof (UINTN)) ? (TYPE)(__builtin_va_arg (Marker, UINTN)) : (TYPE)(__builtin_va_arg (Marker, TYPE)))
+#define VA_END(Marker)               __builtin_va_end (Marker)
+
 ///
 /// Set the upper bit to indicate EFI Error.
 ///
@@ -305,6 +330,9 @@ typedef struct {
 #define SIZE_64KB                     0x00010000
 #define SIZE_512KB                    0x00080000
 #define SIZE_1MB                      0x00100000
+#define SIZE_2MB                      0x00200000
+#define SIZE_4MB                      0x00400000
+#define SIZE_1GB                      0x40000000
 #define PAGE_SIZE                     SIZE_4KB
 #define PAGE_MASK                     0xFFF
 #define PAGE_SHIFT                    12
@@ -13,6 +13,7 @@
 #define CBMEM_ID_FMAP           0x464d4150
 #define CBMEM_ID_CBFS_RO_MCACHE 0x524d5346
 #define CBMEM_ID_FSP_RUNTIME    0x52505346
+#define CBMEM_ID_CONSOLE        0x434f4e53
 #define MCACHE_MAGIC_FILE       0x454c4946
 #define MCACHE_MAGIC_FULL       0x4c4c5546
 #define MCACHE_MAGIC_END        0x444e4524
@@ -106,6 +107,18 @@ struct cbmem_root {
   struct cbmem_entry    entries[0];
 };
 
+//
+// The coreboot CBMEM console, body is a ring once the overflow flag is set.
+//
+#define CBMC_CURSOR_MASK  ((1U << 28) - 1)
+#define CBMC_OVERFLOW     (1U << 31)
+
+struct cbmem_console {
+  UINT32    size;
+  UINT32    cursor;
+  UINT8     body[0];
+};
+
 struct cbuint64 {
   UINT32    lo;
   UINT32    hi;
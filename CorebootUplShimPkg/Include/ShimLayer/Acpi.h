@@ -0,0 +1,104 @@
+/** @file
+  The subset of ACPI table definitions used by the shim layer.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  @par Revision Reference:
+  ACPI Version 6.4.
+
+**/
+
+#ifndef __SHIM_ACPI_H__
+#define __SHIM_ACPI_H__
+
+#define ACPI_RSDP_SIGNATURE  0x2052545020445352ULL   // "RSD PTR "
+#define ACPI_MADT_SIGNATURE  SIGNATURE_32 ('A', 'P', 'I', 'C')
+#define ACPI_FADT_SIGNATURE  SIGNATURE_32 ('F', 'A', 'C', 'P')
+
+#define ACPI_MADT_PROCESSOR_LOCAL_APIC    0x00
+#define ACPI_MADT_PROCESSOR_LOCAL_X2APIC  0x09
+#define ACPI_MADT_PROCESSOR_ENABLED       BIT0
+
+#define ACPI_PM_TIMER_FREQUENCY           3579545
+
+#pragma pack(1)
+
+typedef struct {
+  UINT64    Signature;
+  UINT8     Checksum;
+  UINT8     OemId[6];
+  UINT8     Revision;
+  UINT32    RsdtAddress;
+  UINT32    Length;
+  UINT64    XsdtAddress;
+  UINT8     ExtendedChecksum;
+  UINT8     Reserved[3];
+} ACPI_RSDP;
+
+typedef struct {
+  UINT32    Signature;
+  UINT32    Length;
+  UINT8     Revision;
+  UINT8     Checksum;
+  UINT8     OemId[6];
+  UINT64    OemTableId;
+  UINT32    OemRevision;
+  UINT32    CreatorId;
+  UINT32    CreatorRevision;
+} ACPI_DESCRIPTION_HEADER;
+
+typedef struct {
+  ACPI_DESCRIPTION_HEADER    Header;
+  UINT32                     LocalApicAddress;
+  UINT32                     Flags;
+} ACPI_MADT_HEADER;
+
+typedef struct {
+  UINT8    Type;
+  UINT8    Length;
+} ACPI_MADT_SUBTABLE_HEADER;
+
+typedef struct {
+  UINT8     Type;
+  UINT8     Length;
+  UINT8     AcpiProcessorUid;
+  UINT8     ApicId;
+  UINT32    Flags;
+} ACPI_MADT_LOCAL_APIC;
+
+typedef struct {
+  UINT8     Type;
+  UINT8     Length;
+  UINT8     Reserved[2];
+  UINT32    X2ApicId;
+  UINT32    Flags;
+  UINT32    AcpiProcessorUid;
+} ACPI_MADT_LOCAL_X2APIC;
+
+///
+/// Only the FADT fields up to PM_TMR_BLK are needed.
+///
+typedef struct {
+  ACPI_DESCRIPTION_HEADER    Header;
+  UINT32                     FirmwareCtrl;
+  UINT32                     Dsdt;
+  UINT8                      Reserved0;
+  UINT8                      PreferredPmProfile;
+  UINT16                     SciInt;
+  UINT32                     SmiCmd;
+  UINT8                      AcpiEnable;
+  UINT8                      AcpiDisable;
+  UINT8                      S4BiosReq;
+  UINT8                      PstateCnt;
+  UINT32                     Pm1aEvtBlk;
+  UINT32                     Pm1bEvtBlk;
+  UINT32                     Pm1aCntBlk;
+  UINT32                     Pm1bCntBlk;
+  UINT32                     Pm2CntBlk;
+  UINT32                     PmTmrBlk;
+} ACPI_FADT_HEADER;
+
+#pragma pack()
+
+#endif // __SHIM_ACPI_H__
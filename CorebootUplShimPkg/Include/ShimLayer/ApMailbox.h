@@ -0,0 +1,64 @@
+/** @file
+  This file defines the AP mailbox the shim layer parks the application
+  processors in, and the HOB describing it to the payload.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Each AP owns one SHIM_AP_MAILBOX and spins on its Command field, using
+  MONITOR/MWAIT when SHIM_AP_MAILBOX_FLAG_MWAIT is reported and PAUSE otherwise.
+  To dispatch an AP the payload writes WakeupVector (and optionally Argument)
+  first and Command last. The AP acknowledges by clearing Command to
+  SHIM_AP_MAILBOX_COMMAND_NOOP and then jumps to WakeupVector with:
+    - interrupts disabled, in 32-bit protected mode with paging off, also
+      when the BSP entered a 64-bit payload,
+    - flat code/data selectors from a GDT living in the reserved region,
+    - ESI holding the address of its own mailbox,
+    - no usable stack, the wake-up code must set up its own.
+  WakeupVector must therefore point to 32-bit flat code below 4GB, only its
+  low 32 bits are used. The whole region (park loop, GDT and mailboxes) is
+  reported as ReservedMemoryType so it survives the payload's memory map.
+
+**/
+
+#ifndef __AP_MAILBOX_H__
+#define __AP_MAILBOX_H__
+
+#define SHIM_AP_MAILBOX_COMMAND_NOOP    0
+#define SHIM_AP_MAILBOX_COMMAND_WAKEUP  1
+
+#define SHIM_AP_MAILBOX_FLAG_MWAIT      BIT0
+#define SHIM_AP_MAILBOX_FLAG_X2APIC     BIT1
+
+#define SHIM_AP_MAILBOX_INFO_REVISION   1
+
+#pragma pack(1)
+
+///
+/// One mailbox per AP, a cache line each so parked APs do not share
+/// a monitored line.
+///
+typedef struct {
+  volatile UINT32    Command;
+  UINT32             ApicId;
+  volatile UINT64    WakeupVector;
+  volatile UINT64    Argument;
+  UINT8              Reserved[40];
+} SHIM_AP_MAILBOX;
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  UINT16                              MailboxSize;
+  UINT32                              Flags;
+  UINT32                              ApCount;
+  UINT32                              BspApicId;
+  ADDRESS                             MailboxBase;
+  ADDRESS                             RegionBase;
+  UINT64                              RegionSize;
+} SHIM_AP_MAILBOX_INFO;
+
+#pragma pack()
+
+extern GUID gShimApMailboxInfoGuid;
+
+#endif // __AP_MAILBOX_H__
@@ -0,0 +1,55 @@
+/** @file
+  This file defines the HOB describing the .upld.* extra sections the shim
+  layer leaves compressed.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  A payload marks an extra section to stay compressed with the standard ELF
+  SHF_COMPRESSED flag, the section then starts with an ELF compression
+  header. The shim does not expand such a section: its UNIVERSAL_PAYLOAD_EXTRA_DATA
+  entry covers the compressed data only, and an entry with the same
+  Identifier in this HOB tells how to expand it. A payload that never uses
+  the section never pays for its decompression.
+
+**/
+
+#ifndef __COMPRESSED_EXTRA_DATA_H__
+#define __COMPRESSED_EXTRA_DATA_H__
+
+///
+/// Algorithm values, the ELF ch_type of the section.
+///
+#define SHIM_COMPRESSED_EXTRA_DATA_ZLIB  1
+#define SHIM_COMPRESSED_EXTRA_DATA_ZSTD  2
+///
+/// The LZMA format of the EDK2 LzmaCustomDecompressLib, taken from the OS
+/// specific ch_type range as ELF defines no LZMA value.
+///
+#define SHIM_COMPRESSED_EXTRA_DATA_LZMA  0x60000001
+
+#define SHIM_COMPRESSED_EXTRA_DATA_REVISION  1
+
+#pragma pack(1)
+
+typedef struct {
+  CHAR8      Identifier[16];
+  ADDRESS    Base;
+  UINT64     Size;
+  UINT64     DecompressedSize;
+  UINT64     Alignment;
+  UINT32     Algorithm;
+  UINT32     Reserved;
+} SHIM_COMPRESSED_EXTRA_DATA_ENTRY;
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  UINT32                              Count;
+  SHIM_COMPRESSED_EXTRA_DATA_ENTRY    Entry[0];
+} SHIM_COMPRESSED_EXTRA_DATA;
+
+#pragma pack()
+
+extern GUID gShimCompressedExtraDataGuid;
+
+#endif // __COMPRESSED_EXTRA_DATA_H__
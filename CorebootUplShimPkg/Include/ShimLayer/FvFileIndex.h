@@ -0,0 +1,49 @@
+/** @file
+  This file defines the HOB indexing the FFS files of a payload firmware
+  volume.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  The shim walks each firmware volume it reports in an FV HOB once and
+  publishes one such HOB per volume, matched to it by FvBase. Entry[] holds
+  the valid, non-pad files of the volume ordered by the 16 bytes of Name
+  compared as unsigned bytes, so a file is found with a binary search
+  instead of an FFS walk. Offset is relative to FvBase and points to the
+  FFS file header, Size includes that header.
+
+  The index of a volume with too many files for a single HOB is handed off
+  with a gShimLargeGuidHobGuid HOB instead, Header.Length is then MAX_UINT16
+  and Count gives the length.
+
+**/
+
+#ifndef __FV_FILE_INDEX_H__
+#define __FV_FILE_INDEX_H__
+
+#define SHIM_FV_FILE_INDEX_REVISION  1
+
+#pragma pack(1)
+
+typedef struct {
+  GUID                   Name;
+  UINT32                 Offset;
+  UINT32                 Size;
+  FV_FILETYPE            Type;
+  FFS_FILE_ATTRIBUTES    Attributes;
+  UINT16                 Reserved;
+} SHIM_FV_FILE_INDEX_ENTRY;
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  UINT32                              Count;
+  ADDRESS                             FvBase;
+  UINT64                              FvLength;
+  SHIM_FV_FILE_INDEX_ENTRY            Entry[0];
+} SHIM_FV_FILE_INDEX;
+
+#pragma pack()
+
+extern GUID gShimFvFileIndexGuid;
+
+#endif // __FV_FILE_INDEX_H__
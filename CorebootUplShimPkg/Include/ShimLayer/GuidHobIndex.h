@@ -0,0 +1,46 @@
+/** @file
+  This file defines the HOB indexing the GUID extension HOBs of the HOB list.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  The shim builds this HOB last, right before the handoff. Entry[] holds
+  one entry per GUID extension HOB of the list, this HOB included, ordered
+  by the 16 bytes of Name compared as unsigned bytes and then by Offset.
+  Offset is relative to the start of the HOB list, the PHIT HOB, so the
+  index stays valid when the list is copied. The HOBs with one GUID are
+  found with a binary search for the first entry with that Name, in HOB
+  list order.
+
+  The index covers the first HobListLength bytes of the HOB list, up to
+  the end of list HOB at the time it was built. A consumer must walk the
+  list past that point for the HOBs added later.
+
+  A HOB list with too many GUID HOBs for a single HOB gets no index.
+
+**/
+
+#ifndef __GUID_HOB_INDEX_H__
+#define __GUID_HOB_INDEX_H__
+
+#define SHIM_GUID_HOB_INDEX_REVISION  1
+
+#pragma pack(1)
+
+typedef struct {
+  GUID      Name;
+  UINT32    Offset;
+} SHIM_GUID_HOB_INDEX_ENTRY;
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  UINT32                              Count;
+  UINT32                              HobListLength;
+  SHIM_GUID_HOB_INDEX_ENTRY           Entry[0];
+} SHIM_GUID_HOB_INDEX;
+
+#pragma pack()
+
+extern GUID gShimGuidHobIndexGuid;
+
+#endif // __GUID_HOB_INDEX_H__
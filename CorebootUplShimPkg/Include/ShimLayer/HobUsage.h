@@ -0,0 +1,54 @@
+/** @file
+  This file defines the record the shim layer accounts the use of its HOB
+  region in.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  The HOB library keeps the record up to date in the shim data from the
+  HOB list creation on, the shim copies it to a HOB right before the
+  handoff. Signature lets a tool find either copy in a memory dump, the one
+  in the shim data tells how far a shim that never reached the handoff got.
+
+  HobCount[] and HobBytes[] account the HOBs of the list by HobType, index
+  0 counts the unused HOBs. HobListSize includes the end of list HOB.
+  FreeSize is the room left between the HOB list and the lowest page
+  allocation, MinFreeSize the least room there ever was. FailedHobCount and
+  FailedAllocationCount count the HOBs and page allocations the region had
+  no room for. PeakScratchSize is the largest decompression scratch buffer
+  the shim used.
+
+**/
+
+#ifndef __HOB_USAGE_H__
+#define __HOB_USAGE_H__
+
+#define SHIM_HOB_USAGE_SIGNATURE   0x4547415355424F48ULL // "HOBUSAGE"
+#define SHIM_HOB_USAGE_TYPE_COUNT  16
+
+#define SHIM_HOB_USAGE_REVISION  1
+
+#pragma pack(1)
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  UINT32                              Reserved;
+  UINT64                              Signature;
+  ADDRESS                             HobList;
+  UINT64                              HobListSize;
+  UINT64                              FreeSize;
+  UINT64                              MinFreeSize;
+  UINT64                              AllocatedSize;
+  UINT64                              PeakAllocatedSize;
+  UINT64                              PeakScratchSize;
+  UINT32                              FailedHobCount;
+  UINT32                              FailedAllocationCount;
+  UINT32                              HobCount[SHIM_HOB_USAGE_TYPE_COUNT];
+  UINT32                              HobBytes[SHIM_HOB_USAGE_TYPE_COUNT];
+} SHIM_HOB_USAGE;
+
+#pragma pack()
+
+extern GUID gShimHobUsageGuid;
+
+#endif // __HOB_USAGE_H__
@@ -0,0 +1,37 @@
+/** @file
+  This file defines the HOB handing off GUID data too large for a GUID HOB.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  A HOB is at most 64 KB long. The shim places larger GUID data in pages
+  of its own, reported as BootServicesData by a memory allocation HOB, and
+  builds this HOB in place of the GUID HOB: Name is the GUID the data would
+  have been tagged with, Base and Size locate the data. The data has the
+  format the GUID defines, as in a GUID HOB.
+
+  A consumer looks for the GUID HOB with that GUID first, then for a HOB of
+  this kind with that Name.
+
+**/
+
+#ifndef __LARGE_GUID_HOB_H__
+#define __LARGE_GUID_HOB_H__
+
+#define SHIM_LARGE_GUID_HOB_REVISION  1
+
+#pragma pack(1)
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  UINT32                              Reserved;
+  GUID                                Name;
+  ADDRESS                             Base;
+  UINT64                              Size;
+} SHIM_LARGE_GUID_HOB;
+
+#pragma pack()
+
+extern GUID gShimLargeGuidHobGuid;
+
+#endif // __LARGE_GUID_HOB_H__
@@ -0,0 +1,41 @@
+/** @file
+  This file defines the HOB describing the page tables the shim layer hands
+  off to a 64-bit payload with.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  A 64-bit (ELFCLASS64) payload is entered in long mode with the HOB list
+  in both RCX and RDI, interrupts disabled, a 16-byte aligned stack with
+  32 bytes of shadow space, and CR3 set to Cr3. The tables identity map the
+  first 2^PhysicalAddressBits bytes of the address space, read/write and
+  executable, with 1GB pages when SHIM_PAGE_TABLE_FLAG_1G_PAGES is set and
+  2MB pages otherwise. The pages [Base, Base + Size) hold nothing but these
+  tables, the payload may keep or extend them instead of building its own.
+
+**/
+
+#ifndef __PAGE_TABLE_H__
+#define __PAGE_TABLE_H__
+
+#define SHIM_PAGE_TABLE_FLAG_1G_PAGES  BIT0
+
+#define SHIM_PAGE_TABLE_INFO_REVISION  1
+
+#pragma pack(1)
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  UINT8                               PhysicalAddressBits;
+  UINT8                               Reserved[3];
+  UINT32                              Flags;
+  ADDRESS                             Cr3;
+  ADDRESS                             Base;
+  UINT64                              Size;
+} SHIM_PAGE_TABLE_INFO;
+
+#pragma pack()
+
+extern GUID gShimPageTableInfoGuid;
+
+#endif // __PAGE_TABLE_H__
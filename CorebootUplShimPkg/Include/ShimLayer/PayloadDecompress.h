@@ -0,0 +1,60 @@
+/** @file
+  This file defines the HOB the shim layer reports when it hands off while
+  an AP is still decompressing the payload ELF file.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  The payload ELF file is decompressed front to back into FileBase, the
+  shim only waits for the headers and the sections needed to load the image.
+  The .upld.* extra sections reported in the extra data HOB may still be in
+  flight: a section [Base, Base + Size) is usable once
+    FileBase + Progress->DecodedSize >= Base + Size
+  or Progress->State is SHIM_PAYLOAD_DECOMPRESS_STATE_DONE. The payload must
+  wait for a terminal State before it reuses any shim memory, at the latest
+  before ExitBootServices. Progress lives in ReservedMemoryType memory, the
+  HOB only points to it so the HOB list can be copied.
+
+  The AP doing the work, the one with APIC ID ApicId, runs shim code until
+  State is terminal. The payload must not send INIT or SIPI to it before,
+  in particular not as an INIT broadcast to all APs, or the decompression
+  stops and State stays SHIM_PAYLOAD_DECOMPRESS_STATE_RUNNING for good.
+  The AP parks in its SHIM_AP_MAILBOX once it is done, a command posted to
+  it before is picked up then.
+
+**/
+
+#ifndef __PAYLOAD_DECOMPRESS_H__
+#define __PAYLOAD_DECOMPRESS_H__
+
+#define SHIM_PAYLOAD_DECOMPRESS_STATE_RUNNING  0
+#define SHIM_PAYLOAD_DECOMPRESS_STATE_DONE     1
+#define SHIM_PAYLOAD_DECOMPRESS_STATE_ERROR    2
+
+#define SHIM_PAYLOAD_DECOMPRESS_INFO_REVISION  1
+
+#pragma pack(1)
+
+///
+/// Both fields are 32-bit so they are read atomically by 32-bit and 64-bit
+/// payloads. DecodedSize only grows, State changes once after the last
+/// DecodedSize update.
+///
+typedef struct {
+  volatile UINT32    DecodedSize;
+  volatile UINT32    State;
+} SHIM_PAYLOAD_DECOMPRESS_PROGRESS;
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  ADDRESS                             FileBase;
+  UINT64                              FileSize;
+  ADDRESS                             Progress;
+  UINT32                              ApicId;
+} SHIM_PAYLOAD_DECOMPRESS_INFO;
+
+#pragma pack()
+
+extern GUID gShimPayloadDecompressInfoGuid;
+
+#endif // __PAYLOAD_DECOMPRESS_H__
@@ -0,0 +1,65 @@
+/** @file
+  This file defines the HOB the shim layer reports its boot timing and
+  decisions in.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Timestamp[] holds raw TSC values taken by the BSP when the shim reached
+  each SHIM_PERF_ID_* point, zero for a point it did not reach. The payload
+  converts them with its own TSC frequency.
+
+  PeakAllocatedSize and FinalAllocatedSize count the pages the shim
+  allocated, at the worst time and at the handoff.
+
+**/
+
+#ifndef __PERF_DATA_H__
+#define __PERF_DATA_H__
+
+#define SHIM_PERF_ID_ENTRY            0
+#define SHIM_PERF_ID_HOBS_BUILT       1
+#define SHIM_PERF_ID_PAYLOAD_DECODED  2
+#define SHIM_PERF_ID_PAYLOAD_LOADED   3
+#define SHIM_PERF_ID_HANDOFF          4
+#define SHIM_PERF_ID_COUNT            5
+
+///
+/// Placement values, where the payload image was loaded.
+///
+/// The image was loaded to an allocated buffer and relocated.
+///
+#define SHIM_PERF_PLACEMENT_RELOCATED  0
+///
+/// The image runs where its ELF file was decompressed.
+///
+#define SHIM_PERF_PLACEMENT_IN_PLACE   1
+///
+/// The image was loaded at its preferred address, free DRAM, without relocation.
+///
+#define SHIM_PERF_PLACEMENT_PREFERRED  2
+///
+/// The image was loaded inside the buffer its ELF file was decompressed to
+/// and relocated.
+///
+#define SHIM_PERF_PLACEMENT_IN_PLACE_RELOCATED  3
+
+#define SHIM_PERF_DATA_REVISION  2
+
+#pragma pack(1)
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  UINT32                              Placement;
+  UINT32                              Reserved;
+  ADDRESS                             ImageAddress;
+  UINT64                              Timestamp[SHIM_PERF_ID_COUNT];
+  UINT64                              PeakAllocatedSize;
+  UINT64                              FinalAllocatedSize;
+} SHIM_PERF_DATA;
+
+#pragma pack()
+
+extern GUID gShimPerfDataGuid;
+
+#endif // __PERF_DATA_H__
@@ -87,11 +87,133 @@ typedef struct {
     (((FFS_FILE_HEADER *) (UINTN) (FfsFileHeaderPtr))->Size[1] <<  8) | \
     (((FFS_FILE_HEADER *) (UINTN) (FfsFileHeaderPtr))->Size[2] << 16)))
 
+///
+/// File types.
+///
+#define FV_FILETYPE_ALL                    0x00
+#define FV_FILETYPE_RAW                    0x01
+#define FV_FILETYPE_FREEFORM               0x02
+#define FV_FILETYPE_SECURITY_CORE          0x03
+#define FV_FILETYPE_PEI_CORE               0x04
+#define FV_FILETYPE_DXE_CORE               0x05
+#define FV_FILETYPE_PEIM                   0x06
+#define FV_FILETYPE_DRIVER                 0x07
+#define FV_FILETYPE_APPLICATION            0x09
+#define FV_FILETYPE_FIRMWARE_VOLUME_IMAGE  0x0B
+#define FV_FILETYPE_FFS_PAD                0xF0
+
+///
+/// FFS File Attributes.
+///
+#define FFS_ATTRIB_LARGE_FILE  0x01
+#define FFS_ATTRIB_CHECKSUM    0x40
+
+///
+/// FFS File State Bits.
+///
+#define FILE_HEADER_CONSTRUCTION  0x01
+#define FILE_HEADER_VALID         0x02
+#define FILE_DATA_VALID           0x04
+#define FILE_MARKED_FOR_UPDATE    0x08
+#define FILE_DELETED              0x10
+#define FILE_HEADER_INVALID       0x20
+
+///
+/// The header of a file larger than 16MB, FFS_ATTRIB_LARGE_FILE is set and
+/// Size is zero.
+///
+typedef struct {
+  GUID                Name;
+  FFS_INTEGRITY_CHECK IntegrityCheck;
+  FV_FILETYPE         Type;
+  FFS_FILE_ATTRIBUTES Attributes;
+  UINT8               Size[3];
+  FFS_FILE_STATE      State;
+  ///
+  /// The length of the file in bytes, including the FFS header.
+  ///
+  UINT64              ExtendedSize;
+} FFS_FILE_HEADER2;
+
+#define IS_FFS_FILE2(FfsFileHeaderPtr) \
+    (((((FFS_FILE_HEADER *) (UINTN) FfsFileHeaderPtr)->Attributes) & FFS_ATTRIB_LARGE_FILE) == FFS_ATTRIB_LARGE_FILE)
+
 #define FFS_FILE2_SIZE(FfsFileHeaderPtr) \
     ((UINT32) (((FFS_FILE_HEADER2 *) (UINTN) FfsFileHeaderPtr)->ExtendedSize))
 
 typedef UINT8 SECTION_TYPE;
 
+///
+/// Leaf section Type values.
+///
+#define SECTION_COMPRESSION               0x01
+#define SECTION_GUID_DEFINED              0x02
+#define SECTION_PE32                      0x10
+#define SECTION_PIC                       0x11
+#define SECTION_TE                        0x12
+#define SECTION_DXE_DEPEX                 0x13
+#define SECTION_VERSION                   0x14
+#define SECTION_USER_INTERFACE            0x15
+#define SECTION_FIRMWARE_VOLUME_IMAGE     0x17
+#define SECTION_RAW                       0x19
+
+///
+/// Common section header. A section of 16MB or more has all Size bytes set
+/// to 0xff and uses COMMON_SECTION_HEADER2.
+///
+typedef struct {
+  ///
+  /// A 24-bit unsigned integer that contains the total size of the section in bytes,
+  /// including the COMMON_SECTION_HEADER.
+  ///
+  UINT8             Size[3];
+  SECTION_TYPE      Type;
+} COMMON_SECTION_HEADER;
+
+typedef struct {
+  UINT8             Size[3];
+  SECTION_TYPE      Type;
+  ///
+  /// The total size of the section in bytes, including the COMMON_SECTION_HEADER2.
+  ///
+  UINT32            ExtendedSize;
+} COMMON_SECTION_HEADER2;
+
+///
+/// The leaf section which is encapsulation defined by specific GUID.
+///
+typedef struct {
+  COMMON_SECTION_HEADER   CommonHeader;
+  ///
+  /// The GUID that defines the format of the data that follows.
+  ///
+  GUID                    SectionDefinitionGuid;
+  ///
+  /// Contains the offset in bytes from the beginning of the common header to the first byte of the data.
+  ///
+  UINT16                  DataOffset;
+  ///
+  /// The bit field that declares some specific characteristics of the section contents.
+  ///
+  UINT16                  Attributes;
+} GUID_DEFINED_SECTION;
+
+typedef struct {
+  COMMON_SECTION_HEADER2  CommonHeader;
+  GUID                    SectionDefinitionGuid;
+  UINT16                  DataOffset;
+  UINT16                  Attributes;
+} GUID_DEFINED_SECTION2;
+
+#define IS_SECTION2(SectionHeaderPtr) \
+    ((UINT32) (*((UINT32 *) ((COMMON_SECTION_HEADER *) (UINTN) SectionHeaderPtr)->Size) & 0x00ffffff) == 0x00ffffff)
+
+#define SECTION_SIZE(SectionHeaderPtr) \
+    ((UINT32) (*((UINT32 *) ((COMMON_SECTION_HEADER *) (UINTN) SectionHeaderPtr)->Size) & 0x00ffffff))
+
+#define SECTION2_SIZE(SectionHeaderPtr) \
+    (((COMMON_SECTION_HEADER2 *) (UINTN) SectionHeaderPtr)->ExtendedSize)
+
 #pragma pack()
 
 
@@ -100,6 +222,16 @@ typedef UINT8 SECTION_TYPE;
 ///
 typedef UINT32  FVB_ATTRIBUTES_2;
 
+///
+/// The erased value of the volume bits, it also inverts the FFS file State.
+///
+#define FVB2_ERASE_POLARITY  0x00000800
+
+///
+/// The alignment of the volume is 1 << ((Attributes & FVB2_ALIGNMENT) >> 16).
+///
+#define FVB2_ALIGNMENT  0x001F0000
+
 typedef struct {
   ///
   /// The number of sequential blocks which are of the same size.
@@ -111,6 +243,11 @@ typedef struct {
   UINT32 Length;
 } FV_BLOCK_MAP_ENTRY;
 
+///
+/// Firmware Volume Header Signature
+///
+#define FVH_SIGNATURE  SIGNATURE_32 ('_', 'F', 'V', 'H')
+
 ///
 /// Describes the features and layout of the firmware volume.
 ///
@@ -165,6 +302,21 @@ typedef struct {
   FV_BLOCK_MAP_ENTRY        BlockMap[1];
 } FIRMWARE_VOLUME_HEADER;
 
+///
+/// Extension header pointed by ExtHeaderOffset of volume header.
+///
+typedef struct {
+  ///
+  /// Firmware volume name.
+  ///
+  GUID                      FvName;
+  ///
+  /// Size of the rest of the extension header, including this structure.
+  ///
+  UINT32                    ExtHeaderSize;
+} FIRMWARE_VOLUME_EXT_HEADER;
+
+///
 /// If this bit is set, then the PCI Root Bridge does not
 /// support separate windows for Non-prefetchable and Prefetchable
 /// memory. A PCI bus driver needs to include requests for Prefetchable
@@ -0,0 +1,62 @@
+/** @file
+  This file defines the function profile a PROFILE=1 build of the shim layer
+  records, and the HOB it hands the profile off in.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Every shim function the BSP returns from appends an entry to the ring of
+  a SHIM_PROFILE_BUFFER, in reserved memory the payload and the OS leave
+  alone. Function is the offset of the function from ImageBase, the address
+  the shim ran at, add LinkBase to look it up in ShimLayer.elf. Depth is the
+  call depth of the function, Cycles the raw TSC ticks from its entry to its
+  return, those of the functions it called included.
+
+  Recorded counts every entry ever appended, entry Recorded % EntryCount is
+  the next one to be overwritten once the ring wrapped. Dropped counts the
+  returns deeper than the shim could track. Signature lets a tool find the
+  buffer in a memory dump.
+
+  The SHIM_PROFILE_DATA HOB locates the buffer.
+
+**/
+
+#ifndef __PROFILE_DATA_H__
+#define __PROFILE_DATA_H__
+
+#define SHIM_PROFILE_SIGNATURE  0x464F52504D494853ULL // "SHIMPROF"
+
+#define SHIM_PROFILE_DATA_REVISION  1
+
+#pragma pack(1)
+
+typedef struct {
+  UINT32    Function;
+  UINT16    Depth;
+  UINT16    Reserved;
+  UINT64    Cycles;
+} SHIM_PROFILE_ENTRY;
+
+typedef struct {
+  UINT64                Signature;
+  UINT32                EntryCount;
+  UINT32                Reserved;
+  UINT64                Recorded;
+  UINT64                Dropped;
+  ADDRESS               ImageBase;
+  ADDRESS               LinkBase;
+  SHIM_PROFILE_ENTRY    Entry[0];
+} SHIM_PROFILE_BUFFER;
+
+typedef struct {
+  UNIVERSAL_PAYLOAD_GENERIC_HEADER    Header;
+  UINT32                              Reserved;
+  ADDRESS                             Base;
+  UINT64                              Size;
+} SHIM_PROFILE_DATA;
+
+#pragma pack()
+
+extern GUID gShimProfileDataGuid;
+
+#endif // __PROFILE_DATA_H__
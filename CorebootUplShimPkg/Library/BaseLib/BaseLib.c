@@ -68,6 +68,28 @@ CopyMem (
     return DestinationBuffer;
   }
 
+#if defined (MDE_CPU_X64)
+  //
+  // Copy forward with rep movsq unless the destination starts inside the
+  // source, the overlapping case below copies backward.
+  //
+  if (((UINTN)DestinationBuffer < (UINTN)SourceBuffer) ||
+      ((UINTN)DestinationBuffer >= (UINTN)SourceBuffer + Length))
+  {
+    Alignment = Length / sizeof (UINT64);
+    __asm__ __volatile__ (
+      "rep movsq\n\t"
+      "mov %3, %2\n\t"
+      "rep movsb"
+      : "+D" (DestinationBuffer), "+S" (SourceBuffer), "+c" (Alignment)
+      : "r" (Length & 0x7)
+      : "memory"
+      );
+    return (UINT8 *)DestinationBuffer - Length;
+  }
+
+#endif
+
   if ((((UINTN)DestinationBuffer & 0x7) == 0) && (((UINTN)SourceBuffer & 0x7) == 0) && (Length >= 8)) {
     if (SourceBuffer > DestinationBuffer) {
       Destination64 = (UINT64 *)DestinationBuffer;
@@ -206,6 +228,21 @@ ZeroMem (
   UINT32           Value32;
   UINT64           Value64;
 
+#if defined (MDE_CPU_X64)
+  UINTN  Count;
+
+  Count = Length / sizeof (UINT64);
+  __asm__ __volatile__ (
+    "rep stosq\n\t"
+    "mov %2, %1\n\t"
+    "rep stosb"
+    : "+D" (Buffer), "+c" (Count)
+    : "r" (Length & 0x7), "a" (0)
+    : "memory"
+    );
+  return (UINT8 *)Buffer - Length;
+#endif
+
   if ((((UINTN)Buffer & 0x7) == 0) && (Length >= 8)) {
     // Generate the 64bit value
     Value64 = 0;
@@ -241,6 +278,8 @@ ZeroMem (
   return Buffer;
 }
 
+#if !defined (MDE_CPU_X64)
+
 /**
  * fls - find last (most-significant) bit set
  * @x: the word to search
@@ -357,6 +396,8 @@ UINT64 div64_u64(UINT64 dividend, UINT64 divisor)
   return quot;
 }
 
+#endif
+
 /**
   Divides a 64-bit unsigned integer by a 64-bit unsigned integer and generates
   a 64-bit unsigned result and an optional 64-bit unsigned remainder.
@@ -387,9 +428,11 @@ DivU64x64Remainder (
     *Remainder = Dividend % Divisor;
   }
 
-  div64_u64 (Dividend, Divisor);
-
-  return Dividend;
+#if defined (MDE_CPU_X64)
+  return Dividend / Divisor;
+#else
+  return div64_u64 (Dividend, Divisor);
+#endif
 }
 
 UINT64
@@ -463,6 +506,100 @@ CompareGuid (
   return (unsigned char)(LowPartOfGuid1 == LowPartOfGuid2 && HighPartOfGuid1 == HighPartOfGuid2);
 }
 
+/**
+  Returns the sum of all elements in a buffer of 16-bit values. During
+  calculation, the carry bits are dropped.
+
+  @param  Buffer      The pointer to the buffer to carry out the sum operation.
+  @param  Length      The size, in bytes, of Buffer, a multiple of 2.
+
+  @return Sum         The sum of Buffer with carry bits dropped during additions.
+
+**/
+UINT16
+CalculateSum16 (
+  IN      CONST UINT16  *Buffer,
+  IN      UINTN         Length
+  )
+{
+  UINT16  Sum;
+  UINTN   Count;
+
+  for (Sum = 0, Count = 0; Count < Length; Count += sizeof (UINT16)) {
+    Sum = (UINT16)(Sum + *(Buffer++));
+  }
+
+  return Sum;
+}
+
+/**
+  This function is identical to perform QuickSort,
+  except that is uses the pre-allocated buffer so the in place sorting does not need to
+  allocate and free buffers constantly.
+
+  Each element must be equal sized. The smaller partition is sorted
+  recursively and the larger one in the loop, so the stack use stays
+  logarithmic in Count.
+
+  @param[in, out] BufferToSort   On call, a Buffer of (possibly sorted) elements;
+                                 on return, a buffer of sorted elements.
+  @param[in]  Count              The number of elements in the buffer to sort.
+  @param[in]  ElementSize        The size of an element in bytes.
+  @param[in]  CompareFunction    The function to call to perform the comparison
+                                 of any two elements.
+  @param[out] BufferOneElement   A buffer of ElementSize bytes used for swapping.
+
+**/
+VOID
+QuickSort (
+  IN OUT VOID               *BufferToSort,
+  IN CONST UINTN            Count,
+  IN CONST UINTN            ElementSize,
+  IN       BASE_SORT_COMPARE  CompareFunction,
+  OUT VOID                  *BufferOneElement
+  )
+{
+  UINT8  *Buffer;
+  UINT8  *Pivot;
+  UINTN  Remaining;
+  UINTN  LoopCount;
+  UINTN  NextSwapLocation;
+
+  Buffer    = BufferToSort;
+  Remaining = Count;
+  while (Remaining >= 2) {
+    //
+    // Partition around the last element.
+    //
+    NextSwapLocation = 0;
+    Pivot            = Buffer + (Remaining - 1) * ElementSize;
+    for (LoopCount = 0; LoopCount < Remaining - 1; LoopCount++) {
+      if (CompareFunction (Buffer + LoopCount * ElementSize, Pivot) <= 0) {
+        if (LoopCount != NextSwapLocation) {
+          CopyMem (BufferOneElement, Buffer + NextSwapLocation * ElementSize, ElementSize);
+          CopyMem (Buffer + NextSwapLocation * ElementSize, Buffer + LoopCount * ElementSize, ElementSize);
+          CopyMem (Buffer + LoopCount * ElementSize, BufferOneElement, ElementSize);
+        }
+
+        NextSwapLocation++;
+      }
+    }
+
+    CopyMem (BufferOneElement, Buffer + NextSwapLocation * ElementSize, ElementSize);
+    CopyMem (Buffer + NextSwapLocation * ElementSize, Pivot, ElementSize);
+    CopyMem (Pivot, BufferOneElement, ElementSize);
+
+    if (NextSwapLocation < Remaining - NextSwapLocation - 1) {
+      QuickSort (Buffer, NextSwapLocation, ElementSize, CompareFunction, BufferOneElement);
+      Buffer    += (NextSwapLocation + 1) * ElementSize;
+      Remaining -= NextSwapLocation + 1;
+    } else {
+      QuickSort (Buffer + (NextSwapLocation + 1) * ElementSize, Remaining - NextSwapLocation - 1, ElementSize, CompareFunction, BufferOneElement);
+      Remaining = NextSwapLocation;
+    }
+  }
+}
+
 /**
   Returns the length of a Null-terminated Ascii string.
 
@@ -16,6 +16,11 @@
 ///
 #define MAX_ADDRESS   0xFFFFFFFFFFFFFFFFULL
 
+#define SPIN_LOCK_RELEASED  ((UINTN) 1)
+#define SPIN_LOCK_ACQUIRED  ((UINTN) 2)
+
+typedef volatile UINTN  SPIN_LOCK;
+
 /**
   Copies a source buffer to a destination buffer, and returns the destination buffer.
 
@@ -162,6 +167,210 @@ AsmCpuid (
   OUT     UINT32                    *Edx   OPTIONAL
   );
 
+/**
+  Returns a 64-bit Machine Specific Register(MSR).
+
+  Reads and returns the 64-bit MSR specified by Index. No parameter checking is
+  performed on Index, and some Index values may cause CPU exceptions.
+
+  @param  Index The 32-bit MSR index to read.
+
+  @return The value of the MSR identified by Index.
+
+**/
+UINT64
+AsmReadMsr64 (
+  IN      UINT32  Index
+  );
+
+/**
+  Writes a 64-bit value to a Machine Specific Register(MSR), and returns the
+  value.
+
+  @param  Index The 32-bit MSR index to write.
+  @param  Value The 64-bit value to write to the MSR.
+
+  @return Value
+
+**/
+UINT64
+AsmWriteMsr64 (
+  IN      UINT32  Index,
+  IN      UINT64  Value
+  );
+
+/**
+  Reads the current value of the Time Stamp Counter (TSC).
+
+  @return The current value of TSC
+
+**/
+UINT64
+AsmReadTsc (
+  VOID
+  );
+
+/**
+  Reads an 8-bit I/O port.
+
+  @param  Port  The I/O port to read.
+
+  @return The value read.
+
+**/
+UINT8
+IoRead8 (
+  IN      UINTN  Port
+  );
+
+/**
+  Writes an 8-bit I/O port.
+
+  @param  Port  The I/O port to write.
+  @param  Value The value to write to the I/O port.
+
+  @return The value written the I/O port.
+
+**/
+UINT8
+IoWrite8 (
+  IN      UINTN  Port,
+  IN      UINT8  Value
+  );
+
+/**
+  Reads a 32-bit I/O port.
+
+  @param  Port  The I/O port to read.
+
+  @return The value read.
+
+**/
+UINT32
+IoRead32 (
+  IN      UINTN  Port
+  );
+
+/**
+  Requests CPU to pause for a short period of time.
+
+**/
+VOID
+CpuPause (
+  VOID
+  );
+
+/**
+  Performs an atomic increment of a 32-bit unsigned integer.
+
+  @param  Value A pointer to the 32-bit value to increment.
+
+  @return The incremented value.
+
+**/
+UINT32
+InterlockedIncrement (
+  IN      volatile UINT32  *Value
+  );
+
+/**
+  Performs an atomic compare exchange operation on a 32-bit unsigned integer.
+
+  @param  Value         A pointer to the 32-bit value for the compare exchange
+                        operation.
+  @param  CompareValue  The 32-bit value used in the compare operation.
+  @param  ExchangeValue The 32-bit value used in the exchange operation.
+
+  @return The original *Value before exchange.
+
+**/
+UINT32
+InterlockedCompareExchange32 (
+  IN OUT  volatile UINT32  *Value,
+  IN      UINT32           CompareValue,
+  IN      UINT32           ExchangeValue
+  );
+
+/**
+  Performs an atomic decrement of a 32-bit unsigned integer.
+
+  @param  Value A pointer to the 32-bit value to decrement.
+
+  @return The decremented value.
+
+**/
+UINT32
+InterlockedDecrement (
+  IN      volatile UINT32  *Value
+  );
+
+/**
+  Performs an atomic compare exchange operation on a pointer value.
+
+  @param  Value         A pointer to the pointer value for the compare exchange
+                        operation.
+  @param  CompareValue  The pointer value used in the compare operation.
+  @param  ExchangeValue The pointer value used in the exchange operation.
+
+  @return The original *Value before exchange.
+
+**/
+VOID *
+InterlockedCompareExchangePointer (
+  IN OUT  VOID * volatile  *Value,
+  IN      VOID             *CompareValue,
+  IN      VOID             *ExchangeValue
+  );
+
+/**
+  Used to serialize load and store operations.
+
+**/
+VOID
+MemoryFence (
+  VOID
+  );
+
+/**
+  Initializes a spin lock to the released state and returns the spin lock.
+
+  @param  SpinLock  A pointer to the spin lock to initialize to the released
+                    state.
+
+  @return SpinLock in released state.
+
+**/
+SPIN_LOCK *
+InitializeSpinLock (
+  OUT     SPIN_LOCK  *SpinLock
+  );
+
+/**
+  Waits until a spin lock can be placed in the acquired state.
+
+  @param  SpinLock  A pointer to the spin lock to place in the acquired state.
+
+  @return SpinLock acquired the lock.
+
+**/
+SPIN_LOCK *
+AcquireSpinLock (
+  IN OUT  SPIN_LOCK  *SpinLock
+  );
+
+/**
+  Releases a spin lock.
+
+  @param  SpinLock  A pointer to the spin lock to release.
+
+  @return SpinLock released the lock.
+
+**/
+SPIN_LOCK *
+ReleaseSpinLock (
+  IN OUT  SPIN_LOCK  *SpinLock
+  );
+
 GUID *
 CopyGuid (
    GUID        *DestinationGuid,
@@ -174,6 +383,22 @@ CompareGuid (
   IN CONST GUID     *Guid2
   );
 
+/**
+  Returns the sum of all elements in a buffer of 16-bit values. During
+  calculation, the carry bits are dropped.
+
+  @param  Buffer      The pointer to the buffer to carry out the sum operation.
+  @param  Length      The size, in bytes, of Buffer, a multiple of 2.
+
+  @return Sum         The sum of Buffer with carry bits dropped during additions.
+
+**/
+UINT16
+CalculateSum16 (
+  IN      CONST UINT16  *Buffer,
+  IN      UINTN         Length
+  );
+
 /**
   Returns the length of a Null-terminated Ascii string.
 
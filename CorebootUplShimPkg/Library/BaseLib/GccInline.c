@@ -0,0 +1,369 @@
+/** @file
+  GCC/Clang inline implementation of the processor specific functions.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "BaseLib.h"
+
+/**
+  Returns a 64-bit Machine Specific Register(MSR).
+
+  Reads and returns the 64-bit MSR specified by Index. No parameter checking is
+  performed on Index, and some Index values may cause CPU exceptions.
+
+  @param  Index The 32-bit MSR index to read.
+
+  @return The value of the MSR identified by Index.
+
+**/
+UINT64
+AsmReadMsr64 (
+  IN      UINT32  Index
+  )
+{
+  UINT32  LowData;
+  UINT32  HighData;
+
+  __asm__ __volatile__ (
+    "rdmsr"
+    : "=a" (LowData),
+      "=d" (HighData)
+    : "c" (Index)
+    );
+
+  return (((UINT64)HighData) << 32) | LowData;
+}
+
+/**
+  Writes a 64-bit value to a Machine Specific Register(MSR), and returns the
+  value.
+
+  Writes the 64-bit value specified by Value to the MSR specified by Index. The
+  64-bit value written to the MSR is returned. No parameter checking is
+  performed on Index or Value, and some of these may cause CPU exceptions.
+
+  @param  Index The 32-bit MSR index to write.
+  @param  Value The 64-bit value to write to the MSR.
+
+  @return Value
+
+**/
+UINT64
+AsmWriteMsr64 (
+  IN      UINT32  Index,
+  IN      UINT64  Value
+  )
+{
+  UINT32  LowData;
+  UINT32  HighData;
+
+  LowData  = (UINT32)(Value);
+  HighData = (UINT32)(Value >> 32);
+
+  __asm__ __volatile__ (
+    "wrmsr"
+    :
+    : "c" (Index),
+      "a" (LowData),
+      "d" (HighData)
+    );
+
+  return Value;
+}
+
+/**
+  Reads the current value of the Time Stamp Counter (TSC).
+
+  Reads and returns the current value of TSC.
+
+  @return The current value of TSC
+
+**/
+UINT64
+AsmReadTsc (
+  VOID
+  )
+{
+  UINT32  LowData;
+  UINT32  HiData;
+
+  __asm__ __volatile__ (
+    "rdtsc"
+    : "=a" (LowData),
+      "=d" (HiData)
+    );
+
+  return (((UINT64)HiData) << 32) | LowData;
+}
+
+/**
+  Reads an 8-bit I/O port.
+
+  Reads the 8-bit I/O port specified by Port. The 8-bit read value is returned.
+
+  @param  Port  The I/O port to read.
+
+  @return The value read.
+
+**/
+UINT8
+IoRead8 (
+  IN      UINTN  Port
+  )
+{
+  UINT8  Data;
+
+  __asm__ __volatile__ ("inb %w1,%b0" : "=a" (Data) : "d" ((UINT16)Port));
+  return Data;
+}
+
+/**
+  Writes an 8-bit I/O port.
+
+  Writes the 8-bit I/O port specified by Port with the value specified by Value
+  and returns Value.
+
+  @param  Port  The I/O port to write.
+  @param  Value The value to write to the I/O port.
+
+  @return The value written the I/O port.
+
+**/
+UINT8
+IoWrite8 (
+  IN      UINTN  Port,
+  IN      UINT8  Value
+  )
+{
+  __asm__ __volatile__ ("outb %b0,%w1" : : "a" (Value), "d" ((UINT16)Port));
+  return Value;
+}
+
+/**
+  Reads a 32-bit I/O port.
+
+  Reads the 32-bit I/O port specified by Port. The 32-bit read value is returned.
+
+  @param  Port  The I/O port to read.
+
+  @return The value read.
+
+**/
+UINT32
+IoRead32 (
+  IN      UINTN  Port
+  )
+{
+  UINT32  Data;
+
+  __asm__ __volatile__ ("inl %w1,%0" : "=a" (Data) : "d" ((UINT16)Port));
+  return Data;
+}
+
+/**
+  Requests CPU to pause for a short period of time.
+
+  Requests CPU to pause for a short period of time. Typically used in MP
+  systems to prevent memory starvation while waiting for a spin lock.
+
+**/
+VOID
+CpuPause (
+  VOID
+  )
+{
+  __asm__ __volatile__ ("pause" ::: "memory");
+}
+
+/**
+  Performs an atomic increment of a 32-bit unsigned integer.
+
+  Performs an atomic increment of the 32-bit unsigned integer specified by
+  Value and returns the incremented value. The increment operation must be
+  performed using MP safe mechanisms.
+
+  @param  Value A pointer to the 32-bit value to increment.
+
+  @return The incremented value.
+
+**/
+UINT32
+InterlockedIncrement (
+  IN      volatile UINT32  *Value
+  )
+{
+  return __sync_add_and_fetch (Value, 1);
+}
+
+/**
+  Performs an atomic compare exchange operation on a 32-bit unsigned integer.
+
+  Performs an atomic compare exchange operation on the 32-bit unsigned integer
+  specified by Value.  If Value is equal to CompareValue, then Value is set to
+  ExchangeValue and CompareValue is returned.  If Value is not equal to CompareValue,
+  then Value is returned.  The compare exchange operation must be performed using
+  MP safe mechanisms.
+
+  @param  Value         A pointer to the 32-bit value for the compare exchange
+                        operation.
+  @param  CompareValue  The 32-bit value used in the compare operation.
+  @param  ExchangeValue The 32-bit value used in the exchange operation.
+
+  @return The original *Value before exchange.
+
+**/
+UINT32
+InterlockedCompareExchange32 (
+  IN OUT  volatile UINT32  *Value,
+  IN      UINT32           CompareValue,
+  IN      UINT32           ExchangeValue
+  )
+{
+  return __sync_val_compare_and_swap (Value, CompareValue, ExchangeValue);
+}
+
+/**
+  Performs an atomic decrement of a 32-bit unsigned integer.
+
+  Performs an atomic decrement of the 32-bit unsigned integer specified by
+  Value and returns the decremented value. The decrement operation must be
+  performed using MP safe mechanisms.
+
+  @param  Value A pointer to the 32-bit value to decrement.
+
+  @return The decremented value.
+
+**/
+UINT32
+InterlockedDecrement (
+  IN      volatile UINT32  *Value
+  )
+{
+  return __sync_sub_and_fetch (Value, 1);
+}
+
+/**
+  Performs an atomic compare exchange operation on a pointer value.
+
+  Performs an atomic compare exchange operation on the pointer value specified
+  by Value. If Value is equal to CompareValue, then Value is set to
+  ExchangeValue and CompareValue is returned. If Value is not equal to
+  CompareValue, then Value is returned. The compare exchange operation must be
+  performed using MP safe mechanisms.
+
+  @param  Value         A pointer to the pointer value for the compare exchange
+                        operation.
+  @param  CompareValue  The pointer value used in the compare operation.
+  @param  ExchangeValue The pointer value used in the exchange operation.
+
+  @return The original *Value before exchange.
+
+**/
+VOID *
+InterlockedCompareExchangePointer (
+  IN OUT  VOID * volatile  *Value,
+  IN      VOID             *CompareValue,
+  IN      VOID             *ExchangeValue
+  )
+{
+  return __sync_val_compare_and_swap (Value, CompareValue, ExchangeValue);
+}
+
+/**
+  Used to serialize load and store operations.
+
+  All loads and stores that proceed calls to this function are guaranteed to be
+  globally visible when this function returns.
+
+**/
+VOID
+MemoryFence (
+  VOID
+  )
+{
+  __sync_synchronize ();
+}
+
+/**
+  Initializes a spin lock to the released state and returns the spin lock.
+
+  This function initializes the spin lock specified by SpinLock to the released
+  state, and returns SpinLock.
+
+  @param  SpinLock  A pointer to the spin lock to initialize to the released
+                    state.
+
+  @return SpinLock in released state.
+
+**/
+SPIN_LOCK *
+InitializeSpinLock (
+  OUT     SPIN_LOCK  *SpinLock
+  )
+{
+  *SpinLock = SPIN_LOCK_RELEASED;
+  return SpinLock;
+}
+
+/**
+  Waits until a spin lock can be placed in the acquired state.
+
+  This function checks the state of the spin lock specified by SpinLock. If
+  SpinLock is in the released state, then this function places SpinLock in the
+  acquired state and returns SpinLock. Otherwise, this function waits
+  indefinitely for the spin lock to be released, and then places it in the
+  acquired state and returns SpinLock. All state transitions of SpinLock must
+  be performed using MP safe mechanisms.
+
+  A spin lock that is zero is treated as released, so locks in zeroed global
+  data need no explicit initialization.
+
+  @param  SpinLock  A pointer to the spin lock to place in the acquired state.
+
+  @return SpinLock acquired the lock.
+
+**/
+SPIN_LOCK *
+AcquireSpinLock (
+  IN OUT  SPIN_LOCK  *SpinLock
+  )
+{
+  UINTN  Current;
+
+  for ( ; ;) {
+    Current = *SpinLock;
+    if ((Current != SPIN_LOCK_ACQUIRED) &&
+        (__sync_val_compare_and_swap (SpinLock, Current, SPIN_LOCK_ACQUIRED) == Current))
+    {
+      break;
+    }
+
+    CpuPause ();
+  }
+
+  return SpinLock;
+}
+
+/**
+  Releases a spin lock.
+
+  This function places the spin lock specified by SpinLock in the release state
+  and returns SpinLock.
+
+  @param  SpinLock  A pointer to the spin lock to release.
+
+  @return SpinLock released the lock.
+
+**/
+SPIN_LOCK *
+ReleaseSpinLock (
+  IN OUT  SPIN_LOCK  *SpinLock
+  )
+{
+  __sync_synchronize ();
+  *SpinLock = SPIN_LOCK_RELEASED;
+  return SpinLock;
+}
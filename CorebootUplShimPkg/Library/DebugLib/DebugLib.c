@@ -0,0 +1,480 @@
+/** @file
+  Debug Library.
+
+  Messages are appended to the CBMEM console at memory speed. With
+  LOG_SERIAL set they are also queued for the 16550 serial port coreboot
+  used, which is fed a FIFO full at a time whenever it is found idle, so a
+  message never waits for the UART unless the queue is full.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DebugLib.h"
+#include <ParseLib.h>
+
+#define DEBUG_MESSAGE_LENGTH  256
+
+//
+// 16550 registers and bits.
+//
+#define SERIAL_REGISTER_THR  0
+#define SERIAL_REGISTER_IIR  2
+#define SERIAL_REGISTER_LSR  5
+#define SERIAL_IIR_FIFO      (BIT7 | BIT6)
+#define SERIAL_LSR_THRE      BIT5
+#define SERIAL_FIFO_DEPTH    16
+
+//
+// Holds the serial output not sent yet, a power of 2.
+//
+#define SERIAL_QUEUE_SIZE  SIZE_4KB
+
+//
+// Serializes the messages of the BSP and the APs running shim jobs.
+//
+STATIC SPIN_LOCK             mDebugLock;
+STATIC struct cbmem_console  *mCbmemConsole;
+
+#if LOG_SERIAL
+STATIC UINTN    mSerialBase;
+STATIC BOOLEAN  mSerialMmio;
+STATIC UINT32   mSerialStride;
+STATIC UINT32   mSerialBurst;
+STATIC CHAR8    mSerialQueue[SERIAL_QUEUE_SIZE];
+STATIC UINT32   mSerialHead;
+STATIC UINT32   mSerialTail;
+
+/**
+  Read a 16550 register.
+
+  @param  Register           The register index.
+
+  @return The register value.
+**/
+STATIC
+UINT8
+SerialRead (
+  IN UINTN  Register
+  )
+{
+  UINTN  Address;
+
+  Address = mSerialBase + Register * mSerialStride;
+  if (!mSerialMmio) {
+    return IoRead8 (Address);
+  }
+
+  if (mSerialStride == 4) {
+    return (UINT8)*(volatile UINT32 *)Address;
+  }
+
+  return *(volatile UINT8 *)Address;
+}
+
+/**
+  Write a 16550 register.
+
+  @param  Register           The register index.
+  @param  Value              The value to write.
+**/
+STATIC
+VOID
+SerialWrite (
+  IN UINTN  Register,
+  IN UINT8  Value
+  )
+{
+  UINTN  Address;
+
+  Address = mSerialBase + Register * mSerialStride;
+  if (!mSerialMmio) {
+    IoWrite8 (Address, Value);
+  } else if (mSerialStride == 4) {
+    *(volatile UINT32 *)Address = Value;
+  } else {
+    *(volatile UINT8 *)Address = Value;
+  }
+}
+
+/**
+  Send the next burst of the serial queue if the transmitter is idle.
+
+  An empty transmit holding register means an empty FIFO, it takes a FIFO
+  full without checking the line status again.
+
+  @retval TRUE               A burst was sent.
+  @retval FALSE              The transmitter is busy.
+**/
+STATIC
+BOOLEAN
+SerialSendBurst (
+  VOID
+  )
+{
+  UINT32  Count;
+
+  if ((SerialRead (SERIAL_REGISTER_LSR) & SERIAL_LSR_THRE) == 0) {
+    return FALSE;
+  }
+
+  for (Count = 0; (Count < mSerialBurst) && (mSerialTail != mSerialHead); Count++) {
+    SerialWrite (SERIAL_REGISTER_THR, mSerialQueue[mSerialTail++ & (SERIAL_QUEUE_SIZE - 1)]);
+  }
+
+  return TRUE;
+}
+
+/**
+  Queue a message for the serial port and send what the port takes now.
+
+  @param  Buffer             The message.
+  @param  Length             The length of the message.
+**/
+STATIC
+VOID
+SerialPortWrite (
+  IN CONST CHAR8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  UINTN  Index;
+
+  if (mSerialBase == 0) {
+    return;
+  }
+
+  for (Index = 0; Index < Length; Index++) {
+    //
+    // The terminal wants a carriage return before each line feed.
+    //
+    while (mSerialHead - mSerialTail > SERIAL_QUEUE_SIZE - 2) {
+      if (!SerialSendBurst ()) {
+        CpuPause ();
+      }
+    }
+
+    if (Buffer[Index] == '\n') {
+      mSerialQueue[mSerialHead++ & (SERIAL_QUEUE_SIZE - 1)] = '\r';
+    }
+
+    mSerialQueue[mSerialHead++ & (SERIAL_QUEUE_SIZE - 1)] = Buffer[Index];
+  }
+
+  while ((mSerialTail != mSerialHead) && SerialSendBurst ()) {
+  }
+}
+
+#endif
+
+/**
+  Append a message to the CBMEM console.
+
+  The console body is a ring, the overflow flag tells it wrapped.
+
+  @param  Buffer             The message.
+  @param  Length             The length of the message.
+**/
+STATIC
+VOID
+CbmemConsoleWrite (
+  IN CONST CHAR8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  UINT32  Cursor;
+  UINT32  Flags;
+  UINT32  Chunk;
+
+  if (mCbmemConsole == NULL) {
+    return;
+  }
+
+  Cursor = mCbmemConsole->cursor & CBMC_CURSOR_MASK;
+  Flags  = mCbmemConsole->cursor & ~CBMC_CURSOR_MASK;
+  while (Length > 0) {
+    if (Cursor >= mCbmemConsole->size) {
+      Cursor = 0;
+      Flags |= CBMC_OVERFLOW;
+    }
+
+    Chunk = (UINT32)MIN (Length, (UINTN)(mCbmemConsole->size - Cursor));
+    CopyMem (&mCbmemConsole->body[Cursor], Buffer, Chunk);
+    Cursor += Chunk;
+    Buffer += Chunk;
+    Length -= Chunk;
+  }
+
+  mCbmemConsole->cursor = Flags | Cursor;
+}
+
+/**
+  Append a number to a message.
+
+  @param  Buffer             The message buffer.
+  @param  Index              The length of the message, updated.
+  @param  Value              The number.
+  @param  Base               10 or 16.
+  @param  Width              The least number of characters.
+  @param  Pad                The character to pad with, '0' or ' '.
+  @param  Upper              Use upper case hexadecimal digits.
+**/
+STATIC
+VOID
+AppendNumber (
+  IN OUT CHAR8    *Buffer,
+  IN OUT UINTN    *Index,
+  IN     UINT64   Value,
+  IN     UINT32   Base,
+  IN     UINTN    Width,
+  IN     CHAR8    Pad,
+  IN     BOOLEAN  Upper
+  )
+{
+  CHAR8   Digits[20];
+  UINTN   Count;
+  UINT64  Remainder;
+
+  Count = 0;
+  do {
+    Value           = DivU64x64Remainder (Value, Base, &Remainder);
+    Digits[Count++] = (CHAR8)((Remainder < 10) ? ('0' + Remainder) : ((Upper ? 'A' : 'a') + Remainder - 10));
+  } while (Value != 0);
+
+  while ((Width > Count) && (*Index < DEBUG_MESSAGE_LENGTH)) {
+    Buffer[(*Index)++] = Pad;
+    Width--;
+  }
+
+  while ((Count > 0) && (*Index < DEBUG_MESSAGE_LENGTH)) {
+    Buffer[(*Index)++] = Digits[--Count];
+  }
+}
+
+/**
+  Format a message, see DebugPrint() for the format.
+
+  @param  Buffer             The message buffer, DEBUG_MESSAGE_LENGTH long.
+  @param  Format             The format string.
+  @param  Marker             The values to format.
+
+  @return The length of the message, truncated to the buffer.
+**/
+STATIC
+UINTN
+FormatMessage (
+  OUT CHAR8        *Buffer,
+  IN  CONST CHAR8  *Format,
+  IN  VA_LIST      Marker
+  )
+{
+  UINTN        Index;
+  UINTN        Width;
+  CHAR8        Pad;
+  BOOLEAN      Long;
+  UINT64       Value;
+  INT64        Signed;
+  CONST CHAR8  *String;
+  GUID         *Guid;
+
+  Index = 0;
+  for ( ; (*Format != '\0') && (Index < DEBUG_MESSAGE_LENGTH); Format++) {
+    if (*Format != '%') {
+      Buffer[Index++] = *Format;
+      continue;
+    }
+
+    Format++;
+    Pad = ' ';
+    if (*Format == '0') {
+      Pad = '0';
+      Format++;
+    }
+
+    for (Width = 0; (*Format >= '0') && (*Format <= '9'); Format++) {
+      Width = Width * 10 + (*Format - '0');
+    }
+
+    Long = FALSE;
+    while (*Format == 'l') {
+      Long = TRUE;
+      Format++;
+    }
+
+    switch (*Format) {
+      case 'a':
+      case 's':
+        String = VA_ARG (Marker, CONST CHAR8 *);
+        if (String == NULL) {
+          String = "<null>";
+        }
+
+        for ( ; (*String != '\0') && (Index < DEBUG_MESSAGE_LENGTH); String++) {
+          Buffer[Index++] = *String;
+        }
+
+        break;
+
+      case 'c':
+        Buffer[Index++] = (CHAR8)VA_ARG (Marker, UINTN);
+        break;
+
+      case 'd':
+        Signed = Long ? VA_ARG (Marker, INT64) : VA_ARG (Marker, INT32);
+        if (Signed < 0) {
+          Buffer[Index++] = '-';
+          Signed          = -Signed;
+        }
+
+        AppendNumber (Buffer, &Index, (UINT64)Signed, 10, Width, Pad, FALSE);
+        break;
+
+      case 'u':
+      case 'x':
+      case 'X':
+        Value = Long ? VA_ARG (Marker, UINT64) : VA_ARG (Marker, UINT32);
+        AppendNumber (Buffer, &Index, Value, (*Format == 'u') ? 10 : 16, Width, Pad, *Format == 'X');
+        break;
+
+      case 'p':
+        AppendNumber (Buffer, &Index, (UINTN)VA_ARG (Marker, VOID *), 16, sizeof (UINTN) * 2, '0', FALSE);
+        break;
+
+      case 'r':
+        AppendNumber (Buffer, &Index, VA_ARG (Marker, RETURN_STATUS), 16, sizeof (UINTN) * 2, '0', FALSE);
+        break;
+
+      case 'g':
+        Guid = VA_ARG (Marker, GUID *);
+        AppendNumber (Buffer, &Index, Guid->Data1, 16, 8, '0', FALSE);
+        for (Width = 0; Width < 10; Width++) {
+          //
+          // Data2, Data3 and then the bytes of Data4, 8-4-4-4-12 digits.
+          //
+          if (((Width < 3) || (Width == 4)) && (Index < DEBUG_MESSAGE_LENGTH)) {
+            Buffer[Index++] = '-';
+          }
+
+          if (Width == 0) {
+            AppendNumber (Buffer, &Index, Guid->Data2, 16, 4, '0', FALSE);
+          } else if (Width == 1) {
+            AppendNumber (Buffer, &Index, Guid->Data3, 16, 4, '0', FALSE);
+          } else {
+            AppendNumber (Buffer, &Index, Guid->Data4[Width - 2], 16, 2, '0', FALSE);
+          }
+        }
+
+        break;
+
+      case '%':
+        Buffer[Index++] = '%';
+        break;
+
+      default:
+        //
+        // Also an unfinished format at the end of the string.
+        //
+        return Index;
+    }
+  }
+
+  return Index;
+}
+
+/**
+  Find the log sinks coreboot left, the CBMEM console and the serial port.
+
+  The coreboot table must be known. Messages printed before are dropped.
+
+  @retval SUCCESS            The CBMEM console is found.
+  @retval NOT_FOUND          There is no CBMEM console.
+**/
+RETURN_STATUS
+DebugLibInitialize (
+  VOID
+  )
+{
+  RETURN_STATUS         Status;
+  struct cbmem_console  *Console;
+  UINT32                Size;
+
+#if LOG_SERIAL
+  SERIAL_PORT_INFO  SerialPortInfo;
+
+  if (!ERROR (ParseSerialInfo (&SerialPortInfo))) {
+    mSerialMmio   = (SerialPortInfo.Type == CB_SERIAL_TYPE_MEMORY_MAPPED);
+    mSerialStride = (SerialPortInfo.RegWidth == 0) ? 1 : SerialPortInfo.RegWidth;
+    mSerialBase   = SerialPortInfo.BaseAddr;
+
+    //
+    // coreboot leaves the FIFO enabled when the UART has one.
+    //
+    mSerialBurst = ((SerialRead (SERIAL_REGISTER_IIR) & SERIAL_IIR_FIFO) == SERIAL_IIR_FIFO) ? SERIAL_FIFO_DEPTH : 1;
+  }
+
+#endif
+
+  Status = ParseCbMemTable (CBMEM_ID_CONSOLE, (VOID **)&Console, &Size);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  if ((Size < sizeof (struct cbmem_console)) || (Console->size > Size - sizeof (struct cbmem_console))) {
+    return NOT_FOUND;
+  }
+
+  mCbmemConsole = Console;
+  return SUCCESS;
+}
+
+/**
+  Print a message to the log sinks.
+
+  @param  Level              The level of the message, DEBUG_ERROR to
+                             DEBUG_VERBOSE.
+  @param  Format             The format string.
+  @param  ...                The values to format.
+**/
+VOID
+DebugPrint (
+  IN UINTN        Level,
+  IN CONST CHAR8  *Format,
+  ...
+  )
+{
+  CHAR8    Buffer[DEBUG_MESSAGE_LENGTH];
+  UINTN    Length;
+  VA_LIST  Marker;
+
+  VA_START (Marker, Format);
+  Length = FormatMessage (Buffer, Format, Marker);
+  VA_END (Marker);
+
+  AcquireSpinLock (&mDebugLock);
+  CbmemConsoleWrite (Buffer, Length);
+#if LOG_SERIAL
+  SerialPortWrite (Buffer, Length);
+#endif
+  ReleaseSpinLock (&mDebugLock);
+}
+
+/**
+  Wait for the serial port to send all the messages it buffered.
+**/
+VOID
+DebugFlush (
+  VOID
+  )
+{
+#if LOG_SERIAL
+  AcquireSpinLock (&mDebugLock);
+  while ((mSerialBase != 0) && (mSerialTail != mSerialHead)) {
+    if (!SerialSendBurst ()) {
+      CpuPause ();
+    }
+  }
+
+  ReleaseSpinLock (&mDebugLock);
+#endif
+}
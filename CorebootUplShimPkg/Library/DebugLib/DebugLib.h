@@ -0,0 +1,91 @@
+/** @file
+  Debug Library.
+
+  The shim log is written to the coreboot CBMEM console, and with LOG_SERIAL
+  set to the coreboot serial port too. DEBUG() calls more verbose than
+  LOG_LEVEL are compiled out, a LOG_LEVEL of 0 builds no log call at all.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __DEBUG_LIB_H__
+#define __DEBUG_LIB_H__
+
+#include <Base.h>
+#include <BaseLib.h>
+
+//
+// Log levels, from the least to the most verbose.
+//
+#define DEBUG_ERROR    1
+#define DEBUG_WARN     2
+#define DEBUG_INFO     3
+#define DEBUG_VERBOSE  4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL  DEBUG_ERROR
+#endif
+
+/**
+  Find the log sinks coreboot left, the CBMEM console and the serial port.
+
+  The coreboot table must be known. Messages printed before are dropped.
+
+  @retval SUCCESS            The CBMEM console is found.
+  @retval NOT_FOUND          There is no CBMEM console.
+**/
+RETURN_STATUS
+DebugLibInitialize (
+  VOID
+  );
+
+/**
+  Print a message to the log sinks.
+
+  The format is the one of the EDK2 PrintLib: %a and %s print an ASCII
+  string, %c a character, %d, %u, %x and %X a 32-bit value or a 64-bit one
+  with the l flag, %p a pointer, %g a GUID and %r a RETURN_STATUS. A width
+  and the 0 flag may precede the type.
+
+  @param  Level              The level of the message, DEBUG_ERROR to
+                             DEBUG_VERBOSE.
+  @param  Format             The format string.
+  @param  ...                The values to format.
+**/
+VOID
+DebugPrint (
+  IN UINTN        Level,
+  IN CONST CHAR8  *Format,
+  ...
+  );
+
+/**
+  Wait for the serial port to send all the messages it buffered.
+
+  The shim calls it right before the handoff, the payload may take over the
+  serial port then.
+**/
+VOID
+DebugFlush (
+  VOID
+  );
+
+#define _DEBUG_PRINT(Level, ...)                \
+  do {                                          \
+    if ((Level) <= LOG_LEVEL) {                 \
+      DebugPrint ((Level), ##__VA_ARGS__);      \
+    }                                           \
+  } while (FALSE)
+
+///
+/// Print a message, DEBUG ((DEBUG_INFO, "Format", ...)).
+///
+#if LOG_LEVEL > 0
+#define DEBUG(Expression)  _DEBUG_PRINT Expression
+#else
+#define DEBUG(Expression)
+#endif
+
+#endif // __DEBUG_LIB_H__
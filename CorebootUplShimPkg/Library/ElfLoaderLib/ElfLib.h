@@ -17,6 +17,8 @@
 
 #define  ELF_PT_LOAD  1
 
+#define  ELF_SHF_COMPRESSED  0x800
+
 typedef struct {
   UINT32    PtType;
   UINTN     Offset;
@@ -26,6 +28,18 @@ typedef struct {
   UINTN     Alignment;
 } SEGMENT_INFO;
 
+///
+/// A section header as GetElfSectionTable() returns it. Name is NULL when
+/// the name is not a string of the section name table.
+///
+typedef struct {
+  UINT32    Type;
+  CHAR8     *Name;
+  UINTN     Offset;
+  UINTN     Size;
+  UINT64    Flags;
+} ELF_SECTION_ENTRY;
+
 /**
   Parse the ELF image info.
 
@@ -100,4 +114,66 @@ GetElfSectionPos (
   OUT UINTN              *Size
   );
 
+/**
+  Read the compression header at the start of a SHF_COMPRESSED section.
+
+  @param[in]  EiClass             ELF class.
+  @param[in]  Data                The section data.
+  @param[in]  DataSize            The size of the section data.
+  @param[out] Type                Return the compression algorithm (ch_type).
+  @param[out] HeaderSize          Return the size of the compression header.
+  @param[out] DecompressedSize    Return the size of the section once decompressed.
+  @param[out] Alignment           Return the alignment of the decompressed section.
+
+  @retval INVALID_PARAMETER   Data or any output is NULL.
+  @retval UNSUPPORTED         The compression header does not fit in the section.
+  @retval SUCCESS             The compression header is returned.
+**/
+RETURN_STATUS
+GetElfCompressionHeader (
+  IN  UINT32  EiClass,
+  IN  VOID    *Data,
+  IN  UINTN   DataSize,
+  OUT UINT32  *Type,
+  OUT UINTN   *HeaderSize,
+  OUT UINT64  *DecompressedSize,
+  OUT UINT64  *Alignment
+  );
+
+/**
+  Walk the ELF section headers once and describe them in a table.
+
+  @param[in]  ElfCt               ELF image context pointer.
+  @param[out] Table               The table, ElfCt->ShNum entries.
+
+  @retval INVALID_PARAMETER   ElfCt or Table is NULL.
+  @retval SUCCESS             The table is filled.
+**/
+RETURN_STATUS
+GetElfSectionTable (
+  IN  ELF_IMAGE_CONTEXT  *ElfCt,
+  OUT ELF_SECTION_ENTRY  *Table
+  );
+
+/**
+  Make an ELF image loadable inside its own file buffer.
+
+  On success ElfCt->ImageAddress is set to ElfCt->FileBase and the image is
+  loaded there by LoadElfImage(). Headers and sections in the way of the
+  segments are moved after the end of the file, so section offsets must be
+  read again after this call.
+
+  @param[in]  ElfCt               ELF image context pointer.
+  @param[in]  BufferSize          The size of the buffer at ElfCt->FileBase.
+
+  @retval INVALID_PARAMETER   ElfCt is NULL.
+  @retval UNSUPPORTED         The image cannot be loaded in this buffer.
+  @retval SUCCESS             The image can be loaded in place.
+**/
+RETURN_STATUS
+PrepareElfInPlaceLoad (
+  IN  ELF_IMAGE_CONTEXT  *ElfCt,
+  IN  UINTN              BufferSize
+  );
+
 #endif /* ELF_LIB_H_ */
@@ -93,6 +93,16 @@ typedef struct {
   Elf32_Word    sh_entsize;   /* Size of each entry in section. */
 } Elf32_Shdr;
 
+/*
+ * Compression header, at the start of SHF_COMPRESSED sections.
+ */
+
+typedef struct {
+  Elf32_Word    ch_type;      /* Compression algorithm. */
+  Elf32_Word    ch_size;      /* Size of the uncompressed data. */
+  Elf32_Word    ch_addralign; /* Alignment of the uncompressed data. */
+} Elf32_Chdr;
+
 /*
  * Program header.
  */
@@ -114,13 +114,13 @@ ProcessRelocation32 (
   IN  BOOLEAN     DynamicLinking
   )
 {
-  UINTN   Index;
+  UINT32  Offset;
   UINT32  *Ptr;
   UINT32  Type;
 
-  for ( Index = 0
-        ; RelaEntrySize * Index < RelaSize
-        ; Index++, Rela = ELF_NEXT_ENTRY (Elf32_Rela, Rela, RelaEntrySize)
+  for ( Offset = 0
+        ; Offset < RelaSize
+        ; Offset += RelaEntrySize, Rela = ELF_NEXT_ENTRY (Elf32_Rela, Rela, RelaEntrySize)
         )
   {
     //
@@ -191,6 +191,131 @@ ProcessRelocation32 (
   return SUCCESS;
 }
 
+/**
+  Fix up the image based on the compact relative relocation entries.
+
+  An even entry is the address of a word to relocate. An odd entry is a
+  bitmap of the 31 words following the last relocated address, bit N set
+  when word N - 1 needs the relocation.
+
+  @param Relr                RELR entries.
+  @param RelrSize            Total size of RELR entries.
+  @param Delta               The delta between preferred image base and the actual image base.
+
+  @retval SUCCESS      The image fix up is processed successfully.
+  @retval UNSUPPORTED  A bitmap entry does not follow an address entry.
+**/
+RETURN_STATUS
+ProcessRelr32 (
+  IN  UINT32  *Relr,
+  IN  UINT32  RelrSize,
+  IN  intn    Delta
+  )
+{
+  UINT32  *End;
+  UINT32  *Ptr;
+  UINT32  Bitmap;
+  UINTN   Index;
+
+  Ptr = NULL;
+  for (End = Relr + (UINTN)(RelrSize / sizeof (UINT32)); Relr < End; Relr++) {
+    if ((*Relr & 1) == 0) {
+      Ptr    = (UINT32 *)(UINTN)(*Relr + Delta);
+      *Ptr++ += (UINT32)Delta;
+      continue;
+    }
+
+    if (Ptr == NULL) {
+      return UNSUPPORTED;
+    }
+
+    for (Index = 0, Bitmap = *Relr >> 1; Bitmap != 0; Index++, Bitmap >>= 1) {
+      if ((Bitmap & 1) != 0) {
+        Ptr[Index] += (UINT32)Delta;
+      }
+    }
+
+    Ptr += 31;
+  }
+
+  return SUCCESS;
+}
+
+/**
+  Apply the leading relative relocations of a dynamic relocation table.
+
+  The linker sorts the R_386_RELATIVE entries first and reports how many
+  there are in DT_RELACOUNT/DT_RELCOUNT, they are applied here without
+  decoding r_info.
+
+  @param Rela                Relocation entries.
+  @param RelaCount           Number of leading relative relocation entries.
+  @param RelaEntrySize       Relocation entry size.
+  @param RelaType            Type of relocation entry.
+  @param Delta               The delta between preferred image base and the actual image base.
+**/
+STATIC
+VOID
+ProcessRelativeRelocation32 (
+  IN  Elf32_Rela  *Rela,
+  IN  UINTN       RelaCount,
+  IN  UINTN       RelaEntrySize,
+  IN  UINT32      RelaType,
+  IN  intn        Delta
+  )
+{
+  Elf32_Rel  *Rel;
+
+  if (RelaType == SHT_RELA) {
+    if (RelaEntrySize == sizeof (Elf32_Rela)) {
+      for ( ; RelaCount >= 4; RelaCount -= 4, Rela += 4) {
+        *(UINT32 *)(UINTN)(Rela[0].r_offset + Delta) = (UINT32)Delta + Rela[0].r_addend;
+        *(UINT32 *)(UINTN)(Rela[1].r_offset + Delta) = (UINT32)Delta + Rela[1].r_addend;
+        *(UINT32 *)(UINTN)(Rela[2].r_offset + Delta) = (UINT32)Delta + Rela[2].r_addend;
+        *(UINT32 *)(UINTN)(Rela[3].r_offset + Delta) = (UINT32)Delta + Rela[3].r_addend;
+      }
+    }
+
+    for ( ; RelaCount > 0; RelaCount--, Rela = ELF_NEXT_ENTRY (Elf32_Rela, Rela, RelaEntrySize)) {
+      *(UINT32 *)(UINTN)(Rela->r_offset + Delta) = (UINT32)Delta + Rela->r_addend;
+    }
+  } else {
+    //
+    // The addend of a REL entry is stored in the field to relocate.
+    //
+    for (Rel = (Elf32_Rel *)Rela; RelaCount > 0; RelaCount--, Rel = ELF_NEXT_ENTRY (Elf32_Rel, Rel, RelaEntrySize)) {
+      *(UINT32 *)(UINTN)(Rel->r_offset + Delta) += (UINT32)Delta;
+    }
+  }
+}
+
+/**
+  Return where a virtual address range of the image is loaded.
+
+  @param ElfCt                Point to image context.
+  @param Address              The virtual address of the range.
+  @param Size                 The size of the range.
+
+  @return Pointer to the loaded range, NULL if it is not inside the image.
+**/
+STATIC
+VOID *
+GetElf32ImagePointer (
+  IN  ELF_IMAGE_CONTEXT  *ElfCt,
+  IN  UINT32             Address,
+  IN  UINT32             Size
+  )
+{
+  UINT32  Offset;
+
+  Offset = Address - (UINTN)ElfCt->PreferredImageAddress;
+  if ((Address < (UINTN)ElfCt->PreferredImageAddress) || (Offset > ElfCt->ImageSize) || (Size > ElfCt->ImageSize - Offset)) {
+    return NULL;
+  }
+
+  return ElfCt->ImageAddress + (UINTN)Offset;
+}
+
 /**
   Relocate the DYN type image.
 
@@ -207,13 +332,20 @@ RelocateElf32Dynamic (
   UINT32      Index;
   Elf32_Phdr  *Phdr;
   Elf32_Shdr  *DynShdr;
-  Elf32_Shdr  *RelShdr;
   Elf32_Dyn   *Dyn;
+  Elf32_Rela  *Rela;
+  UINT32      *Relr;
   UINT32      RelaAddress;
   UINT32      RelaCount;
   UINT32      RelaSize;
   UINT32      RelaEntrySize;
   UINT32      RelaType;
+  UINT32      RelrAddress;
+  UINT32      RelrSize;
+  UINT32      RelrEntrySize;
+  UINTN       RelativeSize;
+  intn        Delta;
+  RETURN_STATUS  Status;
 
   //
   // 1. Locate the dynamic section.
@@ -250,6 +382,9 @@ RelocateElf32Dynamic (
   RelaCount     = 0;
   RelaEntrySize = 0;
   RelaType      = 0;
+  RelrAddress   = MAX_UINT32;
+  RelrSize      = 0;
+  RelrEntrySize = sizeof (UINT32);
   for ( Index = 0, Dyn = (Elf32_Dyn *)(ElfCt->FileBase + DynShdr->sh_offset)
         ; Index < DynShdr->sh_size / DynShdr->sh_entsize
         ; Index++, Dyn = ELF_NEXT_ENTRY (Elf32_Dyn, Dyn, DynShdr->sh_entsize)
@@ -280,46 +415,71 @@ RelocateElf32Dynamic (
       case DT_RELASZ:
         RelaSize = Dyn->d_un.d_val;
         break;
+      case DT_RELR:
+        RelrAddress = Dyn->d_un.d_ptr;
+        break;
+      case DT_RELRSZ:
+        RelrSize = Dyn->d_un.d_val;
+        break;
+      case DT_RELRENT:
+        RelrEntrySize = Dyn->d_un.d_val;
+        break;
       default:
         break;
     }
   }
 
-  if (RelaAddress == MAX_UINT64) {
-    //
-    // It's fine that a DYN ELF doesn't contain relocation section.
-    //
-    return SUCCESS;
-  }
+  //
+  // The relocation tables are part of the image, read them where it is
+  // loaded instead of looking up their section headers.
+  //
+  Delta = (intn)((UINTN)ElfCt->ImageAddress - (UINTN)ElfCt->PreferredImageAddress);
 
   //
-  // Verify the existence of the relocation section.
+  // It's fine that a DYN ELF doesn't contain relocation section.
   //
-  RelShdr = NULL;
-  for (Index = 0; Index < ElfCt->ShNum; Index++) {
-    RelShdr = GetElf32SectionByIndex (ElfCt->FileBase, Index);
-    if ((RelShdr->sh_addr == RelaAddress) && (RelShdr->sh_size == RelaSize)) {
-      break;
+  if (RelaAddress != MAX_UINT32) {
+    if (RelaEntrySize == 0) {
+      RelaEntrySize = (RelaType == SHT_RELA) ? sizeof (Elf32_Rela) : sizeof (Elf32_Rel);
     }
 
-    RelShdr = NULL;
-  }
+    Rela = GetElf32ImagePointer (ElfCt, RelaAddress, RelaSize);
+    if ((Rela == NULL) || (RelaCount > RelaSize / RelaEntrySize)) {
+      return UNSUPPORTED;
+    }
 
-  if (RelShdr == NULL) {
-    return UNSUPPORTED;
+    //
+    // 3. Process the relocation section, the relative relocations the
+    //    linker counted first, then the others one by one.
+    //
+    RelativeSize = (UINTN)RelaCount * (UINTN)RelaEntrySize;
+    ProcessRelativeRelocation32 (Rela, (UINTN)RelaCount, (UINTN)RelaEntrySize, RelaType, Delta);
+    ProcessRelocation32 (
+      (Elf32_Rela *)((UINT8 *)Rela + RelativeSize),
+      RelaSize - RelativeSize,
+      RelaEntrySize,
+      RelaType,
+      Delta,
+      TRUE
+      );
   }
 
   //
-  // 3. Process the relocation section.
+  // 4. Process the compact relative relocations, -z pack-relative-relocs
+  //    moves most R_*_RELATIVE entries there.
   //
-  ProcessRelocation32 (
-    (Elf32_Rela *)(ElfCt->FileBase + RelShdr->sh_offset),
-    RelShdr->sh_size,
-    RelShdr->sh_entsize,
-    RelShdr->sh_type,
-    (UINTN)ElfCt->ImageAddress - (UINTN)ElfCt->PreferredImageAddress,
-    TRUE
-    );
+  if (RelrAddress != MAX_UINT32) {
+    Relr = GetElf32ImagePointer (ElfCt, RelrAddress, RelrSize);
+    if ((Relr == NULL) || (RelrEntrySize != sizeof (UINT32))) {
+      return UNSUPPORTED;
+    }
+
+    Status = ProcessRelr32 (Relr, RelrSize, Delta);
+    if (ERROR (Status)) {
+      return Status;
+    }
+  }
+
   return SUCCESS;
 }
 
@@ -414,37 +574,49 @@ LoadElf32Image (
   IN    ELF_IMAGE_CONTEXT  *ElfCt
   )
 {
-  Elf32_Ehdr  *Ehdr;
-  Elf32_Phdr  *Phdr;
-  UINT16      Index;
-  UINTN       Delta;
+  Elf32_Ehdr     *Ehdr;
+  Elf32_Phdr     *Phdr;
+  UINT16         Index;
+  UINTN          Delta;
+  RETURN_STATUS  Status;
 
   //
   // Per the sprit of ELF, loading to memory only consumes info from program headers.
   //
   Ehdr = (Elf32_Ehdr *)ElfCt->FileBase;
 
-  for ( Index = 0, Phdr = (Elf32_Phdr *)(ElfCt->FileBase + Ehdr->e_phoff)
-        ; Index < Ehdr->e_phnum
-        ; Index++, Phdr = ELF_NEXT_ENTRY (Elf32_Phdr, Phdr, Ehdr->e_phentsize)
-        )
-  {
-    //
-    // Skip segments that don't require load (type tells, or size is 0)
-    //
-    if ((Phdr->p_type != PT_LOAD) ||
-        (Phdr->p_memsz == 0))
-    {
-      continue;
+  //
+  // An image loaded inside its own file buffer needs its segments moved in a
+  // safe order, see PrepareElfInPlaceLoad().
+  //
+  if (ElfCt->ImageAddress == ElfCt->FileBase) {
+    Status = LoadElfSegmentsInPlace (ElfCt);
+    if (ERROR (Status)) {
+      return Status;
     }
+  } else {
+    for ( Index = 0, Phdr = (Elf32_Phdr *)(ElfCt->FileBase + Ehdr->e_phoff)
+          ; Index < Ehdr->e_phnum
+          ; Index++, Phdr = ELF_NEXT_ENTRY (Elf32_Phdr, Phdr, Ehdr->e_phentsize)
+          )
+    {
+      //
+      // Skip segments that don't require load (type tells, or size is 0)
+      //
+      if ((Phdr->p_type != PT_LOAD) ||
+          (Phdr->p_memsz == 0))
+      {
+        continue;
+      }
 
-    //
-    // The memory offset of segment relative to the image base
-    // Note: CopyMem() does nothing when the dst equals to src.
-    //
-    Delta = Phdr->p_paddr - (UINT32)(UINTN)ElfCt->PreferredImageAddress;
-    CopyMem (ElfCt->ImageAddress + Delta, ElfCt->FileBase + Phdr->p_offset, Phdr->p_filesz);
-    ZeroMem (ElfCt->ImageAddress + Delta + Phdr->p_filesz, Phdr->p_memsz - Phdr->p_filesz);
+      //
+      // The memory offset of segment relative to the image base
+      // Note: CopyMem() does nothing when the dst equals to src.
+      //
+      Delta = Phdr->p_paddr - (UINT32)(UINTN)ElfCt->PreferredImageAddress;
+      CopyMem (ElfCt->ImageAddress + Delta, ElfCt->FileBase + Phdr->p_offset, Phdr->p_filesz);
+      ZeroMem (ElfCt->ImageAddress + Delta + Phdr->p_filesz, Phdr->p_memsz - Phdr->p_filesz);
+    }
   }
 
   //
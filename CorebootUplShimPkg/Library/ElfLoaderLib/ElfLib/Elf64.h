@@ -101,6 +101,17 @@ typedef struct {
   Elf64_Xword    sh_entsize;   /* Size of each entry in section. */
 } Elf64_Shdr;
 
+/*
+ * Compression header, at the start of SHF_COMPRESSED sections.
+ */
+
+typedef struct {
+  Elf64_Word     ch_type;      /* Compression algorithm. */
+  Elf64_Word     ch_reserved;
+  Elf64_Xword    ch_size;      /* Size of the uncompressed data. */
+  Elf64_Xword    ch_addralign; /* Alignment of the uncompressed data. */
+} Elf64_Chdr;
+
 /*
  * Program header.
  */
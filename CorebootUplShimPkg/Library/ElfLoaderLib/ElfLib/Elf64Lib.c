@@ -114,13 +114,13 @@ ProcessRelocation64 (
   IN  BOOLEAN     DynamicLinking
   )
 {
-  UINTN   Index;
+  UINT64  Offset;
   UINT64  *Ptr;
   UINT32  Type;
 
-  for ( Index = 0
-        ; MultU64x64 (RelaEntrySize, Index) < RelaSize
-        ; Index++, Rela = ELF_NEXT_ENTRY (Elf64_Rela, Rela, RelaEntrySize)
+  for ( Offset = 0
+        ; Offset < RelaSize
+        ; Offset += RelaEntrySize, Rela = ELF_NEXT_ENTRY (Elf64_Rela, Rela, RelaEntrySize)
         )
   {
     //
@@ -198,6 +198,131 @@ ProcessRelocation64 (
   return SUCCESS;
 }
 
+/**
+  Fix up the image based on the compact relative relocation entries.
+
+  An even entry is the address of a word to relocate. An odd entry is a
+  bitmap of the 63 words following the last relocated address, bit N set
+  when word N - 1 needs the relocation.
+
+  @param Relr                RELR entries.
+  @param RelrSize            Total size of RELR entries.
+  @param Delta               The delta between preferred image base and the actual image base.
+
+  @retval SUCCESS      The image fix up is processed successfully.
+  @retval UNSUPPORTED  A bitmap entry does not follow an address entry.
+**/
+RETURN_STATUS
+ProcessRelr64 (
+  IN  UINT64  *Relr,
+  IN  UINT64  RelrSize,
+  IN  INT64   Delta
+  )
+{
+  UINT64  *End;
+  UINT64  *Ptr;
+  UINT64  Bitmap;
+  UINTN   Index;
+
+  Ptr = NULL;
+  for (End = Relr + (UINTN)(RelrSize / sizeof (UINT64)); Relr < End; Relr++) {
+    if ((*Relr & 1) == 0) {
+      Ptr    = (UINT64 *)(UINTN)(*Relr + Delta);
+      *Ptr++ += (UINT64)Delta;
+      continue;
+    }
+
+    if (Ptr == NULL) {
+      return UNSUPPORTED;
+    }
+
+    for (Index = 0, Bitmap = *Relr >> 1; Bitmap != 0; Index++, Bitmap >>= 1) {
+      if ((Bitmap & 1) != 0) {
+        Ptr[Index] += (UINT64)Delta;
+      }
+    }
+
+    Ptr += 63;
+  }
+
+  return SUCCESS;
+}
+
+/**
+  Apply the leading relative relocations of a dynamic relocation table.
+
+  The linker sorts the R_X86_64_RELATIVE entries first and reports how many
+  there are in DT_RELACOUNT/DT_RELCOUNT, they are applied here without
+  decoding r_info.
+
+  @param Rela                Relocation entries.
+  @param RelaCount           Number of leading relative relocation entries.
+  @param RelaEntrySize       Relocation entry size.
+  @param RelaType            Type of relocation entry.
+  @param Delta               The delta between preferred image base and the actual image base.
+**/
+STATIC
+VOID
+ProcessRelativeRelocation64 (
+  IN  Elf64_Rela  *Rela,
+  IN  UINTN       RelaCount,
+  IN  UINTN       RelaEntrySize,
+  IN  UINT64      RelaType,
+  IN  INT64       Delta
+  )
+{
+  Elf64_Rel  *Rel;
+
+  if (RelaType == SHT_RELA) {
+    if (RelaEntrySize == sizeof (Elf64_Rela)) {
+      for ( ; RelaCount >= 4; RelaCount -= 4, Rela += 4) {
+        *(UINT64 *)(UINTN)(Rela[0].r_offset + Delta) = (UINT64)Delta + Rela[0].r_addend;
+        *(UINT64 *)(UINTN)(Rela[1].r_offset + Delta) = (UINT64)Delta + Rela[1].r_addend;
+        *(UINT64 *)(UINTN)(Rela[2].r_offset + Delta) = (UINT64)Delta + Rela[2].r_addend;
+        *(UINT64 *)(UINTN)(Rela[3].r_offset + Delta) = (UINT64)Delta + Rela[3].r_addend;
+      }
+    }
+
+    for ( ; RelaCount > 0; RelaCount--, Rela = ELF_NEXT_ENTRY (Elf64_Rela, Rela, RelaEntrySize)) {
+      *(UINT64 *)(UINTN)(Rela->r_offset + Delta) = (UINT64)Delta + Rela->r_addend;
+    }
+  } else {
+    //
+    // The addend of a REL entry is stored in the field to relocate.
+    //
+    for (Rel = (Elf64_Rel *)Rela; RelaCount > 0; RelaCount--, Rel = ELF_NEXT_ENTRY (Elf64_Rel, Rel, RelaEntrySize)) {
+      *(UINT64 *)(UINTN)(Rel->r_offset + Delta) += (UINT64)Delta;
+    }
+  }
+}
+
+/**
+  Return where a virtual address range of the image is loaded.
+
+  @param ElfCt                Point to image context.
+  @param Address              The virtual address of the range.
+  @param Size                 The size of the range.
+
+  @return Pointer to the loaded range, NULL if it is not inside the image.
+**/
+STATIC
+VOID *
+GetElf64ImagePointer (
+  IN  ELF_IMAGE_CONTEXT  *ElfCt,
+  IN  UINT64             Address,
+  IN  UINT64             Size
+  )
+{
+  UINT64  Offset;
+
+  Offset = Address - (UINTN)ElfCt->PreferredImageAddress;
+  if ((Address < (UINTN)ElfCt->PreferredImageAddress) || (Offset > ElfCt->ImageSize) || (Size > ElfCt->ImageSize - Offset)) {
+    return NULL;
+  }
+
+  return ElfCt->ImageAddress + (UINTN)Offset;
+}
+
 /**
   Relocate the DYN type image.
 
@@ -214,13 +339,20 @@ RelocateElf64Dynamic (
   UINT32      Index;
   Elf64_Phdr  *Phdr;
   Elf64_Shdr  *DynShdr;
-  Elf64_Shdr  *RelShdr;
   Elf64_Dyn   *Dyn;
+  Elf64_Rela  *Rela;
+  UINT64      *Relr;
   UINT64      RelaAddress;
   UINT64      RelaCount;
   UINT64      RelaSize;
   UINT64      RelaEntrySize;
   UINT64      RelaType;
+  UINT64      RelrAddress;
+  UINT64      RelrSize;
+  UINT64      RelrEntrySize;
+  UINTN       RelativeSize;
+  intn        Delta;
+  RETURN_STATUS  Status;
 
   //
   // 1. Locate the dynamic section.
@@ -257,6 +389,9 @@ RelocateElf64Dynamic (
   RelaCount     = 0;
   RelaEntrySize = 0;
   RelaType      = 0;
+  RelrAddress   = MAX_UINT64;
+  RelrSize      = 0;
+  RelrEntrySize = sizeof (UINT64);
   for ( Index = 0, Dyn = (Elf64_Dyn *)(ElfCt->FileBase + DynShdr->sh_offset)
         ; Index < DivU64x64Remainder (DynShdr->sh_size, DynShdr->sh_entsize, NULL)
         ; Index++, Dyn = ELF_NEXT_ENTRY (Elf64_Dyn, Dyn, DynShdr->sh_entsize)
@@ -287,46 +422,71 @@ RelocateElf64Dynamic (
       case DT_RELASZ:
         RelaSize = Dyn->d_un.d_val;
         break;
+      case DT_RELR:
+        RelrAddress = Dyn->d_un.d_ptr;
+        break;
+      case DT_RELRSZ:
+        RelrSize = Dyn->d_un.d_val;
+        break;
+      case DT_RELRENT:
+        RelrEntrySize = Dyn->d_un.d_val;
+        break;
       default:
         break;
     }
   }
 
-  if (RelaAddress == MAX_UINT64) {
-    //
-    // It's fine that a DYN ELF doesn't contain relocation section.
-    //
-    return SUCCESS;
-  }
+  //
+  // The relocation tables are part of the image, read them where it is
+  // loaded instead of looking up their section headers.
+  //
+  Delta = (intn)((UINTN)ElfCt->ImageAddress - (UINTN)ElfCt->PreferredImageAddress);
 
   //
-  // Verify the existence of the relocation section.
+  // It's fine that a DYN ELF doesn't contain relocation section.
   //
-  RelShdr = NULL;
-  for (Index = 0; Index < ElfCt->ShNum; Index++) {
-    RelShdr = GetElf64SectionByIndex (ElfCt->FileBase, Index);
-    if ((RelShdr->sh_addr == RelaAddress) && (RelShdr->sh_size == RelaSize)) {
-      break;
+  if (RelaAddress != MAX_UINT64) {
+    if (RelaEntrySize == 0) {
+      RelaEntrySize = (RelaType == SHT_RELA) ? sizeof (Elf64_Rela) : sizeof (Elf64_Rel);
     }
 
-    RelShdr = NULL;
-  }
+    Rela = GetElf64ImagePointer (ElfCt, RelaAddress, RelaSize);
+    if ((Rela == NULL) || (RelaCount > DivU64x64Remainder (RelaSize, RelaEntrySize, NULL))) {
+      return UNSUPPORTED;
+    }
 
-  if (RelShdr == NULL) {
-    return UNSUPPORTED;
+    //
+    // 3. Process the relocation section, the relative relocations the
+    //    linker counted first, then the others one by one.
+    //
+    RelativeSize = (UINTN)RelaCount * (UINTN)RelaEntrySize;
+    ProcessRelativeRelocation64 (Rela, (UINTN)RelaCount, (UINTN)RelaEntrySize, RelaType, Delta);
+    ProcessRelocation64 (
+      (Elf64_Rela *)((UINT8 *)Rela + RelativeSize),
+      RelaSize - RelativeSize,
+      RelaEntrySize,
+      RelaType,
+      Delta,
+      TRUE
+      );
   }
 
   //
-  // 3. Process the relocation section.
+  // 4. Process the compact relative relocations, -z pack-relative-relocs
+  //    moves most R_*_RELATIVE entries there.
   //
-  ProcessRelocation64 (
-    (Elf64_Rela *)(ElfCt->FileBase + RelShdr->sh_offset),
-    RelShdr->sh_size,
-    RelShdr->sh_entsize,
-    RelShdr->sh_type,
-    (UINTN)ElfCt->ImageAddress - (UINTN)ElfCt->PreferredImageAddress,
-    TRUE
-    );
+  if (RelrAddress != MAX_UINT64) {
+    Relr = GetElf64ImagePointer (ElfCt, RelrAddress, RelrSize);
+    if ((Relr == NULL) || (RelrEntrySize != sizeof (UINT64))) {
+      return UNSUPPORTED;
+    }
+
+    Status = ProcessRelr64 (Relr, RelrSize, Delta);
+    if (ERROR (Status)) {
+      return Status;
+    }
+  }
+
   return SUCCESS;
 }
 
@@ -421,37 +581,49 @@ LoadElf64Image (
   IN    ELF_IMAGE_CONTEXT  *ElfCt
   )
 {
-  Elf64_Ehdr  *Ehdr;
-  Elf64_Phdr  *Phdr;
-  UINT16      Index;
-  UINTN       Delta;
+  Elf64_Ehdr     *Ehdr;
+  Elf64_Phdr     *Phdr;
+  UINT16         Index;
+  UINTN          Delta;
+  RETURN_STATUS  Status;
 
   //
   // Per the sprit of ELF, loading to memory only consumes info from program headers.
   //
   Ehdr = (Elf64_Ehdr *)ElfCt->FileBase;
 
-  for ( Index = 0, Phdr = (Elf64_Phdr *)(ElfCt->FileBase + Ehdr->e_phoff)
-        ; Index < Ehdr->e_phnum
-        ; Index++, Phdr = ELF_NEXT_ENTRY (Elf64_Phdr, Phdr, Ehdr->e_phentsize)
-        )
-  {
-    //
-    // Skip segments that don't require load (type tells, or size is 0)
-    //
-    if ((Phdr->p_type != PT_LOAD) ||
-        (Phdr->p_memsz == 0))
-    {
-      continue;
+  //
+  // An image loaded inside its own file buffer needs its segments moved in a
+  // safe order, see PrepareElfInPlaceLoad().
+  //
+  if (ElfCt->ImageAddress == ElfCt->FileBase) {
+    Status = LoadElfSegmentsInPlace (ElfCt);
+    if (ERROR (Status)) {
+      return Status;
     }
+  } else {
+    for ( Index = 0, Phdr = (Elf64_Phdr *)(ElfCt->FileBase + Ehdr->e_phoff)
+          ; Index < Ehdr->e_phnum
+          ; Index++, Phdr = ELF_NEXT_ENTRY (Elf64_Phdr, Phdr, Ehdr->e_phentsize)
+          )
+    {
+      //
+      // Skip segments that don't require load (type tells, or size is 0)
+      //
+      if ((Phdr->p_type != PT_LOAD) ||
+          (Phdr->p_memsz == 0))
+      {
+        continue;
+      }
 
-    //
-    // The memory offset of segment relative to the image base
-    // Note: CopyMem() does nothing when the dst equals to src.
-    //
-    Delta = (UINTN)Phdr->p_paddr - (UINTN)ElfCt->PreferredImageAddress;
-    CopyMem (ElfCt->ImageAddress + Delta, ElfCt->FileBase + (UINTN)Phdr->p_offset, (UINTN)Phdr->p_filesz);
-    ZeroMem (ElfCt->ImageAddress + Delta + (UINTN)Phdr->p_filesz, (UINTN)(Phdr->p_memsz - Phdr->p_filesz));
+      //
+      // The memory offset of segment relative to the image base
+      // Note: CopyMem() does nothing when the dst equals to src.
+      //
+      Delta = (UINTN)Phdr->p_paddr - (UINTN)ElfCt->PreferredImageAddress;
+      CopyMem (ElfCt->ImageAddress + Delta, ElfCt->FileBase + (UINTN)Phdr->p_offset, (UINTN)Phdr->p_filesz);
+      ZeroMem (ElfCt->ImageAddress + Delta + (UINTN)Phdr->p_filesz, (UINTN)(Phdr->p_memsz - Phdr->p_filesz));
+    }
   }
 
   //
@@ -215,6 +215,7 @@ typedef struct {
 #define SHT_PREINIT_ARRAY   16         /* Pre-initialization function ptrs. */
 #define SHT_GROUP           17         /* Section group. */
 #define SHT_SYMTAB_SHNDX    18         /* Section indexes (see SHN_XINDEX). */
+#define SHT_RELR            19         /* Relative relocations, compact format. */
 #define SHT_LOOS            0x60000000 /* First of OS specific semantics */
 #define SHT_LOSUNW          0x6ffffff4
 #define SHT_SUNW_dof        0x6ffffff4
@@ -251,9 +252,18 @@ typedef struct {
 #define SHF_OS_NONCONFORMING  0x100      /* OS-specific processing required. */
 #define SHF_GROUP             0x200      /* Member of section group. */
 #define SHF_TLS               0x400      /* Section contains TLS data. */
+#define SHF_COMPRESSED        0x800      /* Section data is compressed. */
 #define SHF_MASKOS            0x0ff00000 /* OS-specific semantics. */
 #define SHF_MASKPROC          0xf0000000 /* Processor-specific semantics. */
 
+/* Values for ch_type. */
+#define ELFCOMPRESS_ZLIB    1          /* ZLIB/DEFLATE algorithm. */
+#define ELFCOMPRESS_ZSTD    2          /* Zstandard algorithm. */
+#define ELFCOMPRESS_LOOS    0x60000000 /* reserved range for OS */
+#define ELFCOMPRESS_HIOS    0x6fffffff /*   specific compression */
+#define ELFCOMPRESS_LOPROC  0x70000000 /* reserved range for processor */
+#define ELFCOMPRESS_HIPROC  0x7fffffff /*   specific compression */
+
 /* Values for p_type. */
 #define PT_NULL           0          /* Unused entry. */
 #define PT_LOAD           1          /* Loadable segment. */
@@ -335,6 +345,9 @@ typedef struct {
            pre-initialization functions. */
 #define  DT_PREINIT_ARRAYSZ  33         /* Size in bytes of the array of
            pre-initialization functions. */
+#define  DT_RELRSZ           35         /* Total size of the compact relative relocations. */
+#define  DT_RELR             36         /* Address of the compact relative relocations. */
+#define  DT_RELRENT          37         /* Size of each compact relative relocation entry. */
 #define  DT_MAXPOSTAGS       34         /* number of positive tags */
 #define  DT_LOOS             0x6000000d /* First OS-specific */
 #define  DT_SUNW_AUXILIARY   0x6000000d /* symbol auxiliary name */
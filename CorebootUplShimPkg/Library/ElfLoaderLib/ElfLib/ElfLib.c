@@ -474,3 +474,654 @@ GetElfSectionPos (
 
   return NOT_FOUND;
 }
+
+/**
+  Read the compression header at the start of a SHF_COMPRESSED section.
+
+  The section data may have been moved out of the ELF file, only its own
+  bytes are read.
+
+  @param[in]  EiClass             ELF class.
+  @param[in]  Data                The section data.
+  @param[in]  DataSize            The size of the section data.
+  @param[out] Type                Return the compression algorithm (ch_type).
+  @param[out] HeaderSize          Return the size of the compression header.
+  @param[out] DecompressedSize    Return the size of the section once decompressed.
+  @param[out] Alignment           Return the alignment of the decompressed section.
+
+  @retval INVALID_PARAMETER   Data or any output is NULL.
+  @retval UNSUPPORTED         The compression header does not fit in the section.
+  @retval SUCCESS             The compression header is returned.
+**/
+RETURN_STATUS
+GetElfCompressionHeader (
+  IN  UINT32  EiClass,
+  IN  VOID    *Data,
+  IN  UINTN   DataSize,
+  OUT UINT32  *Type,
+  OUT UINTN   *HeaderSize,
+  OUT UINT64  *DecompressedSize,
+  OUT UINT64  *Alignment
+  )
+{
+  Elf32_Chdr  *Elf32Chdr;
+  Elf64_Chdr  *Elf64Chdr;
+
+  if ((Data == NULL) || (Type == NULL) || (HeaderSize == NULL) ||
+      (DecompressedSize == NULL) || (Alignment == NULL))
+  {
+    return INVALID_PARAMETER;
+  }
+
+  if (EiClass == ELFCLASS32) {
+    if (DataSize < sizeof (Elf32_Chdr)) {
+      return UNSUPPORTED;
+    }
+
+    Elf32Chdr         = (Elf32_Chdr *)Data;
+    *Type             = Elf32Chdr->ch_type;
+    *HeaderSize       = sizeof (Elf32_Chdr);
+    *DecompressedSize = Elf32Chdr->ch_size;
+    *Alignment        = Elf32Chdr->ch_addralign;
+  } else {
+    if (DataSize < sizeof (Elf64_Chdr)) {
+      return UNSUPPORTED;
+    }
+
+    Elf64Chdr         = (Elf64_Chdr *)Data;
+    *Type             = Elf64Chdr->ch_type;
+    *HeaderSize       = sizeof (Elf64_Chdr);
+    *DecompressedSize = Elf64Chdr->ch_size;
+    *Alignment        = Elf64Chdr->ch_addralign;
+  }
+
+  return SUCCESS;
+}
+
+/**
+  Walk the ELF section headers once and describe them in a table.
+
+  Consumers scanning the sections by name read the table instead of going
+  through GetElfSectionName() and GetElfSectionPos() per section.
+
+  @param[in]  ElfCt               ELF image context pointer.
+  @param[out] Table               The table, ElfCt->ShNum entries.
+
+  @retval INVALID_PARAMETER   ElfCt or Table is NULL.
+  @retval SUCCESS             The table is filled.
+**/
+RETURN_STATUS
+GetElfSectionTable (
+  IN  ELF_IMAGE_CONTEXT  *ElfCt,
+  OUT ELF_SECTION_ENTRY  *Table
+  )
+{
+  UINT8       *Shdr;
+  UINTN       ShEntSize;
+  Elf32_Shdr  *Elf32Shdr;
+  Elf64_Shdr  *Elf64Shdr;
+  UINT32      Index;
+  UINTN       NameOffset;
+  CHAR8       *Name;
+
+  if ((ElfCt == NULL) || (Table == NULL)) {
+    return INVALID_PARAMETER;
+  }
+
+  if (ERROR (ElfCt->ParseStatus)) {
+    return ElfCt->ParseStatus;
+  }
+
+  if (ElfCt->EiClass == ELFCLASS32) {
+    Shdr      = ElfCt->FileBase + ((Elf32_Ehdr *)ElfCt->FileBase)->e_shoff;
+    ShEntSize = ((Elf32_Ehdr *)ElfCt->FileBase)->e_shentsize;
+  } else {
+    Shdr      = ElfCt->FileBase + (UINTN)((Elf64_Ehdr *)ElfCt->FileBase)->e_shoff;
+    ShEntSize = ((Elf64_Ehdr *)ElfCt->FileBase)->e_shentsize;
+  }
+
+  for (Index = 0; Index < ElfCt->ShNum; Index++, Shdr += ShEntSize) {
+    if (ElfCt->EiClass == ELFCLASS32) {
+      Elf32Shdr           = (Elf32_Shdr *)Shdr;
+      NameOffset          = Elf32Shdr->sh_name;
+      Table[Index].Type   = Elf32Shdr->sh_type;
+      Table[Index].Offset = Elf32Shdr->sh_offset;
+      Table[Index].Size   = Elf32Shdr->sh_size;
+      Table[Index].Flags  = Elf32Shdr->sh_flags;
+    } else {
+      Elf64Shdr           = (Elf64_Shdr *)Shdr;
+      NameOffset          = Elf64Shdr->sh_name;
+      Table[Index].Type   = Elf64Shdr->sh_type;
+      Table[Index].Offset = (UINTN)Elf64Shdr->sh_offset;
+      Table[Index].Size   = (UINTN)Elf64Shdr->sh_size;
+      Table[Index].Flags  = Elf64Shdr->sh_flags;
+    }
+
+    //
+    // Only names terminated inside the section name table are reported.
+    //
+    Table[Index].Name = NULL;
+    if (NameOffset < ElfCt->ShStrLen) {
+      Name = (CHAR8 *)(ElfCt->FileBase + ElfCt->ShStrOff + NameOffset);
+      if (AsciiStrnLenS (Name, ElfCt->ShStrLen - NameOffset) < ElfCt->ShStrLen - NameOffset) {
+        Table[Index].Name = Name;
+      }
+    }
+  }
+
+  return SUCCESS;
+}
+
+/**
+  Get the PT_LOAD segments of an ELF image for loading it inside its own
+  file buffer, at ElfCt->FileBase.
+
+  The segments are returned ordered by their offset in the image. Both
+  their file data and their memory ranges must be disjoint and in the same
+  order, so every segment can be moved without clobbering the file data of
+  a segment not moved yet.
+
+  @param[in]  ElfCt               ELF image context pointer.
+  @param[out] Segments            The segments, ELF_IN_PLACE_MAX_SEGMENTS entries.
+  @param[out] Count               The number of segments returned.
+
+  @retval UNSUPPORTED         The segments cannot be loaded in place.
+  @retval SUCCESS             The segments are returned.
+**/
+STATIC
+RETURN_STATUS
+GetElfInPlaceSegments (
+  IN  ELF_IMAGE_CONTEXT     *ElfCt,
+  OUT ELF_IN_PLACE_SEGMENT  *Segments,
+  OUT UINT32                *Count
+  )
+{
+  RETURN_STATUS         Status;
+  SEGMENT_INFO          SegInfo;
+  ELF_IN_PLACE_SEGMENT  Segment;
+  UINT32                Index;
+  UINT32                Position;
+
+  *Count = 0;
+  for (Index = 0; Index < ElfCt->PhNum; Index++) {
+    Status = GetElfSegmentInfo (ElfCt->FileBase, ElfCt->EiClass, Index, &SegInfo);
+    if (ERROR (Status)) {
+      return UNSUPPORTED;
+    }
+
+    if ((SegInfo.PtType != PT_LOAD) || (SegInfo.MemLen == 0)) {
+      continue;
+    }
+
+    if ((*Count == ELF_IN_PLACE_MAX_SEGMENTS) || (SegInfo.Length > SegInfo.MemLen)) {
+      return UNSUPPORTED;
+    }
+
+    Segment.Source   = SegInfo.Offset;
+    Segment.Target   = SegInfo.MemAddr - (UINTN)ElfCt->PreferredImageAddress;
+    Segment.FileSize = SegInfo.Length;
+    Segment.MemSize  = SegInfo.MemLen;
+
+    //
+    // Insertion sort by target, there are only a few segments.
+    //
+    for (Position = *Count; (Position > 0) && (Segments[Position - 1].Target > Segment.Target); Position--) {
+      Segments[Position] = Segments[Position - 1];
+    }
+
+    Segments[Position] = Segment;
+    (*Count)++;
+  }
+
+  for (Index = 1; Index < *Count; Index++) {
+    if ((Segments[Index - 1].Target + Segments[Index - 1].MemSize > Segments[Index].Target) ||
+        (Segments[Index - 1].Source + Segments[Index - 1].FileSize > Segments[Index].Source))
+    {
+      return UNSUPPORTED;
+    }
+  }
+
+  if ((*Count != 0) && (Segments[*Count - 1].Target + Segments[*Count - 1].MemSize > ElfCt->ImageSize)) {
+    return UNSUPPORTED;
+  }
+
+  return SUCCESS;
+}
+
+/**
+  Check whether loading the segments in place writes to a file range.
+
+  The file data of a segment loaded at its own file offset is rewritten
+  with the same bytes, only its zero-filled tail counts as written.
+
+  @param[in]  Segments            The segments.
+  @param[in]  Count               The number of segments.
+  @param[in]  Offset              The offset of the range in the file.
+  @param[in]  Size                The size of the range.
+
+  @retval TRUE                The range is written.
+  @retval FALSE               The range keeps its content.
+**/
+STATIC
+BOOLEAN
+IsElfInPlaceRangeWritten (
+  IN ELF_IN_PLACE_SEGMENT  *Segments,
+  IN UINT32                Count,
+  IN UINTN                 Offset,
+  IN UINTN                 Size
+  )
+{
+  UINT32  Index;
+  UINTN   Start;
+  UINTN   End;
+
+  for (Index = 0; Index < Count; Index++) {
+    Start = Segments[Index].Target;
+    if (Segments[Index].Target == Segments[Index].Source) {
+      Start += Segments[Index].FileSize;
+    }
+
+    End = Segments[Index].Target + Segments[Index].MemSize;
+    if ((Offset < End) && (Offset + Size > Start)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Find the segment whose file data holds a file range.
+
+  @param[in]  Segments            The segments.
+  @param[in]  Count               The number of segments.
+  @param[in]  Offset              The offset of the range in the file.
+  @param[in]  Size                The size of the range.
+
+  @return The index of the segment, Count if the range is outside all segments.
+**/
+STATIC
+UINT32
+FindElfInPlaceSegment (
+  IN ELF_IN_PLACE_SEGMENT  *Segments,
+  IN UINT32                Count,
+  IN UINTN                 Offset,
+  IN UINTN                 Size
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < Count; Index++) {
+    if ((Offset >= Segments[Index].Source) &&
+        (Offset + Size <= Segments[Index].Source + Segments[Index].FileSize))
+    {
+      break;
+    }
+  }
+
+  return Index;
+}
+
+/**
+  Read the file range of a section that must survive an in-place load.
+
+  Symbol and string tables outside the image, except the section name
+  table, are not needed once the image is loaded and may be overwritten.
+
+  @param[in]  ElfCt               ELF image context pointer.
+  @param[in]  Index               ELF section index.
+  @param[out] Offset              The offset of the section in the file.
+  @param[out] Size                The size of the section in the file, 0 if
+                                  nothing of it must be kept.
+  @param[out] Alignment           The alignment of the section.
+  @param[out] Alloc               TRUE if the section is part of the image.
+**/
+STATIC
+VOID
+GetElfInPlaceSectionRange (
+  IN  ELF_IMAGE_CONTEXT  *ElfCt,
+  IN  UINT32             Index,
+  OUT UINTN              *Offset,
+  OUT UINTN              *Size,
+  OUT UINTN              *Alignment,
+  OUT BOOLEAN            *Alloc
+  )
+{
+  Elf32_Ehdr  *Elf32Hdr;
+  Elf32_Shdr  *Elf32Shdr;
+  Elf64_Shdr  *Elf64Shdr;
+  UINT32      Type;
+  UINT64      Flags;
+  UINT32      ShStrNdx;
+
+  *Offset    = 0;
+  *Size      = 0;
+  *Alignment = 1;
+  *Alloc     = FALSE;
+  Elf32Hdr   = (Elf32_Ehdr *)ElfCt->FileBase;
+  if (ElfCt->EiClass == ELFCLASS32) {
+    Elf32Shdr = GetElf32SectionByIndex (ElfCt->FileBase, Index);
+    if (Elf32Shdr == NULL) {
+      return;
+    }
+
+    ShStrNdx   = Elf32Hdr->e_shstrndx;
+    Type       = Elf32Shdr->sh_type;
+    Flags      = Elf32Shdr->sh_flags;
+    *Offset    = Elf32Shdr->sh_offset;
+    *Size      = Elf32Shdr->sh_size;
+    *Alignment = Elf32Shdr->sh_addralign;
+  } else {
+    Elf64Shdr = GetElf64SectionByIndex (ElfCt->FileBase, Index);
+    if (Elf64Shdr == NULL) {
+      return;
+    }
+
+    ShStrNdx   = ((Elf64_Ehdr *)Elf32Hdr)->e_shstrndx;
+    Type       = Elf64Shdr->sh_type;
+    Flags      = Elf64Shdr->sh_flags;
+    *Offset    = (UINTN)Elf64Shdr->sh_offset;
+    *Size      = (UINTN)Elf64Shdr->sh_size;
+    *Alignment = (UINTN)Elf64Shdr->sh_addralign;
+  }
+
+  *Alloc = (BOOLEAN)((Flags & SHF_ALLOC) != 0);
+  if ((Type == SHT_NULL) || (Type == SHT_NOBITS) ||
+      (!*Alloc && ((Type == SHT_SYMTAB) || ((Type == SHT_STRTAB) && (Index != ShStrNdx)))))
+  {
+    *Size = 0;
+  }
+}
+
+/**
+  Update the file offset of a section.
+
+  @param[in]  ElfCt               ELF image context pointer.
+  @param[in]  Index               ELF section index.
+  @param[in]  Offset              The new offset.
+**/
+STATIC
+VOID
+SetElfSectionOffset (
+  IN ELF_IMAGE_CONTEXT  *ElfCt,
+  IN UINT32             Index,
+  IN UINTN              Offset
+  )
+{
+  if (ElfCt->EiClass == ELFCLASS32) {
+    GetElf32SectionByIndex (ElfCt->FileBase, Index)->sh_offset = (Elf32_Off)Offset;
+  } else {
+    GetElf64SectionByIndex (ElfCt->FileBase, Index)->sh_offset = Offset;
+  }
+}
+
+/**
+  Make an ELF image loadable inside its own file buffer.
+
+  Loading in place writes the segments to [FileBase, FileBase + ImageSize).
+  The ELF header, the program and section header tables and the sections
+  still used after the load, relocations, the section name table and the
+  sections the caller reports, must not be written over. The ones in the
+  way are moved after the end of the file and the headers are updated, so
+  the section offsets must be read after this call. Nothing is changed
+  when the image cannot be loaded in place.
+
+  On success ElfCt->ImageAddress is set to ElfCt->FileBase.
+
+  @param[in]  ElfCt               ELF image context pointer.
+  @param[in]  BufferSize          The size of the buffer at ElfCt->FileBase.
+
+  @retval INVALID_PARAMETER   ElfCt is NULL.
+  @retval UNSUPPORTED         The image cannot be loaded in this buffer.
+  @retval SUCCESS             The image can be loaded in place.
+**/
+RETURN_STATUS
+PrepareElfInPlaceLoad (
+  IN  ELF_IMAGE_CONTEXT  *ElfCt,
+  IN  UINTN              BufferSize
+  )
+{
+  RETURN_STATUS         Status;
+  ELF_IN_PLACE_SEGMENT  Segments[ELF_IN_PLACE_MAX_SEGMENTS];
+  UINT32                Count;
+  Elf32_Ehdr            *Elf32Hdr;
+  Elf64_Ehdr            *Elf64Hdr;
+  UINTN                 EhSize;
+  UINTN                 PhOff;
+  UINTN                 PhSize;
+  UINTN                 ShOff;
+  UINTN                 ShSize;
+  UINTN                 Offset;
+  UINTN                 Size;
+  UINTN                 Alignment;
+  UINTN                 TailStart;
+  UINTN                 Tail;
+  BOOLEAN               Alloc;
+  BOOLEAN               Move;
+  BOOLEAN               MovePh;
+  BOOLEAN               MoveSh;
+  UINT32                Pass;
+  UINT32                Index;
+
+  if (ElfCt == NULL) {
+    return INVALID_PARAMETER;
+  }
+
+  if (ERROR (ElfCt->ParseStatus)) {
+    return ElfCt->ParseStatus;
+  }
+
+  if (ElfCt->ImageSize > BufferSize) {
+    return UNSUPPORTED;
+  }
+
+  Status = GetElfInPlaceSegments (ElfCt, Segments, &Count);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  Elf32Hdr = (Elf32_Ehdr *)ElfCt->FileBase;
+  Elf64Hdr = (Elf64_Ehdr *)ElfCt->FileBase;
+  if (ElfCt->EiClass == ELFCLASS32) {
+    EhSize = Elf32Hdr->e_ehsize;
+    PhOff  = Elf32Hdr->e_phoff;
+    PhSize = (UINTN)Elf32Hdr->e_phentsize * Elf32Hdr->e_phnum;
+    ShOff  = Elf32Hdr->e_shoff;
+    ShSize = (UINTN)Elf32Hdr->e_shentsize * Elf32Hdr->e_shnum;
+  } else {
+    EhSize = Elf64Hdr->e_ehsize;
+    PhOff  = (UINTN)Elf64Hdr->e_phoff;
+    PhSize = (UINTN)Elf64Hdr->e_phentsize * Elf64Hdr->e_phnum;
+    ShOff  = (UINTN)Elf64Hdr->e_shoff;
+    ShSize = (UINTN)Elf64Hdr->e_shentsize * Elf64Hdr->e_shnum;
+  }
+
+  //
+  // The headers either stay where they are or are moved, never loaded to a
+  // different place as part of a segment.
+  //
+  Index = FindElfInPlaceSegment (Segments, Count, 0, EhSize);
+  if ((Index < Count) ? (Segments[Index].Target != Segments[Index].Source) : IsElfInPlaceRangeWritten (Segments, Count, 0, EhSize)) {
+    return UNSUPPORTED;
+  }
+
+  Index = FindElfInPlaceSegment (Segments, Count, PhOff, PhSize);
+  if ((Index < Count) && (Segments[Index].Target != Segments[Index].Source)) {
+    return UNSUPPORTED;
+  }
+
+  MovePh = (BOOLEAN)((Index == Count) && IsElfInPlaceRangeWritten (Segments, Count, PhOff, PhSize));
+
+  Index = FindElfInPlaceSegment (Segments, Count, ShOff, ShSize);
+  if ((Index < Count) && (Segments[Index].Target != Segments[Index].Source)) {
+    return UNSUPPORTED;
+  }
+
+  MoveSh = (BOOLEAN)((Index == Count) && IsElfInPlaceRangeWritten (Segments, Count, ShOff, ShSize));
+
+  //
+  // The first pass checks everything fits, the second one moves.
+  //
+  TailStart = ALIGN_VALUE (MAX (ElfCt->FileSize, ElfCt->ImageSize), 16);
+  for (Pass = 0; Pass < 2; Pass++) {
+    Tail = TailStart;
+    if (MovePh) {
+      if (Pass == 1) {
+        CopyMem (ElfCt->FileBase + Tail, ElfCt->FileBase + PhOff, PhSize);
+        if (ElfCt->EiClass == ELFCLASS32) {
+          Elf32Hdr->e_phoff = (Elf32_Off)Tail;
+        } else {
+          Elf64Hdr->e_phoff = Tail;
+        }
+      }
+
+      Tail = ALIGN_VALUE (Tail + PhSize, 16);
+    }
+
+    for (Index = 0; Index < ElfCt->ShNum; Index++) {
+      GetElfInPlaceSectionRange (ElfCt, Index, &Offset, &Size, &Alignment, &Alloc);
+      if (Size == 0) {
+        continue;
+      }
+
+      //
+      // Sections in a segment are loaded with it, the others must be out of
+      // the way or be moved.
+      //
+      if (FindElfInPlaceSegment (Segments, Count, Offset, Size) < Count) {
+        continue;
+      }
+
+      if (Alloc || (Offset + Size > ElfCt->FileSize)) {
+        return UNSUPPORTED;
+      }
+
+      Move = IsElfInPlaceRangeWritten (Segments, Count, Offset, Size);
+      if (!Move) {
+        continue;
+      }
+
+      if ((Alignment < 16) || (Alignment > SIZE_4KB) || ((Alignment & (Alignment - 1)) != 0)) {
+        Alignment = 16;
+      }
+
+      Tail = ALIGN_VALUE (Tail, Alignment);
+      if (Pass == 1) {
+        CopyMem (ElfCt->FileBase + Tail, ElfCt->FileBase + Offset, Size);
+        SetElfSectionOffset (ElfCt, Index, Tail);
+        if (Offset == ElfCt->ShStrOff) {
+          ElfCt->ShStrOff = Tail;
+        }
+      }
+
+      Tail += Size;
+    }
+
+    if (MoveSh) {
+      Tail = ALIGN_VALUE (Tail, 16);
+      if (Pass == 1) {
+        CopyMem (ElfCt->FileBase + Tail, ElfCt->FileBase + ShOff, ShSize);
+        if (ElfCt->EiClass == ELFCLASS32) {
+          Elf32Hdr->e_shoff = (Elf32_Off)Tail;
+        } else {
+          Elf64Hdr->e_shoff = Tail;
+        }
+      }
+
+      Tail += ShSize;
+    }
+
+    if (Tail > BufferSize) {
+      return UNSUPPORTED;
+    }
+  }
+
+  ElfCt->FileSize     = MAX (ElfCt->FileSize, Tail);
+  ElfCt->ImageAddress = ElfCt->FileBase;
+  return SUCCESS;
+}
+
+/**
+  Load the segments of an ELF image prepared by PrepareElfInPlaceLoad()
+  inside its own file buffer.
+
+  Segments moving down are moved first, lowest first, then segments moving
+  up, highest first, so no segment overwrites file data not moved yet. The
+  zero-filled tails come last as they may cover file data of other
+  segments. The program and section headers are updated to the new file
+  offsets, relocation reads them afterwards.
+
+  @param[in]  ElfCt               ELF image context pointer.
+
+  @retval UNSUPPORTED         The segments cannot be loaded in place.
+  @retval SUCCESS             The segments are loaded.
+**/
+RETURN_STATUS
+LoadElfSegmentsInPlace (
+  IN  ELF_IMAGE_CONTEXT  *ElfCt
+  )
+{
+  RETURN_STATUS         Status;
+  ELF_IN_PLACE_SEGMENT  Segments[ELF_IN_PLACE_MAX_SEGMENTS];
+  UINT32                Count;
+  UINT32                Index;
+  UINT32                Segment;
+  UINT8                 *Base;
+  UINTN                 Offset;
+  UINTN                 Size;
+  UINTN                 Alignment;
+  BOOLEAN               Alloc;
+  Elf32_Phdr            *Elf32Phdr;
+  Elf64_Phdr            *Elf64Phdr;
+
+  Status = GetElfInPlaceSegments (ElfCt, Segments, &Count);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  Base = ElfCt->FileBase;
+  for (Index = 0; Index < Count; Index++) {
+    if (Segments[Index].Target < Segments[Index].Source) {
+      CopyMem (Base + Segments[Index].Target, Base + Segments[Index].Source, Segments[Index].FileSize);
+    }
+  }
+
+  for (Index = Count; Index > 0; Index--) {
+    if (Segments[Index - 1].Target > Segments[Index - 1].Source) {
+      CopyMem (Base + Segments[Index - 1].Target, Base + Segments[Index - 1].Source, Segments[Index - 1].FileSize);
+    }
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    ZeroMem (Base + Segments[Index].Target + Segments[Index].FileSize, Segments[Index].MemSize - Segments[Index].FileSize);
+  }
+
+  //
+  // Point the headers of everything in a moved segment to its new place.
+  //
+  for (Index = 0; Index < ElfCt->ShNum; Index++) {
+    GetElfInPlaceSectionRange (ElfCt, Index, &Offset, &Size, &Alignment, &Alloc);
+    Segment = FindElfInPlaceSegment (Segments, Count, Offset, Size);
+    if ((Size != 0) && (Segment < Count) && (Segments[Segment].Target != Segments[Segment].Source)) {
+      SetElfSectionOffset (ElfCt, Index, Offset - Segments[Segment].Source + Segments[Segment].Target);
+    }
+  }
+
+  for (Index = 0; Index < ElfCt->PhNum; Index++) {
+    if (ElfCt->EiClass == ELFCLASS32) {
+      Elf32Phdr = GetElf32SegmentByIndex (Base, Index);
+      Segment   = FindElfInPlaceSegment (Segments, Count, Elf32Phdr->p_offset, Elf32Phdr->p_filesz);
+      if ((Elf32Phdr->p_filesz != 0) && (Segment < Count) && (Segments[Segment].Target != Segments[Segment].Source)) {
+        Elf32Phdr->p_offset = (Elf32_Off)(Elf32Phdr->p_offset - Segments[Segment].Source + Segments[Segment].Target);
+      }
+    } else {
+      Elf64Phdr = GetElf64SegmentByIndex (Base, Index);
+      Segment   = FindElfInPlaceSegment (Segments, Count, (UINTN)Elf64Phdr->p_offset, (UINTN)Elf64Phdr->p_filesz);
+      if ((Elf64Phdr->p_filesz != 0) && (Segment < Count) && (Segments[Segment].Target != Segments[Segment].Source)) {
+        Elf64Phdr->p_offset = Elf64Phdr->p_offset - Segments[Segment].Source + Segments[Segment].Target;
+      }
+    }
+  }
+
+  return SUCCESS;
+}
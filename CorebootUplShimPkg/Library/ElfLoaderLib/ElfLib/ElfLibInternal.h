@@ -17,6 +17,18 @@
 #define ELF_NEXT_ENTRY(EntryType, Current, EntrySize) \
               ((EntryType *) ((UINT8 *)Current + EntrySize))
 
+#define ELF_IN_PLACE_MAX_SEGMENTS  16
+
+///
+/// A PT_LOAD segment loaded in place, offsets are relative to FileBase.
+///
+typedef struct {
+  UINTN    Source;
+  UINTN    Target;
+  UINTN    FileSize;
+  UINTN    MemSize;
+} ELF_IN_PLACE_SEGMENT;
+
 /**
   Return the section header specified by Index.
 
@@ -102,4 +114,18 @@ LoadElf64Image (
   IN    ELF_IMAGE_CONTEXT  *ElfCt
   );
 
+/**
+  Load the segments of an ELF image prepared by PrepareElfInPlaceLoad()
+  inside its own file buffer.
+
+  @param[in]  ElfCt               ELF image context pointer.
+
+  @retval UNSUPPORTED         The segments cannot be loaded in place.
+  @retval SUCCESS             The segments are loaded.
+**/
+RETURN_STATUS
+LoadElfSegmentsInPlace (
+  IN  ELF_IMAGE_CONTEXT  *ElfCt
+  );
+
 #endif
@@ -8,8 +8,56 @@
 **/
 
 #include "HobLib.h"
-
-VOID  *mHobList;
+#include <UniversalPayload.h>
+#include <ShimLayer/GuidHobIndex.h>
+#include <ShimLayer/LargeGuidHob.h>
+
+GUID gShimGuidHobIndexGuid = { 0x3ad3e71d, 0x6874, 0x4b1a, { 0x88, 0xfa, 0xd0, 0x5c, 0x3b, 0xd6, 0x2a, 0xd7 }};
+GUID gShimLargeGuidHobGuid = { 0x3f2315c3, 0x82a7, 0x45c7, { 0xb0, 0x8f, 0x01, 0xfc, 0x8f, 0xaf, 0x90, 0xde }};
+
+//
+// The most data a GUID HOB can hold, HOB lengths are UINT16 multiples of 8.
+//
+#define MAX_GUID_HOB_DATA_LENGTH  ((MAX_UINT16 & ~0x7) - sizeof (HOB_GUID_TYPE))
+
+VOID       *mHobList;
+
+//
+// Serializes HOB creation and page allocation from the HOB region, so they
+// can be used from APs running shim jobs.
+//
+SPIN_LOCK  mHobLock;
+
+//
+// The live page allocations, sorted by address. Their memory allocation
+// HOBs are only built before the handoff so freed pages leave no trace.
+//
+#define HOB_ALLOCATION_COUNT  64
+
+typedef struct {
+  ADDRESS        Base;
+  ADDRESS        End;
+  MEMORY_TYPE    Type;
+} HOB_ALLOCATION;
+
+STATIC HOB_ALLOCATION  mAllocation[HOB_ALLOCATION_COUNT];
+STATIC UINT32          mAllocationCount;
+STATIC BOOLEAN         mAllocationHobsBuilt;
+STATIC ADDRESS         mAllocationTop;
+
+//
+// Kept up to date under mHobLock, found by its signature in a memory dump
+// when the shim does not reach the handoff.
+//
+STATIC SHIM_HOB_USAGE  mHobUsage;
+
+#define HOB_USAGE_INDEX(HobType)  (((HobType) < SHIM_HOB_USAGE_TYPE_COUNT) ? (HobType) : 0)
+
+//
+// Set by HobBuildGuidHobIndex(), GetNextGuidHob() searches it for the HOBs
+// it covers.
+//
+STATIC SHIM_GUID_HOB_INDEX  *mGuidHobIndex;
 
 /**
   Returns the pointer to the HOB list.
@@ -27,6 +75,26 @@ GetHobList (
   return mHobList;
 }
 
+/**
+  Account the current HOB list end and free HOB region, the caller must hold
+  mHobLock.
+
+  @param  HandOffHob    The PHIT HOB.
+
+**/
+STATIC
+VOID
+InternalUpdateHobUsage (
+  IN HOB_HANDOFF_INFO_TABLE  *HandOffHob
+  )
+{
+  mHobUsage.HobListSize = HandOffHob->FreeMemoryBottom - (ADDRESS)(UINTN)HandOffHob;
+  mHobUsage.FreeSize    = HandOffHob->FreeMemoryTop - HandOffHob->FreeMemoryBottom;
+  if (mHobUsage.FreeSize < mHobUsage.MinFreeSize) {
+    mHobUsage.MinFreeSize = mHobUsage.FreeSize;
+  }
+}
+
 /**
   Build a Handoff Information Table HOB
 
@@ -69,16 +137,27 @@ HobConstructor (
 
   Hob->MemoryTop        = (ADDRESS)(UINTN)MemoryTop;
   Hob->MemoryBottom     = (ADDRESS)(UINTN)MemoryBottom;
-  Hob->FreeMemoryTop    = (ADDRESS)(UINTN)FreeMemoryTop;
+  Hob->FreeMemoryTop    = (ADDRESS)(UINTN)FreeMemoryTop & ~(ADDRESS)PAGE_MASK;
   Hob->FreeMemoryBottom = (ADDRESS)(UINTN)(HobEnd+1);
   Hob->EndOfHobList     = (ADDRESS)(UINTN)HobEnd;
 
-  mHobList = Hob;
+  mHobList       = Hob;
+  mAllocationTop = Hob->FreeMemoryTop;
+
+  ZeroMem (&mHobUsage, sizeof (mHobUsage));
+  mHobUsage.Header.Revision            = SHIM_HOB_USAGE_REVISION;
+  mHobUsage.Header.Length              = sizeof (SHIM_HOB_USAGE);
+  mHobUsage.Signature                  = SHIM_HOB_USAGE_SIGNATURE;
+  mHobUsage.HobList                    = (ADDRESS)(UINTN)Hob;
+  mHobUsage.HobCount[HOB_TYPE_HANDOFF] = 1;
+  mHobUsage.HobBytes[HOB_TYPE_HANDOFF] = sizeof (HOB_HANDOFF_INFO_TABLE);
+  mHobUsage.MinFreeSize                = MAX_UINT64;
+  InternalUpdateHobUsage (Hob);
   return Hob;
 }
 
 /**
-  Add a new HOB to the HOB List.
+  Add a new HOB to the HOB List, the caller must hold mHobLock.
 
   @param HobType            Type of the new HOB.
   @param HobLength          Length of the new HOB to allocate.
@@ -87,8 +166,9 @@ HobConstructor (
   @return  The address point to the new created hob.
 
 **/
+STATIC
 VOID *
-CreateHob (
+InternalCreateHob (
   IN  UINT16  HobType,
   IN  UINT16  HobLength
   )
@@ -105,6 +185,7 @@ CreateHob (
   FreeMemory = HandOffHob->FreeMemoryTop - HandOffHob->FreeMemoryBottom;
 
   if (FreeMemory < HobLength) {
+    mHobUsage.FailedHobCount++;
     return NULL;
   }
 
@@ -122,9 +203,428 @@ CreateHob (
   HobEnd++;
   HandOffHob->FreeMemoryBottom = (ADDRESS)(UINTN)HobEnd;
 
+  mHobUsage.HobCount[HOB_USAGE_INDEX (HobType)]++;
+  mHobUsage.HobBytes[HOB_USAGE_INDEX (HobType)] += HobLength;
+  InternalUpdateHobUsage (HandOffHob);
   return Hob;
 }
 
+/**
+  Add a new HOB to the HOB List.
+
+  @param HobType            Type of the new HOB.
+  @param HobLength          Length of the new HOB to allocate.
+
+  @return  NULL if there is no space to create a hob.
+  @return  The address point to the new created hob.
+
+**/
+VOID *
+CreateHob (
+  IN  UINT16  HobType,
+  IN  UINT16  HobLength
+  )
+{
+  VOID  *Hob;
+
+  AcquireSpinLock (&mHobLock);
+  Hob = InternalCreateHob (HobType, HobLength);
+  ReleaseSpinLock (&mHobLock);
+
+  return Hob;
+}
+
+/**
+  Record a live page allocation, the caller must hold mHobLock.
+
+  The table stays sorted by address, an allocation next to one of the same
+  memory type is merged with it.
+
+  @param  Base          The base of the allocation.
+  @param  End           The end of the allocation.
+  @param  MemoryType    The memory type of the allocation.
+
+  @retval TRUE          The allocation is recorded.
+  @retval FALSE         The table is full.
+
+**/
+STATIC
+BOOLEAN
+InternalInsertAllocation (
+  IN ADDRESS      Base,
+  IN ADDRESS      End,
+  IN MEMORY_TYPE  MemoryType
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; (Index < mAllocationCount) && (mAllocation[Index].Base < Base); Index++) {
+  }
+
+  if ((Index > 0) && (mAllocation[Index - 1].End == Base) && (mAllocation[Index - 1].Type == MemoryType)) {
+    mAllocation[Index - 1].End = End;
+    if ((Index < mAllocationCount) && (mAllocation[Index].Base == End) && (mAllocation[Index].Type == MemoryType)) {
+      mAllocation[Index - 1].End = mAllocation[Index].End;
+      CopyMem (&mAllocation[Index], &mAllocation[Index + 1], (mAllocationCount - Index - 1) * sizeof (HOB_ALLOCATION));
+      mAllocationCount--;
+    }
+
+    return TRUE;
+  }
+
+  if ((Index < mAllocationCount) && (mAllocation[Index].Base == End) && (mAllocation[Index].Type == MemoryType)) {
+    mAllocation[Index].Base = Base;
+    return TRUE;
+  }
+
+  if (mAllocationCount == HOB_ALLOCATION_COUNT) {
+    return FALSE;
+  }
+
+  CopyMem (&mAllocation[Index + 1], &mAllocation[Index], (mAllocationCount - Index) * sizeof (HOB_ALLOCATION));
+  mAllocation[Index].Base = Base;
+  mAllocation[Index].End  = End;
+  mAllocation[Index].Type = MemoryType;
+  mAllocationCount++;
+  return TRUE;
+}
+
+/**
+  Forget a part of a live page allocation, the caller must hold mHobLock.
+
+  @param  Base          The base of the part to forget.
+  @param  End           The end of the part to forget.
+
+  @retval SUCCESS       The part is no longer allocated.
+  @retval NOT_FOUND     The part is not within a single allocation.
+  @retval ABORTED       No room to record the upper part of a split
+                        allocation.
+
+**/
+STATIC
+RETURN_STATUS
+InternalRemoveAllocation (
+  IN ADDRESS  Base,
+  IN ADDRESS  End
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < mAllocationCount; Index++) {
+    if ((Base >= mAllocation[Index].Base) && (End <= mAllocation[Index].End)) {
+      break;
+    }
+  }
+
+  if (Index == mAllocationCount) {
+    return NOT_FOUND;
+  }
+
+  if ((Base == mAllocation[Index].Base) && (End == mAllocation[Index].End)) {
+    CopyMem (&mAllocation[Index], &mAllocation[Index + 1], (mAllocationCount - Index - 1) * sizeof (HOB_ALLOCATION));
+    mAllocationCount--;
+  } else if (Base == mAllocation[Index].Base) {
+    mAllocation[Index].Base = End;
+  } else if (End == mAllocation[Index].End) {
+    mAllocation[Index].End = Base;
+  } else {
+    //
+    // Freeing the middle of the allocation leaves two parts.
+    //
+    if (mAllocationCount == HOB_ALLOCATION_COUNT) {
+      return ABORTED;
+    }
+
+    CopyMem (&mAllocation[Index + 1], &mAllocation[Index], (mAllocationCount - Index) * sizeof (HOB_ALLOCATION));
+    mAllocation[Index].End      = Base;
+    mAllocation[Index + 1].Base = End;
+    mAllocationCount++;
+  }
+
+  return SUCCESS;
+}
+
+/**
+  Allocates pages from the free HOB region.
+
+  Pages freed by HobFreePages() are reused first, the highest free range
+  that fits is taken. Otherwise the pages are taken from the top of the
+  free HOB region. The allocation is described by a memory allocation HOB
+  when HobBuildMemoryAllocationHobs() is called, or right away after it.
+
+  The page and the HOB allocation happen under one lock, so concurrent
+  callers never hand out overlapping memory.
+
+  @param  Pages         The number of 4 KB pages to allocate.
+  @param  Alignment     The alignment of the allocation, a power of two.
+                        Any value up to 4 KB gives page alignment.
+  @param  MemoryType    The memory type reported in the allocation HOB.
+
+  @return A pointer to the allocated buffer or NULL if allocation fails.
+
+**/
+VOID *
+HobAllocateAlignedPages (
+  IN UINTN        Pages,
+  IN UINTN        Alignment,
+  IN MEMORY_TYPE  MemoryType
+  )
+{
+  HOB_HANDOFF_INFO_TABLE  *HandOffHob;
+  HOB_MEMORY_ALLOCATION   *Hob;
+  ADDRESS                 Size;
+  ADDRESS                 Base;
+  ADDRESS                 GapBottom;
+  ADDRESS                 GapTop;
+  UINT32                  Index;
+
+  if ((Pages == 0) || ((Alignment & (Alignment - 1)) != 0)) {
+    return NULL;
+  }
+
+  if (Alignment < PAGE_SIZE) {
+    Alignment = PAGE_SIZE;
+  }
+
+  Size = (ADDRESS)Pages * PAGE_SIZE;
+
+  AcquireSpinLock (&mHobLock);
+  HandOffHob = GetHobList ();
+
+  //
+  // Walk the free ranges between the live allocations from the top. The
+  // lowest one extends down to the HOB list, it leaves room for the HOB
+  // describing the allocation.
+  //
+  Base = 0;
+  for (Index = mAllocationCount + 1; Index > 0; Index--) {
+    GapTop    = (Index > mAllocationCount) ? mAllocationTop : mAllocation[Index - 1].Base;
+    GapBottom = (Index > 1) ? mAllocation[Index - 2].End : HandOffHob->FreeMemoryBottom + sizeof (HOB_MEMORY_ALLOCATION);
+    if (GapTop < GapBottom + Size) {
+      continue;
+    }
+
+    Base = (GapTop - Size) & ~((ADDRESS)Alignment - 1);
+    if (Base >= GapBottom) {
+      break;
+    }
+
+    Base = 0;
+  }
+
+  if ((Base == 0) || !InternalInsertAllocation (Base, Base + Size, MemoryType)) {
+    mHobUsage.FailedAllocationCount++;
+    ReleaseSpinLock (&mHobLock);
+    return NULL;
+  }
+
+  if (Base < HandOffHob->FreeMemoryTop) {
+    HandOffHob->FreeMemoryTop = Base;
+  }
+
+  //
+  // Pages that cannot be described any more are given back, the payload
+  // would otherwise see them as free memory. Removing the range just
+  // inserted cannot fail, a merge on both sides freed a table entry.
+  //
+  Hob = NULL;
+  if (mAllocationHobsBuilt) {
+    Hob = InternalCreateHob (HOB_TYPE_MEMORY_ALLOCATION, sizeof (HOB_MEMORY_ALLOCATION));
+    if (Hob == NULL) {
+      InternalRemoveAllocation (Base, Base + Size);
+      HandOffHob->FreeMemoryTop = (mAllocationCount == 0) ? mAllocationTop : mAllocation[0].Base;
+      mHobUsage.FailedAllocationCount++;
+      InternalUpdateHobUsage (HandOffHob);
+      ReleaseSpinLock (&mHobLock);
+      return NULL;
+    }
+  }
+
+  mHobUsage.AllocatedSize += Size;
+  if (mHobUsage.AllocatedSize > mHobUsage.PeakAllocatedSize) {
+    mHobUsage.PeakAllocatedSize = mHobUsage.AllocatedSize;
+  }
+
+  InternalUpdateHobUsage (HandOffHob);
+  ReleaseSpinLock (&mHobLock);
+
+  if (Hob != NULL) {
+    ZeroMem (&(Hob->AllocDescriptor.Name), sizeof (GUID));
+    Hob->AllocDescriptor.MemoryBaseAddress = Base;
+    Hob->AllocDescriptor.MemoryLength      = Size;
+    Hob->AllocDescriptor.MemoryType        = MemoryType;
+    ZeroMem (Hob->AllocDescriptor.Reserved, sizeof (Hob->AllocDescriptor.Reserved));
+  }
+
+  return (VOID *)(UINTN)Base;
+}
+
+/**
+  Allocates pages from the free HOB region.
+
+  @param  Pages         The number of 4 KB pages to allocate.
+  @param  MemoryType    The memory type reported in the allocation HOB.
+
+  @return A pointer to the allocated buffer or NULL if allocation fails.
+
+**/
+VOID *
+HobAllocatePages (
+  IN UINTN        Pages,
+  IN MEMORY_TYPE  MemoryType
+  )
+{
+  return HobAllocateAlignedPages (Pages, PAGE_SIZE, MemoryType);
+}
+
+/**
+  Frees pages allocated by HobAllocatePages() or HobAllocateAlignedPages().
+
+  The pages may be any page aligned part of one allocation. They are
+  merged with the free ranges around them and can be allocated again, the
+  payload sees them as free memory. Pages can no longer be freed once
+  HobBuildMemoryAllocationHobs() described the allocations.
+
+  @param  Buffer        The first page to free.
+  @param  Pages         The number of 4 KB pages to free.
+
+  @retval SUCCESS            The pages are freed.
+  @retval INVALID_PARAMETER  Buffer is not page aligned or Pages is 0.
+  @retval NOT_FOUND          The pages are not part of a single allocation.
+  @retval ABORTED            No room to record the upper part of a split
+                             allocation.
+  @retval UNSUPPORTED        The allocation HOBs are already built.
+
+**/
+RETURN_STATUS
+HobFreePages (
+  IN VOID   *Buffer,
+  IN UINTN  Pages
+  )
+{
+  HOB_HANDOFF_INFO_TABLE  *HandOffHob;
+  RETURN_STATUS           Status;
+  ADDRESS                 Base;
+  ADDRESS                 End;
+
+  Base = (ADDRESS)(UINTN)Buffer;
+  End  = Base + (ADDRESS)Pages * PAGE_SIZE;
+  if ((Pages == 0) || ((Base & PAGE_MASK) != 0)) {
+    return INVALID_PARAMETER;
+  }
+
+  AcquireSpinLock (&mHobLock);
+  if (mAllocationHobsBuilt) {
+    ReleaseSpinLock (&mHobLock);
+    return UNSUPPORTED;
+  }
+
+  Status = InternalRemoveAllocation (Base, End);
+  if (ERROR (Status)) {
+    ReleaseSpinLock (&mHobLock);
+    return Status;
+  }
+
+  //
+  // Free pages at the bottom of the allocations return to the free HOB region.
+  //
+  HandOffHob                = GetHobList ();
+  HandOffHob->FreeMemoryTop = (mAllocationCount == 0) ? mAllocationTop : mAllocation[0].Base;
+  mHobUsage.AllocatedSize  -= End - Base;
+  InternalUpdateHobUsage (HandOffHob);
+
+  ReleaseSpinLock (&mHobLock);
+  return SUCCESS;
+}
+
+/**
+  Describes the live page allocations with memory allocation HOBs.
+
+  Only the memory still allocated gets a HOB, one per run of adjacent
+  allocations of a memory type. Pages allocated later get their HOB right
+  away and can no longer be freed.
+
+**/
+VOID
+HobBuildMemoryAllocationHobs (
+  VOID
+  )
+{
+  HOB_MEMORY_ALLOCATION  *Hob;
+  UINT32                 Index;
+
+  AcquireSpinLock (&mHobLock);
+  for (Index = 0; Index < mAllocationCount; Index++) {
+    Hob = InternalCreateHob (HOB_TYPE_MEMORY_ALLOCATION, sizeof (HOB_MEMORY_ALLOCATION));
+    if (Hob == NULL) {
+      break;
+    }
+
+    ZeroMem (&(Hob->AllocDescriptor.Name), sizeof (GUID));
+    Hob->AllocDescriptor.MemoryBaseAddress = mAllocation[Index].Base;
+    Hob->AllocDescriptor.MemoryLength      = mAllocation[Index].End - mAllocation[Index].Base;
+    Hob->AllocDescriptor.MemoryType        = mAllocation[Index].Type;
+    ZeroMem (Hob->AllocDescriptor.Reserved, sizeof (Hob->AllocDescriptor.Reserved));
+  }
+
+  mAllocationHobsBuilt = TRUE;
+  ReleaseSpinLock (&mHobLock);
+}
+
+/**
+  Returns how much memory the page allocator handed out.
+
+  @param  PeakSize      Return the most memory allocated at any time.
+  @param  CurrentSize   Return the memory allocated now.
+
+**/
+VOID
+HobGetAllocationUsage (
+  OUT UINT64  *PeakSize,
+  OUT UINT64  *CurrentSize
+  )
+{
+  AcquireSpinLock (&mHobLock);
+  *PeakSize    = mHobUsage.PeakAllocatedSize;
+  *CurrentSize = mHobUsage.AllocatedSize;
+  ReleaseSpinLock (&mHobLock);
+}
+
+/**
+  Records the size of a decompression scratch buffer in the HOB usage.
+
+  @param  Size          The size of the scratch buffer.
+
+**/
+VOID
+HobRecordScratchUsage (
+  IN UINTN  Size
+  )
+{
+  AcquireSpinLock (&mHobLock);
+  if (Size > mHobUsage.PeakScratchSize) {
+    mHobUsage.PeakScratchSize = Size;
+  }
+
+  ReleaseSpinLock (&mHobLock);
+}
+
+/**
+  Returns the use of the HOB region so far.
+
+  @param  Usage         Return the HOB usage record.
+
+**/
+VOID
+HobGetUsage (
+  OUT SHIM_HOB_USAGE  *Usage
+  )
+{
+  AcquireSpinLock (&mHobLock);
+  CopyMem (Usage, &mHobUsage, sizeof (SHIM_HOB_USAGE));
+  ReleaseSpinLock (&mHobLock);
+}
+
 /**
   Builds a HOB that describes a chunk of system memory.
 
@@ -148,6 +648,9 @@ BuildResourceDescriptorHob (
   HOB_RESOURCE_DESCRIPTOR  *Hob;
 
   Hob = CreateHob (HOB_TYPE_RESOURCE_DESCRIPTOR, sizeof (HOB_RESOURCE_DESCRIPTOR));
+  if (Hob == NULL) {
+    return;
+  }
 
   Hob->ResourceType      = ResourceType;
   Hob->ResourceAttribute = ResourceAttribute;
@@ -216,6 +719,47 @@ GetFirstHob (
   return GetNextHob (Type, HobList);
 }
 
+/**
+  Compare two GUID HOB index entries, by the bytes of their GUID and then by
+  their offset.
+
+  @param  Buffer1       The first SHIM_GUID_HOB_INDEX_ENTRY.
+  @param  Buffer2       The second SHIM_GUID_HOB_INDEX_ENTRY.
+
+  @retval <0            Buffer1 sorts before Buffer2.
+  @retval 0             The entries are equal.
+  @retval >0            Buffer1 sorts after Buffer2.
+**/
+STATIC
+intn
+CompareGuidHobIndexEntry (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  CONST SHIM_GUID_HOB_INDEX_ENTRY  *Entry1;
+  CONST SHIM_GUID_HOB_INDEX_ENTRY  *Entry2;
+  CONST UINT8                      *Name1;
+  CONST UINT8                      *Name2;
+  UINTN                            Index;
+
+  Entry1 = (CONST SHIM_GUID_HOB_INDEX_ENTRY *)Buffer1;
+  Entry2 = (CONST SHIM_GUID_HOB_INDEX_ENTRY *)Buffer2;
+  Name1  = (CONST UINT8 *)&Entry1->Name;
+  Name2  = (CONST UINT8 *)&Entry2->Name;
+  for (Index = 0; Index < sizeof (GUID); Index++) {
+    if (Name1[Index] != Name2[Index]) {
+      return (intn)Name1[Index] - (intn)Name2[Index];
+    }
+  }
+
+  if (Entry1->Offset != Entry2->Offset) {
+    return (Entry1->Offset < Entry2->Offset) ? -1 : 1;
+  }
+
+  return 0;
+}
+
 /**
   This function searches the first instance of a HOB from the starting HOB pointer.
   Such HOB should satisfy two conditions:
@@ -241,7 +785,38 @@ GetNextGuidHob (
   IN const VOID   *HobStart
   )
 {
-  HOB_POINTERS  GuidHob;
+  HOB_POINTERS               GuidHob;
+  SHIM_GUID_HOB_INDEX_ENTRY  Key;
+  UINTN                      Low;
+  UINTN                      High;
+  UINTN                      Middle;
+
+  //
+  // Binary search the index for the first match at or after HobStart, then
+  // walk the HOBs added after the index only.
+  //
+  Key.Offset = (UINT32)((UINTN)HobStart - (UINTN)GetHobList ());
+  if ((mGuidHobIndex != NULL) && ((UINTN)HobStart >= (UINTN)GetHobList ()) &&
+      (Key.Offset < mGuidHobIndex->HobListLength))
+  {
+    CopyGuid (&Key.Name, Guid);
+    Low  = 0;
+    High = mGuidHobIndex->Count;
+    while (Low < High) {
+      Middle = (Low + High) / 2;
+      if (CompareGuidHobIndexEntry (&mGuidHobIndex->Entry[Middle], &Key) < 0) {
+        Low = Middle + 1;
+      } else {
+        High = Middle;
+      }
+    }
+
+    if ((Low < mGuidHobIndex->Count) && CompareGuid (Guid, &mGuidHobIndex->Entry[Low].Name)) {
+      return (UINT8 *)GetHobList () + mGuidHobIndex->Entry[Low].Offset;
+    }
+
+    HobStart = (UINT8 *)GetHobList () + mGuidHobIndex->HobListLength;
+  }
 
   GuidHob.Raw = (UINT8 *)HobStart;
   while ((GuidHob.Raw = GetNextHob (HOB_TYPE_GUID_EXTENSION, GuidHob.Raw)) != NULL) {
@@ -290,13 +865,14 @@ GetFirstGuidHob (
   It can only be invoked during PEI phase;
   for DXE phase, it will ASSERT() since PEI HOB is read-only for DXE phase.
   If Guid is NULL, then ASSERT().
-  If there is no additional space for HOB creation, then ASSERT().
-  If DataLength >= (0x10000 - sizeof (HOB_GUID_TYPE)), then ASSERT().
+  If there is no additional space for HOB creation, then NULL is returned.
+  If DataLength > (0xFFF8 - sizeof (HOB_GUID_TYPE)), then NULL is returned.
 
   @param  Guid          The GUID to tag the customized HOB.
   @param  DataLength    The size of the data payload for the GUID HOB.
 
-  @return The start address of GUID HOB data.
+  @return The start address of GUID HOB data, or NULL if there is no
+          additional space for HOB creation.
 
 **/
 VOID *
@@ -304,14 +880,214 @@ BuildGuidHob (
   IN const GUID  *Guid,
   IN UINTN       DataLength
   )
+{
+  return HobReserveGuidHob (Guid, DataLength);
+}
+
+/**
+  Reserves a GUID HOB for the caller to fill in place.
+
+  The data is not initialized, BuildGuidHob() is the same for callers that
+  fill the data from a copy.
+
+  @param  Guid          The GUID to tag the HOB.
+  @param  DataLength    The size of the data of the GUID HOB.
+
+  @return The start address of the GUID HOB data, or NULL if there is no
+          room for it.
+
+**/
+VOID *
+HobReserveGuidHob (
+  IN CONST GUID  *Guid,
+  IN UINTN       DataLength
+  )
 {
   HOB_GUID_TYPE  *Hob;
 
+  if (DataLength > MAX_GUID_HOB_DATA_LENGTH) {
+    return NULL;
+  }
+
   Hob = CreateHob (HOB_TYPE_GUID_EXTENSION, (UINT16)(sizeof (HOB_GUID_TYPE) + DataLength));
+  if (Hob == NULL) {
+    return NULL;
+  }
+
   CopyGuid (&Hob->Name, Guid);
   return Hob + 1;
 }
 
+/**
+  Reserves GUID data of any length for the caller to fill in place.
+
+  Data that fits in a HOB gets a GUID HOB. Larger data gets pages of its
+  own, described by a gShimLargeGuidHobGuid HOB. The data is not
+  initialized.
+
+  @param  Guid          The GUID to tag the data.
+  @param  DataLength    The size of the data.
+
+  @return The start address of the data, or NULL if there is no room for it.
+
+**/
+VOID *
+HobReserveLargeGuidHob (
+  IN CONST GUID  *Guid,
+  IN UINTN       DataLength
+  )
+{
+  SHIM_LARGE_GUID_HOB  *LargeHob;
+  VOID                 *Data;
+
+  if (DataLength <= MAX_GUID_HOB_DATA_LENGTH) {
+    return HobReserveGuidHob (Guid, DataLength);
+  }
+
+  Data = HobAllocatePages (SIZE_TO_PAGES (DataLength), BootServicesData);
+  if (Data == NULL) {
+    return NULL;
+  }
+
+  LargeHob = HobReserveGuidHob (&gShimLargeGuidHobGuid, sizeof (SHIM_LARGE_GUID_HOB));
+  if (LargeHob == NULL) {
+    HobFreePages (Data, SIZE_TO_PAGES (DataLength));
+    return NULL;
+  }
+
+  LargeHob->Header.Revision = SHIM_LARGE_GUID_HOB_REVISION;
+  LargeHob->Header.Reserved = 0;
+  LargeHob->Header.Length   = sizeof (SHIM_LARGE_GUID_HOB);
+  LargeHob->Reserved        = 0;
+  CopyGuid (&LargeHob->Name, Guid);
+  LargeHob->Base = (UINTN)Data;
+  LargeHob->Size = DataLength;
+  return Data;
+}
+
+/**
+  Gives back GUID data reserved by HobReserveGuidHob() or
+  HobReserveLargeGuidHob() the caller did not fill.
+
+  The space of the last HOB of the list is reused, any other HOB is left
+  in place as an unused HOB.
+
+  @param  Data          The start address of the data.
+
+**/
+VOID
+HobReleaseGuidHob (
+  IN VOID  *Data
+  )
+{
+  HOB_HANDOFF_INFO_TABLE  *HandOffHob;
+  SHIM_LARGE_GUID_HOB     *LargeHob;
+  HOB_POINTERS            Hob;
+
+  HandOffHob = GetHobList ();
+  if (((UINTN)Data < (UINTN)HandOffHob) || ((UINTN)Data >= (UINTN)HandOffHob->EndOfHobList)) {
+    //
+    // The data has pages of its own, release the HOB describing them.
+    //
+    Hob.Raw = GetFirstGuidHob (&gShimLargeGuidHobGuid);
+    while (Hob.Raw != NULL) {
+      LargeHob = GET_GUID_HOB_DATA (Hob.Guid);
+      if (LargeHob->Base == (UINTN)Data) {
+        break;
+      }
+
+      Hob.Raw = GetNextGuidHob (&gShimLargeGuidHobGuid, GET_NEXT_HOB (Hob));
+    }
+
+    if (Hob.Raw == NULL) {
+      return;
+    }
+
+    HobFreePages (Data, SIZE_TO_PAGES ((UINTN)LargeHob->Size));
+    Data = LargeHob;
+  }
+
+  Hob.Raw = (UINT8 *)Data - sizeof (HOB_GUID_TYPE);
+
+  AcquireSpinLock (&mHobLock);
+  mHobUsage.HobCount[HOB_TYPE_GUID_EXTENSION]--;
+  mHobUsage.HobBytes[HOB_TYPE_GUID_EXTENSION] -= Hob.Header->HobLength;
+  if ((UINTN)GET_NEXT_HOB (Hob) == (UINTN)HandOffHob->EndOfHobList) {
+    Hob.Header->HobType          = HOB_TYPE_END_OF_HOB_LIST;
+    Hob.Header->HobLength        = sizeof (HOB_GENERIC_HEADER);
+    HandOffHob->EndOfHobList     = (ADDRESS)(UINTN)Hob.Raw;
+    HandOffHob->FreeMemoryBottom = (ADDRESS)(UINTN)(Hob.Header + 1);
+    InternalUpdateHobUsage (HandOffHob);
+  } else {
+    Hob.Header->HobType = HOB_TYPE_UNUSED;
+    mHobUsage.HobCount[HOB_USAGE_INDEX (HOB_TYPE_UNUSED)]++;
+    mHobUsage.HobBytes[HOB_USAGE_INDEX (HOB_TYPE_UNUSED)] += Hob.Header->HobLength;
+  }
+
+  ReleaseSpinLock (&mHobLock);
+}
+
+/**
+  Builds the gShimGuidHobIndexGuid HOB indexing every GUID HOB in the list.
+
+  GetNextGuidHob() uses the index from then on, HOBs built later are still
+  found by walking the list after it.
+
+  @retval SUCCESS       The index is built.
+  @retval UNSUPPORTED   The index does not fit in a HOB.
+**/
+RETURN_STATUS
+HobBuildGuidHobIndex (
+  VOID
+  )
+{
+  SHIM_GUID_HOB_INDEX        *GuidHobIndex;
+  SHIM_GUID_HOB_INDEX_ENTRY  *Entry;
+  SHIM_GUID_HOB_INDEX_ENTRY  Swap;
+  HOB_POINTERS               Hob;
+  UINT32                     Count;
+  UINTN                      Length;
+
+  //
+  // One entry for each GUID HOB, and one for the index itself.
+  //
+  Count   = 1;
+  Hob.Raw = GetHobList ();
+  while ((Hob.Raw = GetNextHob (HOB_TYPE_GUID_EXTENSION, Hob.Raw)) != NULL) {
+    Count++;
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+
+  Length = sizeof (SHIM_GUID_HOB_INDEX) + Count * sizeof (SHIM_GUID_HOB_INDEX_ENTRY);
+  if (Length > MAX_GUID_HOB_DATA_LENGTH) {
+    return UNSUPPORTED;
+  }
+
+  GuidHobIndex = BuildGuidHob (&gShimGuidHobIndexGuid, Length);
+  if (GuidHobIndex == NULL) {
+    return UNSUPPORTED;
+  }
+
+  GuidHobIndex->Header.Revision = SHIM_GUID_HOB_INDEX_REVISION;
+  GuidHobIndex->Header.Reserved = 0;
+  GuidHobIndex->Header.Length   = (UINT16)Length;
+  GuidHobIndex->Count           = Count;
+  GuidHobIndex->HobListLength   = (UINT32)(((HOB_HANDOFF_INFO_TABLE *)GetHobList ())->EndOfHobList - (UINTN)GetHobList ());
+
+  Entry   = GuidHobIndex->Entry;
+  Hob.Raw = GetHobList ();
+  while ((Hob.Raw = GetNextHob (HOB_TYPE_GUID_EXTENSION, Hob.Raw)) != NULL) {
+    CopyGuid (&Entry->Name, &Hob.Guid->Name);
+    Entry->Offset = (UINT32)((UINTN)Hob.Raw - (UINTN)GetHobList ());
+    Entry++;
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+
+  QuickSort (GuidHobIndex->Entry, Count, sizeof (SHIM_GUID_HOB_INDEX_ENTRY), CompareGuidHobIndexEntry, &Swap);
+  mGuidHobIndex = GuidHobIndex;
+  return SUCCESS;
+}
+
 /**
   Copies a data buffer to a newly-built HOB.
 
@@ -322,14 +1098,15 @@ BuildGuidHob (
   for DXE phase, it will ASSERT() since PEI HOB is read-only for DXE phase.
   If Guid is NULL, then ASSERT().
   If Data is NULL and DataLength > 0, then ASSERT().
-  If there is no additional space for HOB creation, then ASSERT().
-  If DataLength >= (0x10000 - sizeof (HOB_GUID_TYPE)), then ASSERT().
+  If there is no additional space for HOB creation, then NULL is returned.
+  If DataLength > (0xFFF8 - sizeof (HOB_GUID_TYPE)), then NULL is returned.
 
   @param  Guid          The GUID to tag the customized HOB.
   @param  Data          The data to be copied into the data field of the GUID HOB.
   @param  DataLength    The size of the data payload for the GUID HOB.
 
-  @return The start address of GUID HOB data.
+  @return The start address of GUID HOB data, or NULL if there is no
+          additional space for HOB creation.
 
 **/
 VOID *
@@ -342,6 +1119,9 @@ ShBuildGuidDataHob (
   VOID  *HobData;
 
   HobData = BuildGuidHob (Guid, DataLength);
+  if (HobData == NULL) {
+    return NULL;
+  }
 
   return CopyMem (HobData, Data, DataLength);
 }
@@ -367,6 +1147,9 @@ ShBuildFvHob (
   HOB_FIRMWARE_VOLUME  *Hob;
 
   Hob = CreateHob (HOB_TYPE_FV, sizeof (HOB_FIRMWARE_VOLUME));
+  if (Hob == NULL) {
+    return;
+  }
 
   Hob->BaseAddress = BaseAddress;
   Hob->Length      = Length;
@@ -397,6 +1180,9 @@ ShBuildFv2Hob (
   HOB_FIRMWARE_VOLUME2  *Hob;
 
   Hob = CreateHob (HOB_TYPE_FV2, sizeof (HOB_FIRMWARE_VOLUME2));
+  if (Hob == NULL) {
+    return;
+  }
 
   Hob->BaseAddress = BaseAddress;
   Hob->Length      = Length;
@@ -437,6 +1223,9 @@ ShBuildFv3Hob (
   HOB_FIRMWARE_VOLUME3  *Hob;
 
   Hob = CreateHob (HOB_TYPE_FV3, sizeof (HOB_FIRMWARE_VOLUME3));
+  if (Hob == NULL) {
+    return;
+  }
 
   Hob->BaseAddress          = BaseAddress;
   Hob->Length               = Length;
@@ -469,6 +1258,9 @@ ShBuildCpuHob (
   HOB_CPU  *Hob;
 
   Hob = CreateHob (HOB_TYPE_CPU, sizeof (HOB_CPU));
+  if (Hob == NULL) {
+    return;
+  }
 
   Hob->SizeOfMemorySpace = SizeOfMemorySpace;
   Hob->SizeOfIoSpace     = SizeOfIoSpace;
@@ -502,6 +1294,9 @@ BuildMemoryAllocationHob (
   HOB_MEMORY_ALLOCATION  *Hob;
 
   Hob = CreateHob (HOB_TYPE_MEMORY_ALLOCATION, sizeof (HOB_MEMORY_ALLOCATION));
+  if (Hob == NULL) {
+    return;
+  }
 
   ZeroMem (&(Hob->AllocDescriptor.Name), sizeof (GUID));
   Hob->AllocDescriptor.MemoryBaseAddress = BaseAddress;
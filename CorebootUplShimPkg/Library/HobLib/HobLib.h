@@ -11,6 +11,8 @@
 
 #include <Base.h>
 #include <BaseLib.h>
+#include <UniversalPayload.h>
+#include <ShimLayer/HobUsage.h>
 
 //
 // 0x21 - 0xf..f are reserved.
@@ -91,6 +93,121 @@ CreateHob (
   IN  UINT16  HobLength
   );
 
+/**
+  Allocates pages from the free HOB region.
+
+  @param  Pages         The number of 4 KB pages to allocate.
+  @param  MemoryType    The memory type reported in the allocation HOB.
+
+  @return A pointer to the allocated buffer or NULL if allocation fails.
+
+**/
+VOID *
+HobAllocatePages (
+  IN UINTN        Pages,
+  IN MEMORY_TYPE  MemoryType
+  );
+
+/**
+  Allocates aligned pages from the free HOB region.
+
+  @param  Pages         The number of 4 KB pages to allocate.
+  @param  Alignment     The alignment of the allocation, a power of two.
+                        Any value up to 4 KB gives page alignment.
+  @param  MemoryType    The memory type reported in the allocation HOB.
+
+  @return A pointer to the allocated buffer or NULL if allocation fails.
+
+**/
+VOID *
+HobAllocateAlignedPages (
+  IN UINTN        Pages,
+  IN UINTN        Alignment,
+  IN MEMORY_TYPE  MemoryType
+  );
+
+/**
+  Frees pages allocated by HobAllocatePages() or HobAllocateAlignedPages().
+
+  The pages may be any page aligned part of one allocation.
+
+  @param  Buffer        The first page to free.
+  @param  Pages         The number of 4 KB pages to free.
+
+  @retval SUCCESS            The pages are freed.
+  @retval INVALID_PARAMETER  Buffer is not page aligned or Pages is 0.
+  @retval NOT_FOUND          The pages are not part of a single allocation.
+  @retval ABORTED            No room to record the upper part of a split
+                             allocation.
+  @retval UNSUPPORTED        The allocation HOBs are already built.
+
+**/
+RETURN_STATUS
+HobFreePages (
+  IN VOID   *Buffer,
+  IN UINTN  Pages
+  );
+
+/**
+  Describes the live page allocations with memory allocation HOBs.
+
+  Pages allocated later get their HOB right away and can no longer be freed.
+
+**/
+VOID
+HobBuildMemoryAllocationHobs (
+  VOID
+  );
+
+/**
+  Builds the gShimGuidHobIndexGuid HOB indexing every GUID HOB in the list.
+
+  GetNextGuidHob() uses the index from then on, HOBs built later are still
+  found by walking the list after it.
+
+  @retval SUCCESS       The index is built.
+  @retval UNSUPPORTED   The index does not fit in a HOB.
+**/
+RETURN_STATUS
+HobBuildGuidHobIndex (
+  VOID
+  );
+
+/**
+  Returns how much memory the page allocator handed out.
+
+  @param  PeakSize      Return the most memory allocated at any time.
+  @param  CurrentSize   Return the memory allocated now.
+
+**/
+VOID
+HobGetAllocationUsage (
+  OUT UINT64  *PeakSize,
+  OUT UINT64  *CurrentSize
+  );
+
+/**
+  Records the size of a decompression scratch buffer in the HOB usage.
+
+  @param  Size          The size of the scratch buffer.
+
+**/
+VOID
+HobRecordScratchUsage (
+  IN UINTN  Size
+  );
+
+/**
+  Returns the use of the HOB region so far.
+
+  @param  Usage         Return the HOB usage record.
+
+**/
+VOID
+HobGetUsage (
+  OUT SHIM_HOB_USAGE  *Usage
+  );
+
 /**
   Builds a HOB for the memory allocation.
 
@@ -142,13 +259,14 @@ BuildResourceDescriptorHob (
   It can only be invoked during PEI phase;
   for DXE phase, it will ASSERT() since PEI HOB is read-only for DXE phase.
   If Guid is NULL, then ASSERT().
-  If there is no additional space for HOB creation, then ASSERT().
-  If DataLength >= (0x10000 - sizeof (HOB_GUID_TYPE)), then ASSERT().
+  If there is no additional space for HOB creation, then NULL is returned.
+  If DataLength > (0xFFF8 - sizeof (HOB_GUID_TYPE)), then NULL is returned.
 
   @param  Guid          The GUID to tag the customized HOB.
   @param  DataLength    The size of the data payload for the GUID HOB.
 
-  @return The start address of GUID HOB data.
+  @return The start address of GUID HOB data, or NULL if there is no
+          additional space for HOB creation.
 
 **/
 VOID *
@@ -158,6 +276,65 @@ BuildGuidHob (
   IN UINTN       DataLength
   );
 
+/**
+  Reserves a GUID HOB for the caller to fill in place.
+
+  The data is not initialized, BuildGuidHob() is the same for callers that
+  fill the data from a copy.
+
+  @param  Guid          The GUID to tag the HOB.
+  @param  DataLength    The size of the data of the GUID HOB.
+
+  @return The start address of the GUID HOB data, or NULL if there is no
+          room for it.
+
+**/
+VOID *
+HobReserveGuidHob (
+  IN CONST GUID  *Guid,
+  IN UINTN       DataLength
+  );
+
+///
+/// Reserves a GUID HOB holding one Type, returns a Type pointer to fill.
+///
+#define HOB_RESERVE_GUID_HOB(Guid, Type) \
+  ((Type *)HobReserveGuidHob ((Guid), sizeof (Type)))
+
+/**
+  Reserves GUID data of any length for the caller to fill in place.
+
+  Data that fits in a HOB gets a GUID HOB. Larger data gets pages of its
+  own, described by a gShimLargeGuidHobGuid HOB. The data is not
+  initialized.
+
+  @param  Guid          The GUID to tag the data.
+  @param  DataLength    The size of the data.
+
+  @return The start address of the data, or NULL if there is no room for it.
+
+**/
+VOID *
+HobReserveLargeGuidHob (
+  IN CONST GUID  *Guid,
+  IN UINTN       DataLength
+  );
+
+/**
+  Gives back GUID data reserved by HobReserveGuidHob() or
+  HobReserveLargeGuidHob() the caller did not fill.
+
+  The space of the last HOB of the list is reused, any other HOB is left
+  in place as an unused HOB.
+
+  @param  Data          The start address of the data.
+
+**/
+VOID
+HobReleaseGuidHob (
+  IN VOID  *Data
+  );
+
 /**
   Builds a HOB for the CPU.
 
@@ -177,6 +354,60 @@ ShBuildCpuHob (
   IN UINT8  SizeOfIoSpace
   );
 
+/**
+  Builds a Firmware Volume HOB.
+
+  @param  BaseAddress   The base address of the Firmware Volume.
+  @param  Length        The size of the Firmware Volume in bytes.
+
+**/
+VOID
+ShBuildFvHob (
+  IN ADDRESS  BaseAddress,
+  IN UINT64   Length
+  );
+
+/**
+  Builds a HOB_TYPE_FV2 HOB.
+
+  @param  BaseAddress   The base address of the Firmware Volume.
+  @param  Length        The size of the Firmware Volume in bytes.
+  @param  FvName        The name of the Firmware Volume.
+  @param  FileName      The name of the file.
+
+**/
+VOID
+ShBuildFv2Hob (
+  IN          ADDRESS  BaseAddress,
+  IN          UINT64   Length,
+  IN const    GUID     *FvName,
+  IN const    GUID     *FileName
+  );
+
+/**
+  Builds a HOB_TYPE_FV3 HOB.
+
+  @param BaseAddress            The base address of the Firmware Volume.
+  @param Length                 The size of the Firmware Volume in bytes.
+  @param AuthenticationStatus   The authentication status.
+  @param ExtractedFv            TRUE if the FV was extracted as a file within
+                                another firmware volume. FALSE otherwise.
+  @param FvName                 The name of the Firmware Volume.
+                                Valid only if IsExtractedFv is TRUE.
+  @param FileName               The name of the file.
+                                Valid only if IsExtractedFv is TRUE.
+
+**/
+VOID
+ShBuildFv3Hob (
+  IN          ADDRESS  BaseAddress,
+  IN          UINT64   Length,
+  IN          UINT32   AuthenticationStatus,
+  IN          BOOLEAN  ExtractedFv,
+  IN const    GUID     *FvName  OPTIONAL,
+  IN const    GUID     *FileName OPTIONAL
+  );
+
 
 /**
   Returns the next instance of a HOB type from the starting HOB.
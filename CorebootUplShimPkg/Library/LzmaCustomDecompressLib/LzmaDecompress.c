@@ -69,6 +69,18 @@ SzFree (
 
 #define LZMA_HEADER_SIZE  (LZMA_PROPS_SIZE + 8)
 
+//
+// State of an incremental decompression, kept at the start of the scratch
+// buffer. The rest of the scratch buffer backs the decoder allocations.
+//
+typedef struct {
+  ISzAllocWithData    AllocFuncs;
+  CLzmaDec            Decoder;
+  CONST Byte          *Input;
+  SizeT               InputSize;
+  SizeT               OutputSize;
+} LZMA_DECOMPRESS_STATE;
+
 /**
   Get the size of the uncompressed buffer by parsing EncodeData header.
 
@@ -217,3 +229,111 @@ LzmaUefiDecompress (
     return RETURN_INVALID_PARAMETER;
   }
 }
+
+/**
+  Prepare the decompression of a Lzma compressed source buffer in steps.
+
+  The decompression state is kept in Scratch, so Source, Destination and
+  Scratch must stay untouched until the last LzmaUefiDecompressContinue().
+  Decoded data is never moved once written, so the beginning of Destination
+  can be consumed while the rest is still being decompressed.
+
+  @param  Source      The source buffer containing the compressed data.
+  @param  SourceSize  The size of source buffer.
+  @param  Destination The destination buffer to store the decompressed data
+  @param  Scratch     A temporary scratch buffer of the size returned by
+                      LzmaUefiDecompressGetInfo().
+
+  @retval  RETURN_SUCCESS The decompression is ready to start.
+  @retval  RETURN_INVALID_PARAMETER
+                          The source buffer specified by Source is corrupted
+                          (not in a valid compressed format).
+**/
+RETURN_STATUS
+LzmaUefiDecompressBegin (
+  IN CONST VOID  *Source,
+  IN UINTN       SourceSize,
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  )
+{
+  LZMA_DECOMPRESS_STATE  *State;
+
+  if (SourceSize < LZMA_HEADER_SIZE) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  State                             = (LZMA_DECOMPRESS_STATE *)Scratch;
+  State->AllocFuncs.Functions.Alloc = SzAlloc;
+  State->AllocFuncs.Functions.Free  = SzFree;
+  State->AllocFuncs.Buffer          = State + 1;
+  State->AllocFuncs.BufferSize      = SCRATCH_BUFFER_REQUEST_SIZE - sizeof (LZMA_DECOMPRESS_STATE);
+
+  LzmaDec_Construct (&State->Decoder);
+  if (LzmaDec_AllocateProbs (&State->Decoder, Source, LZMA_PROPS_SIZE, &(State->AllocFuncs.Functions)) != SZ_OK) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  State->OutputSize         = (SizeT)GetDecodedSizeOfBuf ((UINT8 *)Source);
+  State->Input              = (CONST Byte *)Source + LZMA_HEADER_SIZE;
+  State->InputSize          = (SizeT)(SourceSize - LZMA_HEADER_SIZE);
+  State->Decoder.dic        = Destination;
+  State->Decoder.dicBufSize = State->OutputSize;
+  LzmaDec_Init (&State->Decoder);
+  return RETURN_SUCCESS;
+}
+
+/**
+  Continue a decompression prepared by LzmaUefiDecompressBegin() until at
+  least Limit bytes of the destination buffer are decoded.
+
+  @param  Scratch     The scratch buffer passed to LzmaUefiDecompressBegin().
+  @param  Limit       The number of destination bytes to decode up to, it is
+                      capped to the decompressed size.
+  @param  DecodedSize The number of destination bytes decoded so far.
+
+  @retval  RETURN_SUCCESS Limit bytes are decoded, the decompression is
+                          complete once DecodedSize reaches the decompressed
+                          size.
+  @retval  RETURN_INVALID_PARAMETER
+                          The source buffer is corrupted or truncated.
+**/
+RETURN_STATUS
+LzmaUefiDecompressContinue (
+  IN OUT VOID   *Scratch,
+  IN     UINTN  Limit,
+  OUT    UINTN  *DecodedSize
+  )
+{
+  LZMA_DECOMPRESS_STATE  *State;
+  SRes                   LzmaResult;
+  ELzmaStatus            Status;
+  SizeT                  InputSize;
+
+  State = (LZMA_DECOMPRESS_STATE *)Scratch;
+  if (Limit > State->OutputSize) {
+    Limit = State->OutputSize;
+  }
+
+  LzmaResult = SZ_OK;
+  if (State->Decoder.dicPos < Limit) {
+    InputSize  = State->InputSize;
+    LzmaResult = LzmaDec_DecodeToDic (
+                   &State->Decoder,
+                   Limit,
+                   State->Input,
+                   &InputSize,
+                   (Limit == State->OutputSize) ? LZMA_FINISH_END : LZMA_FINISH_ANY,
+                   &Status
+                   );
+    State->Input     += InputSize;
+    State->InputSize -= InputSize;
+  }
+
+  *DecodedSize = State->Decoder.dicPos;
+  if ((LzmaResult != SZ_OK) || (State->Decoder.dicPos < Limit)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  return RETURN_SUCCESS;
+}
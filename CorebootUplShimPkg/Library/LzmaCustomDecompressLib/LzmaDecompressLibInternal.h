@@ -84,4 +84,45 @@ LzmaUefiDecompress (
   IN OUT VOID    *Scratch
   );
 
+/**
+  Prepare the decompression of a Lzma compressed source buffer in steps.
+
+  @param  Source      The source buffer containing the compressed data.
+  @param  SourceSize  The size of source buffer.
+  @param  Destination The destination buffer to store the decompressed data
+  @param  Scratch     A temporary scratch buffer of the size returned by
+                      LzmaUefiDecompressGetInfo().
+
+  @retval  RETURN_SUCCESS The decompression is ready to start.
+  @retval  RETURN_INVALID_PARAMETER
+                          The source buffer specified by Source is corrupted
+                          (not in a valid compressed format).
+**/
+RETURN_STATUS
+LzmaUefiDecompressBegin (
+  IN CONST VOID  *Source,
+  IN UINTN       SourceSize,
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  );
+
+/**
+  Continue a decompression prepared by LzmaUefiDecompressBegin() until at
+  least Limit bytes of the destination buffer are decoded.
+
+  @param  Scratch     The scratch buffer passed to LzmaUefiDecompressBegin().
+  @param  Limit       The number of destination bytes to decode up to.
+  @param  DecodedSize The number of destination bytes decoded so far.
+
+  @retval  RETURN_SUCCESS Limit bytes are decoded.
+  @retval  RETURN_INVALID_PARAMETER
+                          The source buffer is corrupted or truncated.
+**/
+RETURN_STATUS
+LzmaUefiDecompressContinue (
+  IN OUT VOID   *Scratch,
+  IN     UINTN  Limit,
+  OUT    UINTN  *DecodedSize
+  );
+
 #endif
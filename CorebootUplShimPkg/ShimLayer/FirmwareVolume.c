@@ -0,0 +1,642 @@
+/** @file
+  Firmware volume helpers of the shim layer.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "ShimLayer.h"
+
+#define MAX_EXPANDED_FV_SECTIONS  8
+
+typedef struct {
+  FFS_FILE_HEADER    *File;
+  CONST VOID         *Source;
+  UINT32             SourceSize;
+  VOID               *Destination;
+  UINT32             DestinationSize;
+  VOID               *Scratch;
+  UINT32             ScratchSize;
+  RETURN_STATUS      Status;
+} FV_SECTION_EXPANSION;
+
+/**
+  Check whether a buffer starts with a valid firmware volume.
+
+  The signature, the header length and checksum, and the volume length are
+  checked. The files in the volume are not.
+
+  @param  FvHeader           The buffer to check.
+  @param  Size               The size of the buffer.
+
+  @retval TRUE               The buffer holds a firmware volume of FvHeader->FvLength bytes.
+  @retval FALSE              The buffer does not start with a valid firmware volume.
+**/
+BOOLEAN
+IsValidFirmwareVolume (
+  IN CONST FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN UINT64                        Size
+  )
+{
+  if (Size < sizeof (FIRMWARE_VOLUME_HEADER)) {
+    return FALSE;
+  }
+
+  if ((FvHeader->Signature != FVH_SIGNATURE) ||
+      (FvHeader->HeaderLength < sizeof (FIRMWARE_VOLUME_HEADER)) ||
+      ((FvHeader->HeaderLength & 1) != 0) ||
+      (FvHeader->FvLength < FvHeader->HeaderLength) ||
+      (FvHeader->FvLength > Size))
+  {
+    return FALSE;
+  }
+
+  return (BOOLEAN)(CalculateSum16 ((CONST UINT16 *)FvHeader, FvHeader->HeaderLength) == 0);
+}
+
+/**
+  Get the size of an FFS file, including its header.
+
+  @param  File               The FFS file header.
+
+  @return The size of the file.
+**/
+STATIC
+UINT32
+GetFfsFileSize (
+  IN CONST FFS_FILE_HEADER  *File
+  )
+{
+  if (IS_FFS_FILE2 (File)) {
+    return FFS_FILE2_SIZE (File);
+  }
+
+  return FFS_FILE_SIZE (File);
+}
+
+/**
+  Check whether an FFS file holds valid data.
+
+  The most significant State bit set, after undoing the erase polarity of
+  the volume, tells the state of the file.
+
+  @param  FvHeader           The firmware volume the file lives in.
+  @param  File               The FFS file header.
+
+  @retval TRUE               The file is valid.
+  @retval FALSE              The file is under construction or deleted.
+**/
+STATIC
+BOOLEAN
+IsFfsFileValid (
+  IN CONST FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN CONST FFS_FILE_HEADER         *File
+  )
+{
+  FFS_FILE_STATE  State;
+  FFS_FILE_STATE  HighestBit;
+
+  State = File->State;
+  if ((FvHeader->Attributes & FVB2_ERASE_POLARITY) != 0) {
+    State = (FFS_FILE_STATE) ~State;
+  }
+
+  HighestBit = 0x80;
+  while ((HighestBit != 0) && ((HighestBit & State) == 0)) {
+    HighestBit >>= 1;
+  }
+
+  return (BOOLEAN)((HighestBit == FILE_DATA_VALID) || (HighestBit == FILE_MARKED_FOR_UPDATE));
+}
+
+/**
+  Get the next FFS file of a firmware volume.
+
+  Files start 8-byte aligned after the volume header and the extended
+  header, the walk stops at the first header that does not fit in the
+  volume, which also covers the erased free space at its end.
+
+  @param  FvHeader           A valid firmware volume.
+  @param  File               On input, the current file or NULL to get the
+                             first one. On output, the next file.
+
+  @retval SUCCESS            The next file was returned.
+  @retval NOT_FOUND          There are no more files.
+**/
+STATIC
+RETURN_STATUS
+FvGetNextFile (
+  IN     FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN OUT FFS_FILE_HEADER         **File
+  )
+{
+  FIRMWARE_VOLUME_EXT_HEADER  *ExtHeader;
+  FFS_FILE_HEADER             *Next;
+  UINT64                      Offset;
+  UINT32                      Size;
+
+  if (*File == NULL) {
+    if (FvHeader->ExtHeaderOffset != 0) {
+      if ((UINT64)FvHeader->ExtHeaderOffset + sizeof (FIRMWARE_VOLUME_EXT_HEADER) > FvHeader->FvLength) {
+        return NOT_FOUND;
+      }
+
+      ExtHeader = (FIRMWARE_VOLUME_EXT_HEADER *)((UINT8 *)FvHeader + FvHeader->ExtHeaderOffset);
+      Offset    = (UINT64)FvHeader->ExtHeaderOffset + ExtHeader->ExtHeaderSize;
+    } else {
+      Offset = FvHeader->HeaderLength;
+    }
+  } else {
+    Offset = (UINT64)((UINT8 *)*File - (UINT8 *)FvHeader) + GetFfsFileSize (*File);
+  }
+
+  Offset = ALIGN_VALUE (Offset, 8);
+  if (Offset + sizeof (FFS_FILE_HEADER) > FvHeader->FvLength) {
+    return NOT_FOUND;
+  }
+
+  Next = (FFS_FILE_HEADER *)((UINT8 *)FvHeader + (UINTN)Offset);
+  if (IS_FFS_FILE2 (Next)) {
+    if (Offset + sizeof (FFS_FILE_HEADER2) > FvHeader->FvLength) {
+      return NOT_FOUND;
+    }
+
+    Size = FFS_FILE2_SIZE (Next);
+    if (Size < sizeof (FFS_FILE_HEADER2)) {
+      return NOT_FOUND;
+    }
+  } else {
+    Size = FFS_FILE_SIZE (Next);
+    if (Size < sizeof (FFS_FILE_HEADER)) {
+      return NOT_FOUND;
+    }
+  }
+
+  if (Offset + Size > FvHeader->FvLength) {
+    return NOT_FOUND;
+  }
+
+  *File = Next;
+  return SUCCESS;
+}
+
+/**
+  Find the first section of a given type in a buffer of sections.
+
+  Sections start 4-byte aligned relative to Buffer, the walk stops at the
+  first section that does not fit in the buffer.
+
+  @param  Buffer             The buffer holding the sections.
+  @param  Size               The size of the buffer.
+  @param  SectionType        The section type to search.
+  @param  Section            The section found.
+  @param  SectionSize        The size of the section found, including its header.
+  @param  HeaderSize         The size of the common header of the section found.
+
+  @retval SUCCESS            The section was found.
+  @retval NOT_FOUND          The section was not found.
+**/
+STATIC
+RETURN_STATUS
+FindSection (
+  IN  VOID                   *Buffer,
+  IN  UINT32                 Size,
+  IN  SECTION_TYPE           SectionType,
+  OUT COMMON_SECTION_HEADER  **Section,
+  OUT UINT32                 *SectionSize,
+  OUT UINT32                 *HeaderSize
+  )
+{
+  COMMON_SECTION_HEADER  *Current;
+  UINT32                 CurrentSize;
+  UINT32                 CurrentHeaderSize;
+  UINT32                 Index;
+
+  Index = 0;
+  while (Index + sizeof (COMMON_SECTION_HEADER) <= Size) {
+    Current = (COMMON_SECTION_HEADER *)((UINT8 *)Buffer + Index);
+    if (IS_SECTION2 (Current)) {
+      CurrentHeaderSize = sizeof (COMMON_SECTION_HEADER2);
+      CurrentSize       = (Index + CurrentHeaderSize <= Size) ? SECTION2_SIZE (Current) : 0;
+    } else {
+      CurrentHeaderSize = sizeof (COMMON_SECTION_HEADER);
+      CurrentSize       = SECTION_SIZE (Current);
+    }
+
+    if ((CurrentSize < CurrentHeaderSize) || (CurrentSize > Size - Index)) {
+      break;
+    }
+
+    if (Current->Type == SectionType) {
+      *Section     = Current;
+      *SectionSize = CurrentSize;
+      *HeaderSize  = CurrentHeaderSize;
+      return SUCCESS;
+    }
+
+    //
+    // Next Section is 4 byte aligned
+    //
+    Index += ALIGN_VALUE (CurrentSize, 4);
+  }
+
+  return NOT_FOUND;
+}
+
+/**
+  Find the first section of a given type in an FFS file.
+
+  @param  File               The FFS file header.
+  @param  SectionType        The section type to search.
+  @param  Section            The section found.
+  @param  SectionSize        The size of the section found, including its header.
+  @param  HeaderSize         The size of the common header of the section found.
+
+  @retval SUCCESS            The section was found.
+  @retval NOT_FOUND          The section was not found.
+**/
+STATIC
+RETURN_STATUS
+FindFileSection (
+  IN  FFS_FILE_HEADER        *File,
+  IN  SECTION_TYPE           SectionType,
+  OUT COMMON_SECTION_HEADER  **Section,
+  OUT UINT32                 *SectionSize,
+  OUT UINT32                 *HeaderSize
+  )
+{
+  UINT32  FileHeaderSize;
+
+  if (IS_FFS_FILE2 (File)) {
+    FileHeaderSize = sizeof (FFS_FILE_HEADER2);
+  } else {
+    FileHeaderSize = sizeof (FFS_FILE_HEADER);
+  }
+
+  return FindSection (
+           (UINT8 *)File + FileHeaderSize,
+           GetFfsFileSize (File) - FileHeaderSize,
+           SectionType,
+           Section,
+           SectionSize,
+           HeaderSize
+           );
+}
+
+/**
+  This function searchs a given section type within a valid FFS file.
+
+  @param  FileHeader            A pointer to the file header that contains the set of sections to
+                                be searched.
+  @param  SearchType            The value of the section type to search.
+  @param  SectionData           A pointer to the discovered section, if successful.
+
+  @retval SUCCESS           The section was found.
+  @retval NOT_FOUND         The section was not found.
+
+**/
+RETURN_STATUS
+FileFindSection (
+  IN FFS_FILE_HEADER        *FileHeader,
+  IN SECTION_TYPE           SectionType,
+  OUT VOID                  **SectionData
+  )
+{
+  RETURN_STATUS          Status;
+  COMMON_SECTION_HEADER  *Section;
+  UINT32                 SectionSize;
+  UINT32                 HeaderSize;
+
+  Status = FindFileSection (FileHeader, SectionType, &Section, &SectionSize, &HeaderSize);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  *SectionData = (UINT8 *)Section + HeaderSize;
+  return SUCCESS;
+}
+
+/**
+  This function searchs a given file type with a given Guid within a valid FV.
+  If input Guid is NULL, will locate the first section having the given file type
+
+  @param FvHeader        A pointer to firmware volume header that contains the set of files
+                         to be searched.
+  @param FileType        File type to be searched.
+  @param Guid            Will ignore if it is NULL.
+  @param FileHeader      A pointer to the discovered file, if successful.
+
+  @retval SUCCESS    Successfully found FileType
+  @retval NOT_FOUND  File type can't be found.
+**/
+RETURN_STATUS
+FvFindFileByTypeGuid (
+  IN  FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN  FV_FILETYPE             FileType,
+  IN  GUID                    *Guid           OPTIONAL,
+  OUT FFS_FILE_HEADER         **FileHeader
+  )
+{
+  FFS_FILE_HEADER  *File;
+
+  File = NULL;
+  while (!ERROR (FvGetNextFile (FvHeader, &File))) {
+    if ((File->Type == FileType) && IsFfsFileValid (FvHeader, File) &&
+        ((Guid == NULL) || CompareGuid (&File->Name, Guid)))
+    {
+      *FileHeader = File;
+      return SUCCESS;
+    }
+  }
+
+  return NOT_FOUND;
+}
+
+/**
+  Order two SHIM_FV_FILE_INDEX_ENTRY by the bytes of their names.
+
+  @param  Buffer1            The first entry.
+  @param  Buffer2            The second entry.
+
+  @return <0, 0 or >0 as the first name is below, equal to or above the second.
+**/
+STATIC
+intn
+CompareFvFileIndexEntry (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  CONST UINT8  *Name1;
+  CONST UINT8  *Name2;
+  UINTN        Index;
+
+  Name1 = (CONST UINT8 *)&((CONST SHIM_FV_FILE_INDEX_ENTRY *)Buffer1)->Name;
+  Name2 = (CONST UINT8 *)&((CONST SHIM_FV_FILE_INDEX_ENTRY *)Buffer2)->Name;
+  for (Index = 0; Index < sizeof (GUID); Index++) {
+    if (Name1[Index] != Name2[Index]) {
+      return (intn)Name1[Index] - (intn)Name2[Index];
+    }
+  }
+
+  return 0;
+}
+
+/**
+  Build the GUID HOB indexing the FFS files of a firmware volume.
+
+  The volume is walked once to count the files and once to fill the HOB,
+  the entries are then sorted in place.
+
+  @param  FvHeader           A valid firmware volume.
+
+  @retval SUCCESS            The index HOB was built.
+  @retval NOT_FOUND          The volume holds no file to index.
+  @retval UNSUPPORTED        No room for the index.
+**/
+RETURN_STATUS
+BuildFvFileIndexHob (
+  IN FIRMWARE_VOLUME_HEADER  *FvHeader
+  )
+{
+  SHIM_FV_FILE_INDEX        *FileIndex;
+  SHIM_FV_FILE_INDEX_ENTRY  *Entry;
+  SHIM_FV_FILE_INDEX_ENTRY  Swap;
+  FFS_FILE_HEADER           *File;
+  UINT32                    Count;
+  UINTN                     Length;
+
+  Count = 0;
+  File  = NULL;
+  while (!ERROR (FvGetNextFile (FvHeader, &File))) {
+    if ((File->Type != FV_FILETYPE_FFS_PAD) && IsFfsFileValid (FvHeader, File)) {
+      Count++;
+    }
+  }
+
+  if (Count == 0) {
+    return NOT_FOUND;
+  }
+
+  Length    = sizeof (SHIM_FV_FILE_INDEX) + Count * sizeof (SHIM_FV_FILE_INDEX_ENTRY);
+  FileIndex = HobReserveLargeGuidHob (&gShimFvFileIndexGuid, Length);
+  if (FileIndex == NULL) {
+    return UNSUPPORTED;
+  }
+
+  FileIndex->Header.Revision = SHIM_FV_FILE_INDEX_REVISION;
+  FileIndex->Header.Reserved = 0;
+  FileIndex->Header.Length   = (UINT16)MIN (Length, MAX_UINT16);
+  FileIndex->Count           = Count;
+  FileIndex->FvBase          = (UINTN)FvHeader;
+  FileIndex->FvLength        = FvHeader->FvLength;
+
+  Entry = FileIndex->Entry;
+  File  = NULL;
+  while (!ERROR (FvGetNextFile (FvHeader, &File))) {
+    if ((File->Type != FV_FILETYPE_FFS_PAD) && IsFfsFileValid (FvHeader, File)) {
+      CopyGuid (&Entry->Name, &File->Name);
+      Entry->Offset     = (UINT32)((UINT8 *)File - (UINT8 *)FvHeader);
+      Entry->Size       = GetFfsFileSize (File);
+      Entry->Type       = File->Type;
+      Entry->Attributes = File->Attributes;
+      Entry->Reserved   = 0;
+      Entry++;
+    }
+  }
+
+  QuickSort (FileIndex->Entry, Count, sizeof (SHIM_FV_FILE_INDEX_ENTRY), CompareFvFileIndexEntry, &Swap);
+  return SUCCESS;
+}
+
+/**
+  Decompress one LZMA GUIDed section, MpParallelFor() work item.
+
+  @param  Context            The FV_SECTION_EXPANSION array.
+  @param  Index              The section to decompress.
+**/
+STATIC
+VOID
+ExpandFvSectionProcedure (
+  IN VOID    *Context,
+  IN UINT32  Index
+  )
+{
+  FV_SECTION_EXPANSION  *Expansion;
+
+  Expansion         = &((FV_SECTION_EXPANSION *)Context)[Index];
+  Expansion->Status = LzmaUefiDecompress (
+                        Expansion->Source,
+                        Expansion->SourceSize,
+                        Expansion->Destination,
+                        Expansion->Scratch
+                        );
+}
+
+/**
+  Decompress the LZMA GUIDed sections of the firmware volume image files in
+  a firmware volume and report the firmware volumes they hold.
+
+  The sections are decompressed in parallel on the BSP and the APs. Each
+  expanded volume is moved to the start of its page aligned buffer, so it
+  meets any alignment up to 4KB, and reported through FV, FV2 and FV3 HOBs.
+  The FV2 HOB names the file it was extracted from, which tells the DXE
+  dispatcher not to extract it again. Volumes nested in an expanded volume
+  are left to the payload.
+
+  @param  FvHeader           A valid firmware volume.
+
+  @return The number of firmware volumes reported.
+**/
+UINT32
+ExpandFvImageSections (
+  IN FIRMWARE_VOLUME_HEADER  *FvHeader
+  )
+{
+  FV_SECTION_EXPANSION        Expansion[MAX_EXPANDED_FV_SECTIONS];
+  FIRMWARE_VOLUME_EXT_HEADER  *ExtHeader;
+  FIRMWARE_VOLUME_HEADER      *ExpandedFv;
+  FFS_FILE_HEADER             *File;
+  COMMON_SECTION_HEADER       *Section;
+  GUID_DEFINED_SECTION        *GuidSection;
+  GUID                        FvName;
+  SHIM_ARENA                  Arena;
+  RETURN_STATUS               Status;
+  UINT32                      SectionSize;
+  UINT32                      HeaderSize;
+  UINT32                      ScratchSize;
+  UINT32                      FvAlignment;
+  UINT32                      Count;
+  UINT32                      Reported;
+  UINT32                      Index;
+
+  Count       = 0;
+  ScratchSize = 0;
+  File        = NULL;
+  while ((Count < MAX_EXPANDED_FV_SECTIONS) && !ERROR (FvGetNextFile (FvHeader, &File))) {
+    if ((File->Type != FV_FILETYPE_FIRMWARE_VOLUME_IMAGE) || !IsFfsFileValid (FvHeader, File)) {
+      continue;
+    }
+
+    Status = FindFileSection (File, SECTION_GUID_DEFINED, &Section, &SectionSize, &HeaderSize);
+    if (ERROR (Status) || (SectionSize < HeaderSize - sizeof (COMMON_SECTION_HEADER) + sizeof (GUID_DEFINED_SECTION))) {
+      continue;
+    }
+
+    //
+    // The fields after the common header are the same for both header sizes.
+    //
+    GuidSection = (GUID_DEFINED_SECTION *)((UINT8 *)Section + HeaderSize - sizeof (COMMON_SECTION_HEADER));
+    if (!CompareGuid (&GuidSection->SectionDefinitionGuid, &gLzmaCustomDecompressGuid) ||
+        (GuidSection->DataOffset < HeaderSize) || (GuidSection->DataOffset >= SectionSize))
+    {
+      continue;
+    }
+
+    Expansion[Count].File       = File;
+    Expansion[Count].Source     = (UINT8 *)Section + GuidSection->DataOffset;
+    Expansion[Count].SourceSize = SectionSize - GuidSection->DataOffset;
+    Status                      = LzmaUefiDecompressGetInfo (
+                                    Expansion[Count].Source,
+                                    Expansion[Count].SourceSize,
+                                    &Expansion[Count].DestinationSize,
+                                    &Expansion[Count].ScratchSize
+                                    );
+    if (ERROR (Status) || (Expansion[Count].DestinationSize == 0)) {
+      continue;
+    }
+
+    Expansion[Count].Destination = AllocatePages (SIZE_TO_PAGES (Expansion[Count].DestinationSize));
+    if (Expansion[Count].Destination == NULL) {
+      break;
+    }
+
+    ScratchSize += ALIGN_VALUE (Expansion[Count].ScratchSize, SIZE_4KB);
+    Count++;
+  }
+
+  if (Count == 0) {
+    return 0;
+  }
+
+  //
+  // The decompression work buffers share one arena, freed once the
+  // sections are expanded.
+  //
+  if (ERROR (ArenaCreate (&Arena, ScratchSize))) {
+    for (Index = 0; Index < Count; Index++) {
+      FreePages (Expansion[Index].Destination, SIZE_TO_PAGES (Expansion[Index].DestinationSize));
+    }
+
+    return 0;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    Expansion[Index].Scratch = ArenaAllocate (&Arena, Expansion[Index].ScratchSize, SIZE_4KB);
+  }
+
+  HobRecordScratchUsage (ScratchSize);
+
+  MpParallelFor (Count, ExpandFvSectionProcedure, Expansion);
+  ArenaDestroy (&Arena);
+
+  ZeroMem (&FvName, sizeof (FvName));
+  if (FvHeader->ExtHeaderOffset != 0) {
+    ExtHeader = (FIRMWARE_VOLUME_EXT_HEADER *)((UINT8 *)FvHeader + FvHeader->ExtHeaderOffset);
+    CopyGuid (&FvName, &ExtHeader->FvName);
+  }
+
+  Reported = 0;
+  for (Index = 0; Index < Count; Index++) {
+    if (ERROR (Expansion[Index].Status)) {
+      FreePages (Expansion[Index].Destination, SIZE_TO_PAGES (Expansion[Index].DestinationSize));
+      continue;
+    }
+
+    Status = FindSection (
+               Expansion[Index].Destination,
+               Expansion[Index].DestinationSize,
+               SECTION_FIRMWARE_VOLUME_IMAGE,
+               &Section,
+               &SectionSize,
+               &HeaderSize
+               );
+    if (ERROR (Status)) {
+      FreePages (Expansion[Index].Destination, SIZE_TO_PAGES (Expansion[Index].DestinationSize));
+      continue;
+    }
+
+    ExpandedFv = (FIRMWARE_VOLUME_HEADER *)((UINT8 *)Section + HeaderSize);
+    if (!IsValidFirmwareVolume (ExpandedFv, SectionSize - HeaderSize)) {
+      FreePages (Expansion[Index].Destination, SIZE_TO_PAGES (Expansion[Index].DestinationSize));
+      continue;
+    }
+
+    FvAlignment = 1U << ((ExpandedFv->Attributes & FVB2_ALIGNMENT) >> 16);
+    if (FvAlignment > SIZE_4KB) {
+      FreePages (Expansion[Index].Destination, SIZE_TO_PAGES (Expansion[Index].DestinationSize));
+      continue;
+    }
+
+    CopyMem (Expansion[Index].Destination, ExpandedFv, (UINTN)ExpandedFv->FvLength);
+    ExpandedFv = (FIRMWARE_VOLUME_HEADER *)Expansion[Index].Destination;
+    if (SIZE_TO_PAGES (Expansion[Index].DestinationSize) > SIZE_TO_PAGES ((UINTN)ExpandedFv->FvLength)) {
+      //
+      // Give back the pages past the volume, they held the section headers.
+      //
+      FreePages (
+        (UINT8 *)ExpandedFv + PAGES_TO_SIZE (SIZE_TO_PAGES ((UINTN)ExpandedFv->FvLength)),
+        SIZE_TO_PAGES (Expansion[Index].DestinationSize) - SIZE_TO_PAGES ((UINTN)ExpandedFv->FvLength)
+        );
+    }
+
+    ShBuildFvHob ((UINTN)ExpandedFv, ExpandedFv->FvLength);
+    ShBuildFv2Hob ((UINTN)ExpandedFv, ExpandedFv->FvLength, &FvName, &Expansion[Index].File->Name);
+    ShBuildFv3Hob ((UINTN)ExpandedFv, ExpandedFv->FvLength, 0, TRUE, &FvName, &Expansion[Index].File->Name);
+    BuildFvFileIndexHob (ExpandedFv);
+    Reported++;
+  }
+
+  return Reported;
+}
@@ -0,0 +1,757 @@
+/** @file
+  Wake up the APs, run shim work on them and park them in a mailbox for
+  the payload.
+
+  APs pick work from a few lock-free job slots. A job is a procedure called
+  for every index in [0, Count); workers claim indices with an atomic
+  increment, so the BSP and any number of APs can share one job.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "ShimLayer.h"
+
+#ifndef SHIM_MAX_AP_COUNT
+#define SHIM_MAX_AP_COUNT         128
+#endif
+
+#define AP_STACK_SIZE             (4 * SIZE_4KB)
+#define AP_INIT_TIMEOUT_US        50000
+#define AP_SETTLE_TIME_US         1000
+#define AP_WAKEUP_BUFFER_LIMIT    0xA0000
+
+#define MSR_IA32_APIC_BASE        0x1B
+#define MSR_IA32_X2APIC_APICID    0x802
+#define MSR_IA32_X2APIC_ICR       0x830
+#define APIC_BASE_X2APIC_ENABLE   BIT10
+#define APIC_BASE_ADDRESS_MASK    0xFFFFF000
+#define XAPIC_ID_OFFSET           0x20
+#define XAPIC_ICR_LOW_OFFSET      0x300
+#define XAPIC_ICR_HIGH_OFFSET     0x310
+#define APIC_ICR_DELIVERY_STATUS  BIT12
+
+//
+// All excluding self, level assert, INIT / Start-up delivery mode.
+//
+#define APIC_ICR_INIT_ALL_EXCLUDING_SELF  0x000C4500
+#define APIC_ICR_SIPI_ALL_EXCLUDING_SELF  0x000C4600
+
+#define AP_PARK_GDT_OFFSET        0
+#define AP_PARK_COUNTER_OFFSET    56
+#define AP_PARK_LOOP_OFFSET       64
+
+#define MP_JOB_SLOT_COUNT         4
+
+typedef VOID (*AP_PARK_LOOP) (
+  IN SHIM_AP_MAILBOX  *Mailbox,
+  IN UINT32           UseMwait,
+  IN volatile UINT32  *ParkedCount
+  );
+
+//
+// 32-bit flat code at 0x08 and data at 0x10, matching ApStartup.iii.
+//
+STATIC CONST UINT64  mApGdtEntries[] = {
+  0x0000000000000000ULL,
+  0x00CF9A000000FFFFULL,
+  0x00CF92000000FFFFULL,
+};
+
+STATIC UINT32                 mPmTimerPort;
+STATIC UINTN                  mApicBase;
+STATIC BOOLEAN                mX2ApicEnabled;
+STATIC UINT32                 mUseMwait;
+STATIC UINT32                 mMaxApCount;
+STATIC UINT8                  *mParkRegion;
+STATIC UINTN                  mParkRegionSize;
+STATIC SHIM_AP_MAILBOX        *mApMailbox;
+STATIC AP_PARK_LOOP           mApParkLoop;
+STATIC volatile UINT32        *mApParkedCount;
+STATIC volatile UINT32        mApStartedCount;
+STATIC volatile BOOLEAN       mApQuiesce;
+STATIC MP_JOB_SLOT            mJobSlot[MP_JOB_SLOT_COUNT];
+
+/**
+  Find an ACPI table with the given signature from the RSDP reported by coreboot.
+
+  @param  Signature          The table signature.
+
+  @retval NULL               The table is not found.
+  @retval Others             The pointer to the table.
+**/
+STATIC
+ACPI_DESCRIPTION_HEADER *
+FindAcpiTable (
+  IN UINT32  Signature
+  )
+{
+  UNIVERSAL_PAYLOAD_ACPI_TABLE  AcpiTable;
+  ACPI_RSDP                     *Rsdp;
+  ACPI_DESCRIPTION_HEADER       *Root;
+  ACPI_DESCRIPTION_HEADER       *Table;
+  UINTN                         EntrySize;
+  UINTN                         Count;
+  UINTN                         Index;
+  UINT8                         *Entry;
+
+  //
+  // Ask coreboot directly, the ACPI table HOB is built while the APs already run.
+  //
+  if (ERROR (ParseAcpiTableInfo (&AcpiTable))) {
+    return NULL;
+  }
+
+  Rsdp = (ACPI_RSDP *)(UINTN)AcpiTable.Rsdp;
+  if ((Rsdp == NULL) || (Rsdp->Signature != ACPI_RSDP_SIGNATURE)) {
+    return NULL;
+  }
+
+  if ((Rsdp->Revision >= 2) && (Rsdp->XsdtAddress != 0)) {
+    Root      = (ACPI_DESCRIPTION_HEADER *)(UINTN)Rsdp->XsdtAddress;
+    EntrySize = sizeof (UINT64);
+  } else {
+    Root      = (ACPI_DESCRIPTION_HEADER *)(UINTN)Rsdp->RsdtAddress;
+    EntrySize = sizeof (UINT32);
+  }
+
+  Count = (Root->Length - sizeof (ACPI_DESCRIPTION_HEADER)) / EntrySize;
+  Entry = (UINT8 *)(Root + 1);
+  for (Index = 0; Index < Count; Index++, Entry += EntrySize) {
+    if (EntrySize == sizeof (UINT64)) {
+      Table = (ACPI_DESCRIPTION_HEADER *)(UINTN)*(UINT64 *)Entry;
+    } else {
+      Table = (ACPI_DESCRIPTION_HEADER *)(UINTN)*(UINT32 *)Entry;
+    }
+
+    if ((Table != NULL) && (Table->Signature == Signature)) {
+      return Table;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Count the enabled processors listed in the MADT.
+
+  @return The number of processors including the BSP, or 0 if the MADT is not found.
+**/
+STATIC
+UINT32
+GetMadtCpuCount (
+  VOID
+  )
+{
+  ACPI_MADT_HEADER           *Madt;
+  ACPI_MADT_SUBTABLE_HEADER  *Entry;
+  UINT8                      *End;
+  UINT32                     Count;
+
+  Madt = (ACPI_MADT_HEADER *)FindAcpiTable (ACPI_MADT_SIGNATURE);
+  if (Madt == NULL) {
+    return 0;
+  }
+
+  Count = 0;
+  Entry = (ACPI_MADT_SUBTABLE_HEADER *)(Madt + 1);
+  End   = (UINT8 *)Madt + Madt->Header.Length;
+  while ((UINT8 *)Entry + sizeof (ACPI_MADT_SUBTABLE_HEADER) <= End && (Entry->Length != 0)) {
+    if (Entry->Type == ACPI_MADT_PROCESSOR_LOCAL_APIC) {
+      if ((((ACPI_MADT_LOCAL_APIC *)Entry)->Flags & ACPI_MADT_PROCESSOR_ENABLED) != 0) {
+        Count++;
+      }
+    } else if (Entry->Type == ACPI_MADT_PROCESSOR_LOCAL_X2APIC) {
+      if ((((ACPI_MADT_LOCAL_X2APIC *)Entry)->Flags & ACPI_MADT_PROCESSOR_ENABLED) != 0) {
+        Count++;
+      }
+    }
+
+    Entry = (ACPI_MADT_SUBTABLE_HEADER *)((UINT8 *)Entry + Entry->Length);
+  }
+
+  return Count;
+}
+
+/**
+  Stall for the given time, using the ACPI PM timer when the FADT reports one.
+
+  @param  MicroSeconds       The number of microseconds to wait, must be below 4 seconds.
+**/
+STATIC
+VOID
+MpMicroSecondDelay (
+  IN UINT32  MicroSeconds
+  )
+{
+  UINT32  Ticks;
+  UINT32  Start;
+
+  if (mPmTimerPort == 0) {
+    //
+    // Each legacy I/O cycle takes about one microsecond.
+    //
+    while (MicroSeconds-- != 0) {
+      IoRead8 (0x80);
+    }
+
+    return;
+  }
+
+  //
+  // 3.579545 ticks per microsecond, only the low 24 bits of the timer are
+  // guaranteed to count.
+  //
+  Ticks = MicroSeconds * 3 + (MicroSeconds * 579) / 1000;
+  Start = IoRead32 (mPmTimerPort);
+  while (((IoRead32 (mPmTimerPort) - Start) & 0xFFFFFF) < Ticks) {
+    CpuPause ();
+  }
+}
+
+/**
+  Get the local APIC ID of the executing processor.
+
+  @return The APIC ID.
+**/
+STATIC
+UINT32
+GetApicId (
+  VOID
+  )
+{
+  if (mX2ApicEnabled) {
+    return (UINT32)AsmReadMsr64 (MSR_IA32_X2APIC_APICID);
+  }
+
+  return (*(volatile UINT32 *)(mApicBase + XAPIC_ID_OFFSET)) >> 24;
+}
+
+/**
+  Send an IPI to all processors excluding self.
+
+  @param  IcrLow             The low 32 bits of the interrupt command register.
+**/
+STATIC
+VOID
+SendIpiAllExcludingSelf (
+  IN UINT32  IcrLow
+  )
+{
+  if (mX2ApicEnabled) {
+    AsmWriteMsr64 (MSR_IA32_X2APIC_ICR, IcrLow);
+    return;
+  }
+
+  *(volatile UINT32 *)(mApicBase + XAPIC_ICR_HIGH_OFFSET) = 0;
+  *(volatile UINT32 *)(mApicBase + XAPIC_ICR_LOW_OFFSET)  = IcrLow;
+  while ((*(volatile UINT32 *)(mApicBase + XAPIC_ICR_LOW_OFFSET) & APIC_ICR_DELIVERY_STATUS) != 0) {
+    CpuPause ();
+  }
+}
+
+/**
+   Callback function to find the highest RAM page below 640KB for the AP wake-up buffer.
+
+   @param MemoryMapEntry         Memory map entry info got from bootloader.
+   @param Params                 A pointer to the UINTN wake-up buffer address.
+
+  @retval SUCCESS            Always.
+**/
+STATIC
+RETURN_STATUS
+FindWakeupBufferCallback (
+  IN MEMORY_MAP_ENTRY  *MemoryMapEntry,
+  IN VOID              *Params
+  )
+{
+  UINT64  Base;
+  UINT64  End;
+  UINTN   *WakeupBuffer;
+
+  WakeupBuffer = (UINTN *)Params;
+  if ((MemoryMapEntry->Type != E820_RAM) || (MemoryMapEntry->Base >= AP_WAKEUP_BUFFER_LIMIT)) {
+    return SUCCESS;
+  }
+
+  End  = MIN (MemoryMapEntry->Base + MemoryMapEntry->Size, AP_WAKEUP_BUFFER_LIMIT) & ~((UINT64)PAGE_MASK);
+  Base = ALIGN_VALUE (MemoryMapEntry->Base, (UINT64)SIZE_4KB);
+  //
+  // Keep page 0 alone, it holds the real mode IVT.
+  //
+  if ((End >= Base + SIZE_4KB) && (End - SIZE_4KB != 0) && (End - SIZE_4KB > *WakeupBuffer)) {
+    *WakeupBuffer = (UINTN)(End - SIZE_4KB);
+  }
+
+  return SUCCESS;
+}
+
+/**
+  Run the pending work of a job slot on the executing processor.
+
+  @param  Slot               The job slot to serve.
+**/
+STATIC
+VOID
+RunJobSlot (
+  IN MP_JOB_SLOT  *Slot
+  )
+{
+  SHIM_MP_JOB  *Job;
+  UINT32       Index;
+
+  if (Slot->Job == NULL) {
+    return;
+  }
+
+  //
+  // Active keeps the job alive until the poster retires the slot.
+  //
+  InterlockedIncrement (&Slot->Active);
+  Job = Slot->Job;
+  if ((Job != NULL) && (Job->NextIndex < Job->Count)) {
+    while ((Index = InterlockedIncrement (&Job->NextIndex) - 1) < Job->Count) {
+      Job->Procedure (Job->Context, Index);
+      InterlockedIncrement (&Job->DoneCount);
+    }
+  }
+
+  InterlockedDecrement (&Slot->Active);
+}
+
+/**
+  C entry of the APs, called from the trampoline on the AP's own stack.
+
+  The AP serves the job slots until MpQuiesceAps() asks it to leave the shim,
+  it then moves to the park loop in reserved memory.
+
+  @param  CpuIndex           The zero-based index the AP claimed in the trampoline.
+**/
+STATIC
+VOID
+ApEntry (
+  IN UINT32  CpuIndex
+  )
+{
+  SHIM_AP_MAILBOX  *Mailbox;
+  UINTN            Index;
+
+  Mailbox          = &mApMailbox[CpuIndex];
+  Mailbox->ApicId  = GetApicId ();
+  Mailbox->Command = SHIM_AP_MAILBOX_COMMAND_NOOP;
+  InterlockedIncrement (&mApStartedCount);
+
+  while (!mApQuiesce) {
+    for (Index = 0; Index < MP_JOB_SLOT_COUNT; Index++) {
+      RunJobSlot (&mJobSlot[Index]);
+    }
+
+    CpuPause ();
+  }
+
+  mApParkLoop (Mailbox, mUseMwait, mApParkedCount);
+}
+
+/**
+  Post a job to a free job slot so the APs start working on it.
+
+  @param  Job                The job to post.
+
+  @retval The slot the job is posted to, or NULL if all slots are busy.
+**/
+STATIC
+MP_JOB_SLOT *
+PostJob (
+  IN SHIM_MP_JOB  *Job
+  )
+{
+  UINTN  Index;
+
+  Job->NextIndex = 0;
+  Job->DoneCount = 0;
+  Job->Slot      = NULL;
+  for (Index = 0; Index < MP_JOB_SLOT_COUNT; Index++) {
+    if (InterlockedCompareExchangePointer ((VOID *volatile *)&mJobSlot[Index].Job, NULL, Job) == NULL) {
+      Job->Slot = &mJobSlot[Index];
+      break;
+    }
+  }
+
+  return Job->Slot;
+}
+
+/**
+  Run the work items of a job started by MpStartJob() that no AP claimed yet
+  on the BSP. Unlike MpWaitJob() it does not wait for the items the APs run.
+
+  @param  Job                The job to help.
+**/
+VOID
+MpRunUnclaimedWork (
+  IN SHIM_MP_JOB  *Job
+  )
+{
+  UINT32  Index;
+
+  while ((Index = InterlockedIncrement (&Job->NextIndex) - 1) < Job->Count) {
+    Job->Procedure (Job->Context, Index);
+    InterlockedIncrement (&Job->DoneCount);
+  }
+}
+
+/**
+  Take part in a job on the BSP, wait for it to complete and free its slot.
+
+  @param  Job                The job to complete.
+**/
+STATIC
+VOID
+CompleteJob (
+  IN SHIM_MP_JOB  *Job
+  )
+{
+  MP_JOB_SLOT  *Slot;
+
+  MpRunUnclaimedWork (Job);
+
+  while (Job->DoneCount < Job->Count) {
+    CpuPause ();
+  }
+
+  Slot = Job->Slot;
+  if (Slot != NULL) {
+    //
+    // No AP may still hold the job once the slot is released.
+    //
+    Slot->Job = NULL;
+    MemoryFence ();
+    while (Slot->Active != 0) {
+      CpuPause ();
+    }
+
+    Job->Slot = NULL;
+  }
+}
+
+/**
+  Call Procedure once for every index in [0, Count), spread over the BSP and
+  all APs. Returns when every call has completed.
+
+  Without APs, or when every job slot is busy, the BSP runs all of them.
+
+  @param  Count              The number of work items.
+  @param  Procedure          The function called for each work item.
+  @param  Context            The context passed to Procedure.
+**/
+VOID
+MpParallelFor (
+  IN UINT32             Count,
+  IN SHIM_MP_PROCEDURE  Procedure,
+  IN VOID               *Context
+  )
+{
+  SHIM_MP_JOB  Job;
+
+  Job.Procedure = Procedure;
+  Job.Context   = Context;
+  Job.Count     = Count;
+  if ((Count > 1) && (mApStartedCount != 0) && !mApQuiesce) {
+    PostJob (&Job);
+  } else {
+    Job.NextIndex = 0;
+    Job.DoneCount = 0;
+    Job.Slot      = NULL;
+  }
+
+  CompleteJob (&Job);
+}
+
+/**
+  Start a job in the background on the APs. The caller owns Job and must keep
+  it alive until MpWaitJob() returns.
+
+  @param  Job                The job, Procedure, Context and Count must be set.
+**/
+VOID
+MpStartJob (
+  IN SHIM_MP_JOB  *Job
+  )
+{
+  if ((mApStartedCount != 0) && !mApQuiesce) {
+    PostJob (Job);
+  } else {
+    Job->NextIndex = 0;
+    Job->DoneCount = 0;
+    Job->Slot      = NULL;
+  }
+}
+
+/**
+  Wait for a job started by MpStartJob(). The BSP runs any work item no AP
+  picked up yet, so this also completes the job when there is no AP.
+
+  @param  Job                The job to wait for.
+**/
+VOID
+MpWaitJob (
+  IN SHIM_MP_JOB  *Job
+  )
+{
+  CompleteJob (Job);
+}
+
+/**
+  Wake up all APs and put them to work on the shim job slots.
+
+  @retval SUCCESS      The APs are running, or there is no AP.
+  @retval NOT_FOUND    No memory below 1MB for the wake-up buffer.
+  @retval ABORTED      Failed to allocate memory for the APs.
+  @retval UNSUPPORTED  The x86-64 build starts no AP.
+**/
+RETURN_STATUS
+MpInitialize (
+  VOID
+  )
+{
+  UINTN                 WakeupBuffer;
+  UINT8                 *Backup;
+  UINTN                 TrampolineSize;
+  UINTN                 ParkLoopSize;
+  UINTN                 MailboxOffset;
+  UINTN                 RegionPages;
+  UINT8                 *ApStacks;
+  UINT32                CpuCount;
+  UINT32                ClaimedCount;
+  UINT32                Elapsed;
+  UINT32                Settled;
+  UINT32                RegEcx;
+  UINT64                ApicBaseMsr;
+  AP_TRAMPOLINE_DATA    *TrampolineData;
+  ACPI_FADT_HEADER      *Fadt;
+
+#if defined (MDE_CPU_X64)
+  //
+  // ApStartup.iii only brings the APs to 32-bit protected mode, the x86-64
+  // build runs every job on the BSP.
+  //
+  return UNSUPPORTED;
+#endif
+
+  //
+  // Size everything from the MADT, fall back to a fixed upper bound.
+  //
+  CpuCount = GetMadtCpuCount ();
+  if (CpuCount == 1) {
+    return SUCCESS;
+  }
+
+  mMaxApCount = (CpuCount == 0) ? SHIM_MAX_AP_COUNT : MIN (CpuCount - 1, SHIM_MAX_AP_COUNT);
+
+  WakeupBuffer = 0;
+  ParseMemoryInfo (FindWakeupBufferCallback, &WakeupBuffer);
+  if (WakeupBuffer == 0) {
+    return NOT_FOUND;
+  }
+
+  Fadt = (ACPI_FADT_HEADER *)FindAcpiTable (ACPI_FADT_SIGNATURE);
+  if ((Fadt != NULL) && (Fadt->Header.Length >= sizeof (ACPI_FADT_HEADER))) {
+    mPmTimerPort = Fadt->PmTmrBlk;
+  }
+
+  ApicBaseMsr    = AsmReadMsr64 (MSR_IA32_APIC_BASE);
+  mApicBase      = (UINTN)ApicBaseMsr & APIC_BASE_ADDRESS_MASK;
+  mX2ApicEnabled = (BOOLEAN)((ApicBaseMsr & APIC_BASE_X2APIC_ENABLE) != 0);
+
+  AsmCpuid (1, NULL, NULL, &RegEcx, NULL);
+  mUseMwait = ((RegEcx & BIT3) != 0) ? 1 : 0;
+
+  //
+  // Reserved region: GDT, parked counter, park loop and then one mailbox per AP.
+  //
+  TrampolineSize = (UINTN)ApTrampolineEnd - (UINTN)ApTrampolineStart;
+  ParkLoopSize   = (UINTN)ApParkLoopEnd - (UINTN)ApParkLoopStart;
+  MailboxOffset  = ALIGN_VALUE (AP_PARK_LOOP_OFFSET + ParkLoopSize, sizeof (SHIM_AP_MAILBOX));
+  RegionPages    = SIZE_TO_PAGES (MailboxOffset + mMaxApCount * sizeof (SHIM_AP_MAILBOX));
+  mParkRegion    = AllocateReservedPages (RegionPages);
+  ApStacks       = AllocatePages (SIZE_TO_PAGES (mMaxApCount * AP_STACK_SIZE));
+  Backup         = AllocatePages (1);
+  if ((mParkRegion == NULL) || (ApStacks == NULL) || (Backup == NULL)) {
+    return ABORTED;
+  }
+
+  mParkRegionSize = PAGES_TO_SIZE (RegionPages);
+  ZeroMem (mParkRegion, mParkRegionSize);
+  CopyMem (mParkRegion + AP_PARK_GDT_OFFSET, mApGdtEntries, sizeof (mApGdtEntries));
+  CopyMem (mParkRegion + AP_PARK_LOOP_OFFSET, ApParkLoopStart, ParkLoopSize);
+  mApParkLoop     = (AP_PARK_LOOP)(UINTN)(mParkRegion + AP_PARK_LOOP_OFFSET);
+  mApParkedCount  = (volatile UINT32 *)(mParkRegion + AP_PARK_COUNTER_OFFSET);
+  mApMailbox      = (SHIM_AP_MAILBOX *)(mParkRegion + MailboxOffset);
+  mApStartedCount = 0;
+  mApQuiesce      = FALSE;
+
+  //
+  // The wake-up buffer is in use by nobody we know of, but keep whatever
+  // coreboot left there.
+  //
+  CopyMem (Backup, (VOID *)WakeupBuffer, SIZE_4KB);
+  CopyMem ((VOID *)WakeupBuffer, ApTrampolineStart, TrampolineSize);
+
+  TrampolineData                        = (AP_TRAMPOLINE_DATA *)(WakeupBuffer + AP_TRAMPOLINE_DATA_OFFSET);
+  TrampolineData->GdtLimit              = sizeof (mApGdtEntries) - 1;
+  TrampolineData->GdtBase               = (UINT32)(UINTN)(mParkRegion + AP_PARK_GDT_OFFSET);
+  TrampolineData->ProtectedModeEntry    = (UINT32)(WakeupBuffer + ((UINTN)ApProtectedModeEntry - (UINTN)ApTrampolineStart));
+  TrampolineData->StackBase             = (UINT32)(UINTN)ApStacks;
+  TrampolineData->StackSize             = AP_STACK_SIZE;
+  TrampolineData->MaxCpuCount           = mMaxApCount;
+  TrampolineData->CEntry                = (UINT32)(UINTN)ApEntry;
+  TrampolineData->NextCpuIndex          = 0;
+  TrampolineData->HaltLoop              = (UINT32)(UINTN)(mParkRegion + AP_PARK_LOOP_OFFSET + ((UINTN)ApHaltLoop - (UINTN)ApParkLoopStart));
+
+  //
+  // INIT-SIPI-SIPI broadcast.
+  //
+  SendIpiAllExcludingSelf (APIC_ICR_INIT_ALL_EXCLUDING_SELF);
+  MpMicroSecondDelay (10000);
+  SendIpiAllExcludingSelf (APIC_ICR_SIPI_ALL_EXCLUDING_SELF | (UINT32)(WakeupBuffer >> 12));
+  MpMicroSecondDelay (200);
+  SendIpiAllExcludingSelf (APIC_ICR_SIPI_ALL_EXCLUDING_SELF | (UINT32)(WakeupBuffer >> 12));
+
+  //
+  // Stop as soon as every AP from the MADT checked in.
+  //
+  for (Elapsed = 0; Elapsed < AP_INIT_TIMEOUT_US; Elapsed += 100) {
+    if ((CpuCount != 0) && (mApStartedCount >= mMaxApCount)) {
+      break;
+    }
+
+    MpMicroSecondDelay (100);
+  }
+
+  //
+  // An AP runs trampoline code until it reaches ApEntry() or the halt loop,
+  // and late APs may still be on their way in. Only restore the buffer once
+  // no AP claimed an index for a while and all those with one checked in,
+  // otherwise keep the page away from the payload.
+  //
+  ClaimedCount = TrampolineData->NextCpuIndex;
+  Settled      = 0;
+  for (Elapsed = 0; (Settled < AP_SETTLE_TIME_US) && (Elapsed < AP_INIT_TIMEOUT_US); Elapsed += 100) {
+    MpMicroSecondDelay (100);
+    if ((TrampolineData->NextCpuIndex == ClaimedCount) && (mApStartedCount >= MIN (ClaimedCount, mMaxApCount))) {
+      Settled += 100;
+    } else {
+      ClaimedCount = TrampolineData->NextCpuIndex;
+      Settled      = 0;
+    }
+  }
+
+  if (Settled < AP_SETTLE_TIME_US) {
+    DEBUG ((DEBUG_WARN, "APs are still starting, keep the wake-up buffer at 0x%x reserved\n", WakeupBuffer));
+    BuildMemoryAllocationHob (WakeupBuffer, SIZE_4KB, ReservedMemoryType);
+  } else {
+    CopyMem ((VOID *)WakeupBuffer, Backup, SIZE_4KB);
+  }
+
+  FreePages (Backup, 1);
+  return SUCCESS;
+}
+
+/**
+  Get the number of APs serving the shim job slots.
+
+  @return The number of started APs.
+**/
+UINT32
+MpGetApCount (
+  VOID
+  )
+{
+  return mApStartedCount;
+}
+
+/**
+  Get the local APIC ID of the executing processor, only valid once
+  MpInitialize() started APs.
+
+  @return The APIC ID.
+**/
+UINT32
+MpGetApicId (
+  VOID
+  )
+{
+  return GetApicId ();
+}
+
+/**
+  Get the number of APs running a job that is still in a job slot.
+
+  @return The number of busy APs.
+**/
+STATIC
+UINT32
+GetBusyApCount (
+  VOID
+  )
+{
+  UINT32  Count;
+  UINTN   Index;
+
+  Count = 0;
+  for (Index = 0; Index < MP_JOB_SLOT_COUNT; Index++) {
+    Count += mJobSlot[Index].Active;
+  }
+
+  return Count;
+}
+
+/**
+  Move every AP out of the shim into the park loop in reserved memory. Must be
+  called before handing off to the payload, no MP service works afterwards.
+
+  An AP still running a background job is not waited for, it parks once the
+  job completes. Such a job must only use memory that survives the handoff.
+
+  @param  PublishMailbox     Report the AP mailboxes through gShimApMailboxInfoGuid HOB.
+**/
+VOID
+MpQuiesceAps (
+  IN BOOLEAN  PublishMailbox
+  )
+{
+  UINT32                Elapsed;
+  UINT32                BusyCount;
+  SHIM_AP_MAILBOX_INFO  *MailboxInfo;
+
+  if (mApStartedCount == 0) {
+    return;
+  }
+
+  mApQuiesce = TRUE;
+  BusyCount  = GetBusyApCount ();
+  for (Elapsed = 0; (*mApParkedCount + BusyCount < mApStartedCount) && (Elapsed < AP_INIT_TIMEOUT_US); Elapsed += 10) {
+    MpMicroSecondDelay (10);
+    BusyCount = GetBusyApCount ();
+  }
+
+  if (!PublishMailbox) {
+    return;
+  }
+
+  MailboxInfo = BuildGuidHob (&gShimApMailboxInfoGuid, sizeof (SHIM_AP_MAILBOX_INFO));
+  if (MailboxInfo == NULL) {
+    return;
+  }
+
+  MailboxInfo->Header.Revision = SHIM_AP_MAILBOX_INFO_REVISION;
+  MailboxInfo->Header.Length   = sizeof (SHIM_AP_MAILBOX_INFO);
+  MailboxInfo->MailboxSize     = sizeof (SHIM_AP_MAILBOX);
+  MailboxInfo->Flags           = (mUseMwait ? SHIM_AP_MAILBOX_FLAG_MWAIT : 0) |
+                                 (mX2ApicEnabled ? SHIM_AP_MAILBOX_FLAG_X2APIC : 0);
+  MailboxInfo->ApCount         = MIN (*mApParkedCount + BusyCount, mApStartedCount);
+  MailboxInfo->BspApicId       = GetApicId ();
+  MailboxInfo->MailboxBase     = (UINTN)mApMailbox;
+  MailboxInfo->RegionBase      = (UINTN)mParkRegion;
+  MailboxInfo->RegionSize      = mParkRegionSize;
+}
@@ -0,0 +1,189 @@
+/** @file
+  Function profiler of the PROFILE=1 build.
+
+  The shim sources are then compiled with -finstrument-functions, the
+  compiler calls __cyg_profile_func_enter() and __cyg_profile_func_exit()
+  around the body of every shim function. The hooks time each call with the
+  TSC on a shadow stack and append it to the ring of a SHIM_PROFILE_BUFFER
+  on return, Tools/Profile.py symbolizes the ring against ShimLayer.elf.
+
+  The hooks run before the image is relocated and before the ring exists,
+  they only read data the compiler reaches relative to the code then. APs
+  run shim functions too, they are told apart by their stack and skipped.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "ShimLayer.h"
+
+#define NO_INSTRUMENT  __attribute__ ((no_instrument_function))
+
+//
+// Calls nested deeper than this are counted as dropped.
+//
+#define PROFILE_MAX_DEPTH  64
+
+//
+// The part of the coreboot stack below the frame of ProfileInitialize() the
+// BSP may use, APs run on stacks of their own.
+//
+#define PROFILE_BSP_STACK_SIZE  SIZE_64KB
+
+//
+// Set by ClangBase.lds.
+//
+extern UINT8  _ShimImageStart[];
+
+STATIC SHIM_PROFILE_BUFFER  *mProfile;
+STATIC UINT64               mProfileStart[PROFILE_MAX_DEPTH];
+STATIC UINTN                mProfileDepth;
+STATIC UINTN                mProfileStackLow;
+STATIC UINTN                mProfileStackHigh;
+
+VOID
+__cyg_profile_func_enter (
+  IN VOID  *Function,
+  IN VOID  *CallSite
+  ) NO_INSTRUMENT;
+
+VOID
+__cyg_profile_func_exit (
+  IN VOID  *Function,
+  IN VOID  *CallSite
+  ) NO_INSTRUMENT;
+
+/**
+  Tell whether the hook runs on the BSP.
+
+  Before ProfileInitialize() the APs are not started, the BSP is alone.
+
+  @retval TRUE               The caller is the BSP.
+  @retval FALSE              The caller is an AP.
+**/
+STATIC
+BOOLEAN
+NO_INSTRUMENT
+ProfileIsBsp (
+  VOID
+  )
+{
+  UINTN  Frame;
+
+  if (mProfileStackHigh == 0) {
+    return TRUE;
+  }
+
+  Frame = (UINTN)__builtin_frame_address (0);
+  return (BOOLEAN)((Frame >= mProfileStackLow) && (Frame < mProfileStackHigh));
+}
+
+/**
+  Called on the entry of every instrumented function.
+
+  @param  Function           The address of the function.
+  @param  CallSite           The return address of the function.
+**/
+VOID
+__cyg_profile_func_enter (
+  IN VOID  *Function,
+  IN VOID  *CallSite
+  )
+{
+  if (!ProfileIsBsp ()) {
+    return;
+  }
+
+  if (mProfileDepth < PROFILE_MAX_DEPTH) {
+    mProfileStart[mProfileDepth] = AsmReadTsc ();
+  }
+
+  mProfileDepth++;
+}
+
+/**
+  Called on the return of every instrumented function.
+
+  @param  Function           The address of the function.
+  @param  CallSite           The return address of the function.
+**/
+VOID
+__cyg_profile_func_exit (
+  IN VOID  *Function,
+  IN VOID  *CallSite
+  )
+{
+  UINT64              End;
+  SHIM_PROFILE_ENTRY  *Entry;
+
+  End = AsmReadTsc ();
+  if (!ProfileIsBsp () || (mProfileDepth == 0)) {
+    return;
+  }
+
+  mProfileDepth--;
+  if (mProfile == NULL) {
+    return;
+  }
+
+  if (mProfileDepth >= PROFILE_MAX_DEPTH) {
+    mProfile->Dropped++;
+    return;
+  }
+
+  Entry           = &mProfile->Entry[(UINTN)mProfile->Recorded % PROFILE_ENTRY_COUNT];
+  Entry->Function = (UINT32)((UINTN)Function - (UINTN)_ShimImageStart);
+  Entry->Depth    = (UINT16)mProfileDepth;
+  Entry->Reserved = 0;
+  Entry->Cycles   = End - mProfileStart[mProfileDepth];
+  mProfile->Recorded++;
+}
+
+/**
+  Allocate the profile buffer of a PROFILE=1 build and report it in a HOB.
+
+  The HOB region must have been set up by InitializeHobRegion(). Only the
+  functions returning after this call are recorded, and only on the BSP.
+
+  @retval SUCCESS            The shim functions are profiled.
+  @retval ABORTED            No memory for the profile buffer.
+**/
+RETURN_STATUS
+ProfileInitialize (
+  VOID
+  )
+{
+  SHIM_PROFILE_BUFFER  *Profile;
+  SHIM_PROFILE_DATA    *ProfileData;
+  UINTN                Frame;
+
+  Profile     = AllocateReservedPages (SIZE_TO_PAGES (PROFILE_BUFFER_SIZE));
+  ProfileData = BuildGuidHob (&gShimProfileDataGuid, sizeof (SHIM_PROFILE_DATA));
+  if ((Profile == NULL) || (ProfileData == NULL)) {
+    return ABORTED;
+  }
+
+  ZeroMem (Profile, sizeof (SHIM_PROFILE_BUFFER));
+  Profile->Signature  = SHIM_PROFILE_SIGNATURE;
+  Profile->EntryCount = PROFILE_ENTRY_COUNT;
+  Profile->ImageBase  = (UINTN)_ShimImageStart;
+  Profile->LinkBase   = IMAGE_BASE;
+
+  ProfileData->Header.Revision = SHIM_PROFILE_DATA_REVISION;
+  ProfileData->Header.Length   = sizeof (SHIM_PROFILE_DATA);
+  ProfileData->Reserved        = 0;
+  ProfileData->Base            = (UINTN)Profile;
+  ProfileData->Size            = PROFILE_BUFFER_SIZE;
+
+  //
+  // The calls the BSP makes from here on run below this frame, the frame of
+  // the entry point sits right above it.
+  //
+  Frame             = (UINTN)__builtin_frame_address (0);
+  mProfileStackLow  = Frame - PROFILE_BSP_STACK_SIZE;
+  mProfileStackHigh = Frame + SIZE_4KB;
+  mProfile          = Profile;
+
+  return SUCCESS;
+}
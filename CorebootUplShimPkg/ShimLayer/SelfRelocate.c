@@ -0,0 +1,92 @@
+/** @file
+  Relocate the shim image to wherever it was loaded.
+
+  The shim is linked as a position independent executable at IMAGE_BASE.
+  coreboot loads it there from the ELF program headers, a flat copy of the
+  image may run anywhere else. Only relative relocations are left in the
+  image, they are applied here before any code reads a pointer from the
+  image data.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "ShimLayer.h"
+
+#if defined (MDE_CPU_X64)
+typedef Elf64_Rela  SHIM_RELOCATION;
+#define SHIM_RELOCATION_TYPE(Info)  ELF64_R_TYPE (Info)
+#define SHIM_RELOCATION_RELATIVE    R_X86_64_RELATIVE
+#else
+typedef Elf32_Rel   SHIM_RELOCATION;
+#define SHIM_RELOCATION_TYPE(Info)  ELF32_R_TYPE (Info)
+#define SHIM_RELOCATION_RELATIVE    R_386_RELATIVE
+#endif
+
+//
+// Set by ClangBase.lds. The compiler reaches them relative to the code, so
+// they give the addresses the image runs at.
+//
+extern UINT8  _ShimImageStart[];
+extern UINT8  _ShimImageEnd[];
+extern UINT8  _ShimRelocationStart[];
+extern UINT8  _ShimRelocationEnd[];
+
+/**
+  Apply the relative relocations of the shim image for the address it runs at.
+
+  Nothing may read a pointer from the image data before this returns, it is
+  the first call of the entry point.
+
+  @retval SUCCESS            The image can run where it is.
+  @retval UNSUPPORTED        The image has a relocation that is not relative.
+**/
+RETURN_STATUS
+RelocateShimImage (
+  VOID
+  )
+{
+  UINTN            Delta;
+  SHIM_RELOCATION  *Relocation;
+  UINTN            *Target;
+
+  Delta = (UINTN)_ShimImageStart - IMAGE_BASE;
+  if (Delta == 0) {
+    return SUCCESS;
+  }
+
+  for (Relocation = (SHIM_RELOCATION *)_ShimRelocationStart;
+       (UINT8 *)(Relocation + 1) <= _ShimRelocationEnd;
+       Relocation++)
+  {
+    if (SHIM_RELOCATION_TYPE (Relocation->r_info) != SHIM_RELOCATION_RELATIVE) {
+      return UNSUPPORTED;
+    }
+
+    Target = (UINTN *)(UINTN)(Relocation->r_offset + Delta);
+#if defined (MDE_CPU_X64)
+    *Target = (UINTN)Relocation->r_addend + Delta;
+#else
+    *Target += Delta;
+#endif
+  }
+
+  return SUCCESS;
+}
+
+/**
+  Get the memory the shim image occupies where it runs, its BSS included.
+
+  @param  Base               Return the base of the image.
+  @param  Size               Return the page aligned size of the image.
+**/
+VOID
+GetShimImageRange (
+  OUT UINTN  *Base,
+  OUT UINTN  *Size
+  )
+{
+  *Base = (UINTN)_ShimImageStart & ~(UINTN)PAGE_MASK;
+  *Size = ALIGN_VALUE ((UINTN)_ShimImageEnd - *Base, SIZE_4KB);
+}
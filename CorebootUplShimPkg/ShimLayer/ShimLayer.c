@@ -9,12 +9,89 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 STATIC UINT32  mTopOfLowerUsableDram = 0;
 
+#define PAYLOAD_DECOMPRESS_CHUNK_SIZE  SIZE_64KB
+
+//
+// Room after the decompressed payload ELF file for its BSS and the sections
+// moved out of its way when the image is loaded in place.
+//
+#define PAYLOAD_IN_PLACE_TAIL_SIZE  SIZE_512KB
+
+//
+// The payload image, and the HOB region it is allocated from, are placed
+// and padded on large page boundaries when LARGE_PAGE_PLACEMENT is set, so
+// the payload can map its code and data with large pages from the start.
+//
+#if LARGE_PAGE_PLACEMENT
+#define PAYLOAD_IMAGE_ALIGNMENT  SIZE_2MB
+#else
+#define PAYLOAD_IMAGE_ALIGNMENT  SIZE_4KB
+#endif
+
+//
+// Room in the HOB region for the HOB list, and for the pages the shim
+// allocates besides the payload buffers: AP stacks, the AP park region and
+// the section tables.
+//
+#define HOB_REGION_HOB_LIST_SIZE  SIZE_1MB
+#define HOB_REGION_MISC_SIZE      SIZE_4MB
+
+//
+// Room for the page tables of a 64-bit payload, 512GB mapped with 2MB pages
+// or 256TB with 1GB pages.
+//
+#define HOB_REGION_PAGE_TABLE_SIZE  (SIZE_2MB + 2 * SIZE_4KB)
+
+//
+// The end of the memory the shim can touch: 4GB for the i686 build, the
+// 512GB coreboot identity maps before it enters the x86-64 build.
+//
+#if defined (MDE_CPU_X64)
+#define SHIM_ADDRESS_LIMIT  0x8000000000ULL
+#else
+#define SHIM_ADDRESS_LIMIT  0x100000000ULL
+#endif
+
 GUID gGraphicsInfoHobGuid                   = { 0x39f62cce, 0x6825, 0x4669, { 0xbb, 0x56, 0x54, 0x1a, 0xba, 0x75, 0x3a, 0x07 }};
 GUID gGraphicsDeviceInfoHobGuid             = { 0xe5cb2ac9, 0xd35d, 0x4430, { 0x93, 0x6e, 0x1d, 0xe3, 0x32, 0x47, 0x8d, 0xe7 }};
 GUID gUniversalPayloadSmbiosTableGuid       = { 0x590a0d26, 0x06e5, 0x4d20, { 0x8a, 0x82, 0x59, 0xea, 0x1b, 0x34, 0x98, 0x2d }};
 GUID gUniversalPayloadAcpiTableGuid         = { 0x9f9a9506, 0x5597, 0x4515, { 0xba, 0xb6, 0x8b, 0xcd, 0xe7, 0x84, 0xba, 0x87 }};
 GUID gUniversalPayloadExtraDataGuid         = { 0x15a5baf6, 0x1c91, 0x467d, { 0x9d, 0xfb, 0x31, 0x9d, 0x17, 0x8d, 0x4b, 0xb4 }};
 GUID gUniversalPayloadSerialPortInfoGuid    = { 0xaa7e190d, 0xbe21, 0x4409, { 0x8e, 0x67, 0xa2, 0xcd, 0x0f, 0x61, 0xe1, 0x70 }};
+GUID gShimApMailboxInfoGuid                 = { 0xc7e65e4a, 0xf22a, 0x44e8, { 0xb9, 0xfa, 0x8e, 0x47, 0x36, 0xd9, 0x58, 0x2f }};
+GUID gShimPayloadDecompressInfoGuid         = { 0x3f6e97a1, 0xc716, 0x4920, { 0xa8, 0x09, 0xed, 0x76, 0xe2, 0x49, 0xdd, 0x64 }};
+GUID gShimCompressedExtraDataGuid           = { 0x4c84dd5b, 0x9927, 0x4a9c, { 0xb2, 0x8b, 0x2b, 0xd3, 0x90, 0xb6, 0x8b, 0xe7 }};
+GUID gShimFvFileIndexGuid                   = { 0xeae24c30, 0xd7c5, 0x464b, { 0xad, 0xfe, 0x51, 0x07, 0xdd, 0xd8, 0x60, 0x6f }};
+GUID gLzmaCustomDecompressGuid              = { 0xee4e5898, 0x3914, 0x4259, { 0x9d, 0x6e, 0xdc, 0x7b, 0xd7, 0x94, 0x03, 0xcf }};
+GUID gShimPerfDataGuid                      = { 0x6e03be25, 0x9062, 0x4263, { 0x85, 0x87, 0x66, 0xa2, 0xa7, 0x0d, 0x5f, 0x0b }};
+GUID gShimPageTableInfoGuid                 = { 0x583ed297, 0x967a, 0x4d18, { 0x82, 0x49, 0x47, 0x3f, 0x74, 0x36, 0xe8, 0xa3 }};
+GUID gShimHobUsageGuid                      = { 0x6f421806, 0x8a2b, 0x4260, { 0x81, 0xab, 0xf7, 0x4c, 0x94, 0x55, 0x4c, 0x1e }};
+GUID gShimProfileDataGuid                   = { 0xcc9579e5, 0xd66c, 0x422b, { 0xa6, 0x24, 0x7a, 0x5d, 0xa0, 0xa7, 0x93, 0xcd }};
+
+//
+// Lives past the handoff when the decompression does.
+//
+STATIC PAYLOAD_DECOMPRESS_CONTEXT  mPayloadDecompress;
+
+//
+// Flat 32-bit code, flat data and 64-bit code, the selectors LongMode.iii
+// switches to.
+//
+STATIC CONST UINT64  mLongModeGdtEntries[] = {
+  0x0000000000000000ULL,
+  0x00CF9B000000FFFFULL,
+  0x00CF93000000FFFFULL,
+  0x00AF9B000000FFFFULL
+};
+
+#define PAGE_TABLE_PRESENT    BIT0
+#define PAGE_TABLE_READ_WRITE BIT1
+#define PAGE_TABLE_PAGE_SIZE  BIT7
+
+//
+// Copied to the gShimPerfDataGuid HOB right before the handoff.
+//
+STATIC SHIM_PERF_DATA  mPerfData;
 
 /**
   Allocates one or more pages of type BootServicesData.
@@ -33,34 +110,133 @@ AllocatePages (
   IN UINTN  Pages
   )
 {
-  HOB_POINTERS            Hob;
-  ADDRESS                 Offset;
-  HOB_HANDOFF_INFO_TABLE  *HobTable;
+  return HobAllocatePages (Pages, BootServicesData);
+}
 
-  Hob.Raw  = GetHobList ();
-  HobTable = Hob.HandoffInformationTable;
+/**
+  Allocates one or more pages of type ReservedMemoryType.
 
-  if (Pages == 0) {
-    return NULL;
-  }
+  The payload and the OS will not reuse the memory.
+
+  @param   Pages                 The number of 4 KB pages to allocate.
+  @return  A pointer to the allocated buffer or NULL if allocation fails.
+**/
+VOID *
+AllocateReservedPages (
+  IN UINTN  Pages
+  )
+{
+  return HobAllocatePages (Pages, ReservedMemoryType);
+}
+
+/**
+  Allocates one or more pages of type BootServicesData at an alignment.
+
+  @param   Pages                 The number of 4 KB pages to allocate.
+  @param   Alignment             The alignment of the buffer, a power of two.
+  @return  A pointer to the allocated buffer or NULL if allocation fails.
+**/
+VOID *
+AllocateAlignedPages (
+  IN UINTN  Pages,
+  IN UINTN  Alignment
+  )
+{
+  return HobAllocateAlignedPages (Pages, Alignment, BootServicesData);
+}
+
+/**
+  Frees pages allocated by AllocatePages() or AllocateReservedPages().
+
+  The pages may be any page aligned part of one allocation, the payload
+  sees them as free memory.
+
+  @param   Buffer                The first page to free.
+  @param   Pages                 The number of 4 KB pages to free.
+**/
+VOID
+FreePages (
+  IN VOID   *Buffer,
+  IN UINTN  Pages
+  )
+{
+  HobFreePages (Buffer, Pages);
+}
+
+/**
+  Allocates the pages backing a scratch arena.
 
-  // Make sure allocation address is page alligned.
-  Offset = HobTable->FreeMemoryTop & PAGE_MASK;
-  if (Offset != 0) {
-    HobTable->FreeMemoryTop -= Offset;
+  Buffers are then carved from the arena with ArenaAllocate() and released
+  all at once by ArenaDestroy(). The arena is not locked, only one
+  processor may allocate from it.
+
+  @param   Arena                 The arena to set up.
+  @param   Size                  The size of the arena.
+
+  @retval  SUCCESS               The arena is ready.
+  @retval  ABORTED               Not enough memory.
+**/
+RETURN_STATUS
+ArenaCreate (
+  OUT SHIM_ARENA  *Arena,
+  IN  UINTN       Size
+  )
+{
+  Arena->Used = 0;
+  Arena->Size = PAGES_TO_SIZE (SIZE_TO_PAGES (Size));
+  Arena->Base = AllocatePages (SIZE_TO_PAGES (Size));
+  if (Arena->Base == NULL) {
+    Arena->Size = 0;
+    return ABORTED;
   }
 
-  //
-  // Check available memory for the allocation
-  //
-  if (HobTable->FreeMemoryTop - ((Pages * PAGE_SIZE) + sizeof (HOB_MEMORY_ALLOCATION)) < HobTable->FreeMemoryBottom) {
+  return SUCCESS;
+}
+
+/**
+  Carves a buffer from a scratch arena.
+
+  @param   Arena                 The arena set up by ArenaCreate().
+  @param   Size                  The size of the buffer.
+  @param   Alignment             The alignment of the buffer, a power of two
+                                 up to 4 KB.
+  @return  A pointer to the buffer or NULL if the arena is full.
+**/
+VOID *
+ArenaAllocate (
+  IN OUT SHIM_ARENA  *Arena,
+  IN     UINTN       Size,
+  IN     UINTN       Alignment
+  )
+{
+  UINTN  Offset;
+
+  Offset = ALIGN_VALUE (Arena->Used, Alignment);
+  if ((Offset > Arena->Size) || (Size > Arena->Size - Offset)) {
     return NULL;
   }
 
-  HobTable->FreeMemoryTop -= Pages * PAGE_SIZE;
-  BuildMemoryAllocationHob (HobTable->FreeMemoryTop, Pages * PAGE_SIZE, BootServicesData);
+  Arena->Used = Offset + Size;
+  return Arena->Base + Offset;
+}
+
+/**
+  Frees a scratch arena and every buffer carved from it.
+
+  @param   Arena                 The arena set up by ArenaCreate().
+**/
+VOID
+ArenaDestroy (
+  IN OUT SHIM_ARENA  *Arena
+  )
+{
+  if (Arena->Size != 0) {
+    FreePages (Arena->Base, SIZE_TO_PAGES (Arena->Size));
+  }
 
-  return (VOID *)(UINTN)HobTable->FreeMemoryTop;
+  Arena->Base = NULL;
+  Arena->Size = 0;
+  Arena->Used = 0;
 }
 
 /**
@@ -339,19 +515,19 @@ BuildHobFromBl (
   )
 {
   RETURN_STATUS                       Status;
-  PEI_GRAPHICS_INFO_HOB               GfxInfo;
-  PEI_GRAPHICS_INFO_HOB               *NewGfxInfo;
-  PEI_GRAPHICS_DEVICE_INFO_HOB        GfxDeviceInfo;
-  PEI_GRAPHICS_DEVICE_INFO_HOB        *NewGfxDeviceInfo;
+  PEI_GRAPHICS_INFO_HOB               *GfxInfo;
+  PEI_GRAPHICS_DEVICE_INFO_HOB        *GfxDeviceInfo;
   UNIVERSAL_PAYLOAD_SMBIOS_TABLE      *SmBiosTableHob;
   UNIVERSAL_PAYLOAD_ACPI_TABLE        *AcpiTableHob;
 
   //
-  // First find TOLUD
+  // First find TOLUD, unless the HOB region placement did
   //
-  Status = ParseMemoryInfo (FindToludCallback, NULL);
-  if (ERROR (Status)) {
-    return Status;
+  if (mTopOfLowerUsableDram == 0) {
+    Status = ParseMemoryInfo (FindToludCallback, NULL);
+    if (ERROR (Status)) {
+      return Status;
+    }
   }
 
   //
@@ -363,24 +539,34 @@ BuildHobFromBl (
   }
 
   //
-  // Create guid hob for frame buffer information
+  // Create guid hob for frame buffer information, parsed right into the HOB
   //
-  Status = ParseGfxInfo (&GfxInfo);
-  if (!ERROR (Status)) {
-    NewGfxInfo = BuildGuidHob (&gGraphicsInfoHobGuid, sizeof (GfxInfo));
-    CopyMem (NewGfxInfo, &GfxInfo, sizeof (GfxInfo));
+  GfxInfo = HOB_RESERVE_GUID_HOB (&gGraphicsInfoHobGuid, PEI_GRAPHICS_INFO_HOB);
+  if (GfxInfo != NULL) {
+    ZeroMem (GfxInfo, sizeof (PEI_GRAPHICS_INFO_HOB));
+    Status = ParseGfxInfo (GfxInfo);
+    if (ERROR (Status)) {
+      HobReleaseGuidHob (GfxInfo);
+    }
   }
 
-  Status = ParseGfxDeviceInfo (&GfxDeviceInfo);
-  if (!ERROR (Status)) {
-    NewGfxDeviceInfo = BuildGuidHob (&gGraphicsDeviceInfoHobGuid, sizeof (GfxDeviceInfo));
-    CopyMem (NewGfxDeviceInfo, &GfxDeviceInfo, sizeof (GfxDeviceInfo));
+  GfxDeviceInfo = HOB_RESERVE_GUID_HOB (&gGraphicsDeviceInfoHobGuid, PEI_GRAPHICS_DEVICE_INFO_HOB);
+  if (GfxDeviceInfo != NULL) {
+    ZeroMem (GfxDeviceInfo, sizeof (PEI_GRAPHICS_DEVICE_INFO_HOB));
+    Status = ParseGfxDeviceInfo (GfxDeviceInfo);
+    if (ERROR (Status)) {
+      HobReleaseGuidHob (GfxDeviceInfo);
+    }
   }
 
   //
   // Creat SmBios table Hob
   //
   SmBiosTableHob = BuildGuidHob (&gUniversalPayloadSmbiosTableGuid, sizeof (UNIVERSAL_PAYLOAD_SMBIOS_TABLE));
+  if (SmBiosTableHob == NULL) {
+    return ABORTED;
+  }
+
   SmBiosTableHob->Header.Revision = UNIVERSAL_PAYLOAD_SMBIOS_TABLE_REVISION;
   SmBiosTableHob->Header.Length   = sizeof (UNIVERSAL_PAYLOAD_SMBIOS_TABLE);
   Status = ParseSmbiosTable (SmBiosTableHob);
@@ -389,6 +575,10 @@ BuildHobFromBl (
   // Creat ACPI table Hob
   //
   AcpiTableHob = BuildGuidHob (&gUniversalPayloadAcpiTableGuid, sizeof (UNIVERSAL_PAYLOAD_ACPI_TABLE));
+  if (AcpiTableHob == NULL) {
+    return ABORTED;
+  }
+
   AcpiTableHob->Header.Revision = UNIVERSAL_PAYLOAD_ACPI_TABLE_REVISION;
   AcpiTableHob->Header.Length   = sizeof (UNIVERSAL_PAYLOAD_ACPI_TABLE);
   Status = ParseAcpiTableInfo (AcpiTableHob);
@@ -416,10 +606,14 @@ BuildGenericHob (
   UINT32                   RegEax;
   UINT8                    PhysicalAddressBits;
   RESOURCE_ATTRIBUTE_TYPE  ResourceAttribute;
+  UINTN                    ShimBase;
+  UINTN                    ShimSize;
 
-  //Memory allocaion hob for the Shim Layer
-  // BuildMemoryAllocationHob (PcdGet32 (PcdPayloadFdMemBase), PcdGet32 (PcdPayloadFdMemSize), BootServicesData);
-  BuildMemoryAllocationHob (MEMBASE, MEMSIZE, BootServicesData);
+  //
+  // Memory allocation HOB for the shim image, where coreboot loaded it.
+  //
+  GetShimImageRange (&ShimBase, &ShimSize);
+  BuildMemoryAllocationHob (ShimBase, ShimSize, BootServicesData);
 
   //
   // Build CPU memory space and IO space hob
@@ -447,26 +641,164 @@ BuildGenericHob (
   BuildMemoryAllocationHob (0xFEC80000, SIZE_512KB, MemoryMappedIO);
 }
 
+/**
+   Callback function to check whether a range lies in usable DRAM.
+
+   @param MemoryMapEntry         Memory map entry info got from bootloader.
+   @param Params                 The MEMORY_RANGE_CHECK, Usable is set if the
+                                 entry covers the whole range.
+
+  @retval SUCCESS            Always.
+**/
+RETURN_STATUS
+FindUsableRangeCallback (
+  IN MEMORY_MAP_ENTRY  *MemoryMapEntry,
+  IN VOID              *Params
+  )
+{
+  MEMORY_RANGE_CHECK  *Range;
+
+  Range = (MEMORY_RANGE_CHECK *)Params;
+  if ((MemoryMapEntry->Type == E820_RAM) &&
+      (Range->Base >= MemoryMapEntry->Base) &&
+      (Range->Base + Range->Size <= MemoryMapEntry->Base + MemoryMapEntry->Size))
+  {
+    Range->Usable = TRUE;
+  }
+
+  return SUCCESS;
+}
+
+/**
+   Callback function to find where the HOB region goes.
+
+   Only usable RAM below TOLUD is considered. CBMEM is reported as
+   CB_MEM_TABLE, never as RAM, so it is never picked. The shim image splits
+   the range it lies in, its larger part is kept.
+
+   @param MemoryMapEntry         Memory map entry info got from bootloader.
+   @param Params                 The HOB_REGION_PLACEMENT, updated when the
+                                 entry is the largest range fitting Size.
+
+  @retval SUCCESS            Always.
+**/
+RETURN_STATUS
+FindHobRegionCallback (
+  IN MEMORY_MAP_ENTRY  *MemoryMapEntry,
+  IN VOID              *Params
+  )
+{
+  HOB_REGION_PLACEMENT  *Placement;
+  ADDRESS               Base;
+  ADDRESS               End;
+  UINTN                 ShimBase;
+  UINTN                 ShimSize;
+
+  Placement = (HOB_REGION_PLACEMENT *)Params;
+  if (MemoryMapEntry->Type != E820_RAM) {
+    return SUCCESS;
+  }
+
+  GetShimImageRange (&ShimBase, &ShimSize);
+  Base = ALIGN_VALUE (MAX (MemoryMapEntry->Base, SIZE_1MB), SIZE_4KB);
+  End  = MIN (MemoryMapEntry->Base + MemoryMapEntry->Size, mTopOfLowerUsableDram) & ~(ADDRESS)PAGE_MASK;
+  if ((Base < ShimBase + ShimSize) && (End > ShimBase)) {
+    if ((End > ShimBase + ShimSize) && (End - (ShimBase + ShimSize) >= ShimBase - MIN (Base, ShimBase))) {
+      Base = ShimBase + ShimSize;
+    } else {
+      End = ShimBase;
+    }
+  }
+
+  End &= ~(Placement->Alignment - 1);
+  if ((End > Base) && (End - Base >= Placement->Size) && (End - Base > Placement->Length)) {
+    Placement->Top    = End;
+    Placement->Length = End - Base;
+  }
+
+  return SUCCESS;
+}
+
+/**
+  Set up the HOB list and the memory region pages are allocated from.
+
+  The region is placed at the top of the largest usable RAM range below
+  TOLUD that fits it. Without one, it follows the shim image, at least as
+  large as the size set at build time, when that range is usable RAM.
+
+  @param  Size               The size the region needs.
+
+  @retval SUCCESS            The HOB region is set up.
+  @retval NOT_FOUND          No usable RAM range fits the region.
+**/
+RETURN_STATUS
+InitializeHobRegion (
+  IN UINTN  Size
+  )
+{
+  HOB_REGION_PLACEMENT  Placement;
+  MEMORY_RANGE_CHECK    Range;
+  UINTN                 HobMemBase;
+  UINTN                 HobMemTop;
+  UINTN                 ShimBase;
+  UINTN                 ShimSize;
+
+  ParseMemoryInfo (FindToludCallback, NULL);
+
+  Placement.Size      = ALIGN_VALUE (Size, PAYLOAD_IMAGE_ALIGNMENT);
+  Placement.Alignment = PAYLOAD_IMAGE_ALIGNMENT;
+  Placement.Top       = 0;
+  Placement.Length    = 0;
+  ParseMemoryInfo (FindHobRegionCallback, &Placement);
+  if (Placement.Length != 0) {
+    HobMemTop  = (UINTN)Placement.Top;
+    HobMemBase = HobMemTop - (UINTN)Placement.Size;
+  } else {
+    GetShimImageRange (&ShimBase, &ShimSize);
+    Range.Base   = ALIGN_VALUE (ShimBase + ShimSize, SIZE_1MB);
+    Range.Size   = ALIGN_VALUE (MAX (Size, UEFI_REGION_SIZE), SIZE_4KB);
+    Range.Usable = FALSE;
+    if (Range.Base + Range.Size <= SHIM_ADDRESS_LIMIT) {
+      ParseMemoryInfo (FindUsableRangeCallback, &Range);
+    }
+
+    if (!Range.Usable) {
+      DEBUG ((DEBUG_ERROR, "No usable memory for a 0x%lx byte HOB region\n", Range.Size));
+      return NOT_FOUND;
+    }
+
+    HobMemBase = (UINTN)Range.Base;
+    HobMemTop  = (UINTN)(Range.Base + Range.Size);
+  }
+
+  HobConstructor ((VOID *)HobMemBase, (VOID *)HobMemTop, (VOID *)HobMemBase, (VOID *)HobMemTop);
+  return SUCCESS;
+}
+
+/**
+  Build the HOBs describing the platform from the coreboot tables.
+
+  The HOB region must have been set up by InitializeHobRegion().
+
+  @retval SUCCESS        If it completed successfully.
+  @retval Others         If it failed to build required HOBs.
+**/
 RETURN_STATUS
 ConvertCbmemToHob (
   VOID
   )
 {
-  UINTN                               MemBase;
-  UINTN                               HobMemBase;
-  UINTN                               HobMemTop;
   RETURN_STATUS                       Status;
   SERIAL_PORT_INFO                    SerialPortInfo;
   UNIVERSAL_PAYLOAD_SERIAL_PORT_INFO  *UniversalSerialPort;
 
-  MemBase    = MEMBASE;
-  HobMemBase = ALIGN_VALUE (MemBase + MEMSIZE, SIZE_1MB);
-  HobMemTop  = HobMemBase + UEFI_REGION_SIZE;
-  HobConstructor ((VOID *)MemBase, (VOID *)HobMemTop, (VOID *)HobMemBase, (VOID *)HobMemTop);
-
   Status = ParseSerialInfo (&SerialPortInfo);
   if (!ERROR (Status)) {
     UniversalSerialPort = BuildGuidHob (&gUniversalPayloadSerialPortInfoGuid, sizeof (UNIVERSAL_PAYLOAD_SERIAL_PORT_INFO));
+    if (UniversalSerialPort == NULL) {
+      return ABORTED;
+    }
+
     UniversalSerialPort->Header.Revision = UNIVERSAL_PAYLOAD_SERIAL_PORT_INFO_REVISION;
     UniversalSerialPort->Header.Length   = sizeof (UNIVERSAL_PAYLOAD_SERIAL_PORT_INFO);
     UniversalSerialPort->UseMmio         = (SerialPortInfo.Type == 1) ? FALSE : TRUE;
@@ -485,9 +817,21 @@ ConvertCbmemToHob (
   return SUCCESS;
 }
 
+/**
+  Locate the compressed Universal Payload in the coreboot CBFS.
+
+  @param  Source             The address of the compressed payload.
+  @param  SourceSize         The size of the compressed payload.
+  @param  PayloadAlignment   The alignment the payload must be decompressed to.
+
+  @retval SUCCESS            The payload is found.
+  @retval NOT_FOUND          The payload is not found.
+**/
 RETURN_STATUS
-LocateAndDecompressPayload (
-  OUT VOID **Dest
+LocatePayload (
+  OUT ADDRESS  *Source,
+  OUT UINT32   *SourceSize,
+  OUT UINT32   *PayloadAlignment
   )
 {
   RETURN_STATUS               Status;
@@ -499,8 +843,6 @@ LocateAndDecompressPayload (
   struct fmap_area            *FMapArea;
   struct cbfs_payload_segment *FirstSegment;
   UINT32                      Index;
-  UINTN                       DestSize, ScratchSize;
-  VOID                        *MyDestAddress, *ScratchAddress;
   UINT32                      Alignment;
   UINTN                       CBFSEntrySize;
   union cbfs_mdata            *CBFSEntry;
@@ -550,165 +892,1174 @@ LocateAndDecompressPayload (
     return NOT_FOUND;
   }
 
-  Status = LzmaUefiDecompressGetInfo((VOID *)(UINTN)SourceAddress, ImageSize, &DestSize, &ScratchSize);
-  if (ERROR (Status)) {
-    return Status;
+  *Source           = SourceAddress;
+  *SourceSize       = (UINT32)ImageSize;
+  *PayloadAlignment = Alignment;
+  return SUCCESS;
+}
+
+/**
+  Shim job procedure decompressing the payload.
+
+  @param  Context            The PAYLOAD_DECOMPRESS_CONTEXT.
+  @param  Index              Not used, the job has a single work item.
+**/
+STATIC
+VOID
+DecompressPayloadProcedure (
+  IN VOID    *Context,
+  IN UINT32  Index
+  )
+{
+  PAYLOAD_DECOMPRESS_CONTEXT        *Decompress;
+  SHIM_PAYLOAD_DECOMPRESS_PROGRESS  *Progress;
+  RETURN_STATUS                     Status;
+  UINTN                             DecodedSize;
+
+  Decompress = (PAYLOAD_DECOMPRESS_CONTEXT *)Context;
+  Progress   = Decompress->Progress;
+  if (Progress == NULL) {
+    Decompress->Status = LzmaUefiDecompress (
+                           (VOID *)(UINTN)Decompress->Source,
+                           Decompress->SourceSize,
+                           Decompress->Dest,
+                           Decompress->Scratch
+                           );
+    return;
   }
-  DestSize += Alignment;
-  MyDestAddress  = AllocatePages(SIZE_TO_PAGES(DestSize));
-  MyDestAddress  = (VOID *) ALIGN_VALUE ((UINTN) MyDestAddress, Alignment);
-  ScratchAddress = AllocatePages(SIZE_TO_PAGES(ScratchSize));
 
-  Status = LzmaUefiDecompress ((VOID *)(UINTN)SourceAddress, ImageSize, MyDestAddress, ScratchAddress);
-  *Dest = MyDestAddress;
-  if (ERROR (Status)) {
-    return Status;
+  //
+  // Publish the decoded size chunk by chunk, the BSP and later the payload
+  // consume the front of the file while the rest is decoded. The BSP reads
+  // ApicId after the first DecodedSize update.
+  //
+  Decompress->ApicId = MpGetApicId ();
+  Status             = LzmaUefiDecompressBegin (
+             (VOID *)(UINTN)Decompress->Source,
+             Decompress->SourceSize,
+             Decompress->Dest,
+             Decompress->Scratch
+             );
+  DecodedSize = 0;
+  while (!ERROR (Status) && (DecodedSize < Decompress->DestSize)) {
+    Status = LzmaUefiDecompressContinue (Decompress->Scratch, DecodedSize + PAYLOAD_DECOMPRESS_CHUNK_SIZE, &DecodedSize);
+    MemoryFence ();
+    Progress->DecodedSize = (UINT32)DecodedSize;
   }
-  return SUCCESS;
+
+  Decompress->Status = Status;
+  MemoryFence ();
+  Progress->State = ERROR (Status) ? SHIM_PAYLOAD_DECOMPRESS_STATE_ERROR : SHIM_PAYLOAD_DECOMPRESS_STATE_DONE;
 }
 
+/**
+  Locate the payload and read the sizes of its decompression buffers.
+
+  Nothing is allocated, the HOB region is sized from the result.
+
+  @param  Decompress         The decompression context, owned by the caller.
+
+  @retval SUCCESS            The payload is found.
+  @retval Others             The payload is not found or not LZMA compressed.
+**/
 RETURN_STATUS
-LoadPayload (
-  OUT    ADDRESS        *ImageAddressArg   OPTIONAL,
-  OUT    UINT64         *ImageSizeArg,
-  OUT    ADDRESS        *UniversalPayloadEntry
+GetPayloadDecompressInfo (
+  OUT PAYLOAD_DECOMPRESS_CONTEXT  *Decompress
   )
 {
-  RETURN_STATUS                  Status;
-  UINT32                         Index;
-  UINT16                         ExtraDataIndex;
-  CHAR8                          *SectionName;
-  UINTN                          Offset;
-  UINTN                          Size;
-  UINTN                          Length;
-  UINT32                         ExtraDataCount;
-  ELF_IMAGE_CONTEXT              Context;
-  UNIVERSAL_PAYLOAD_EXTRA_DATA   *ExtraData;
-  VOID *Dest;
+  RETURN_STATUS  Status;
 
-  Status = LocateAndDecompressPayload (&Dest);
+  Status = LocatePayload (&Decompress->Source, &Decompress->SourceSize, &Decompress->Alignment);
   if (ERROR (Status)) {
     return Status;
   }
-  Status = ParseElfImage (Dest, &Context);
+
+  Status = LzmaUefiDecompressGetInfo ((VOID *)(UINTN)Decompress->Source, Decompress->SourceSize, &Decompress->DestSize, &Decompress->ScratchSize);
   if (ERROR (Status)) {
     return Status;
   }
 
-  //
-  // Get UNIVERSAL_PAYLOAD_INFO_HEADER and number of additional PLD sections.
-  //
+  Decompress->BufferSize = ALIGN_VALUE (Decompress->DestSize + PAYLOAD_IN_PLACE_TAIL_SIZE, PAYLOAD_IMAGE_ALIGNMENT);
+  return SUCCESS;
+}
 
-  ExtraDataCount = 0;
-  for (Index = 0; Index < Context.ShNum; Index++) {
-    Status = GetElfSectionName (&Context, Index, &SectionName);
-    if (ERROR (Status)) {
-      continue;
-    }
+/**
+  Compute the size of the HOB region.
 
-    if (AsciiStrnCmp (SectionName, UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX, UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX_LENGTH) == 0) {
-      Status = GetElfSectionPos (&Context, Index, &Offset, &Size);
-      if (!ERROR (Status)) {
-        ExtraDataCount++;
-      }
-    }
-  }
+  The payload buffers are known from its LZMA header. The image is only
+  known once decompressed, it gets as much room as the buffer it would be
+  loaded in place into.
 
-  //
-  // Report the additional PLD sections through HOB.
-  //
-  Length    = sizeof (UNIVERSAL_PAYLOAD_EXTRA_DATA) + ExtraDataCount * sizeof (UNIVERSAL_PAYLOAD_EXTRA_DATA_ENTRY);
-  ExtraData = BuildGuidHob (
-                &gUniversalPayloadExtraDataGuid,
-                Length
-                );
-  ExtraData->Count           = ExtraDataCount;
-  ExtraData->Header.Revision = UNIVERSAL_PAYLOAD_EXTRA_DATA_REVISION;
-  ExtraData->Header.Length   = (UINT16)Length;
-  if (ExtraDataCount != 0) {
-    for (ExtraDataIndex = 0, Index = 0; Index < Context.ShNum; Index++) {
-      Status = GetElfSectionName (&Context, Index, &SectionName);
-      if (ERROR (Status)) {
-        continue;
-      }
+  @param  Decompress         The context set up by GetPayloadDecompressInfo().
 
-      if (AsciiStrnCmp (SectionName, UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX, UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX_LENGTH) == 0) {
-        Status = GetElfSectionPos (&Context, Index, &Offset, &Size);
-        if (!ERROR (Status)) {
-          AsciiStrCpyS (
-            ExtraData->Entry[ExtraDataIndex].Identifier,
-            sizeof (ExtraData->Entry[ExtraDataIndex].Identifier),
-            SectionName + UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX_LENGTH
-            );
-          ExtraData->Entry[ExtraDataIndex].Base = (UINTN)(Context.FileBase + Offset);
-          ExtraData->Entry[ExtraDataIndex].Size = Size;
-          ExtraDataIndex++;
-        }
-      }
-    }
-  }
-  if (Context.ReloadRequired || (Context.PreferredImageAddress != Context.FileBase)) {
-    Context.ImageAddress = AllocatePages (SIZE_TO_PAGES (Context.ImageSize));
-  } else {
-    Context.ImageAddress = Context.FileBase;
-  }
+  @return The size the HOB region needs.
+**/
+UINTN
+GetHobRegionSize (
+  IN PAYLOAD_DECOMPRESS_CONTEXT  *Decompress
+  )
+{
+  UINTN  Size;
+
+  Size  = HOB_REGION_HOB_LIST_SIZE + HOB_REGION_MISC_SIZE + HOB_REGION_PAGE_TABLE_SIZE;
+  Size += Decompress->BufferSize + MAX (Decompress->Alignment, PAYLOAD_IMAGE_ALIGNMENT);
+  Size += ALIGN_VALUE (Decompress->ScratchSize, SIZE_4KB);
+  Size += Decompress->BufferSize + PAYLOAD_IMAGE_ALIGNMENT;
+#if EXPAND_FV_SECTIONS
   //
-  // Load ELF into the required base
+  // The FV sections are expanded to new pages, assume they are at most
+  // compressed four to one.
   //
-  Status = LoadElfImage (&Context);
-  if (!ERROR (Status)) {
-    *ImageAddressArg        = (UINTN)Context.ImageAddress;
-    *UniversalPayloadEntry  = Context.EntryPoint;
-    *ImageSizeArg           = Context.ImageSize;
-  }
-  return Status;
+  Size += 4 * ALIGN_VALUE (Decompress->DestSize, SIZE_4KB);
+#endif
+#if PROFILE
+  Size += PROFILE_BUFFER_SIZE;
+#endif
+
+  return Size;
 }
 
+/**
+  Allocate the payload buffers and start decompressing it as a background
+  job. MpWaitJob() on Decompress->Job joins the decompression,
+  Decompress->Status then holds its result.
+
+  @param  Decompress         The context set up by GetPayloadDecompressInfo().
+
+  @retval SUCCESS            The decompression is started.
+  @retval ABORTED            No memory for the payload.
+**/
 RETURN_STATUS
-HandOffToPayload (
-  IN  ADDRESS       UniversalPayloadEntry,
-  IN  HOB_POINTERS  Hob
+StartPayloadDecompression (
+  IN OUT PAYLOAD_DECOMPRESS_CONTEXT  *Decompress
   )
 {
-  UINTN       HobList;
+  Decompress->Dest    = AllocateAlignedPages (SIZE_TO_PAGES (Decompress->BufferSize), MAX (Decompress->Alignment, PAYLOAD_IMAGE_ALIGNMENT));
+  Decompress->Scratch = AllocatePages (SIZE_TO_PAGES (Decompress->ScratchSize));
+  if ((Decompress->Dest == NULL) || (Decompress->Scratch == NULL)) {
+    return ABORTED;
+  }
 
-  HobList = (UINTN)(VOID *)Hob.Raw;
-  typedef VOID ( *PayloadEntry) (UINTN);
-  ((PayloadEntry) (UINTN) UniversalPayloadEntry) (HobList);
+  HobRecordScratchUsage (Decompress->ScratchSize);
+  Decompress->Status   = ABORTED;
+  Decompress->Progress = NULL;
+
+#if ASYNC_DECOMPRESS
+  //
+  // Only an AP can keep decompressing after the handoff.
+  //
+  if (MpGetApCount () != 0) {
+    Decompress->Progress = AllocateReservedPages (1);
+    if (Decompress->Progress == NULL) {
+      return ABORTED;
+    }
+
+    Decompress->Progress->DecodedSize = 0;
+    Decompress->Progress->State       = SHIM_PAYLOAD_DECOMPRESS_STATE_RUNNING;
+  }
+#endif
 
+  Decompress->Job.Procedure = DecompressPayloadProcedure;
+  Decompress->Job.Context   = Decompress;
+  Decompress->Job.Count     = 1;
+  MpStartJob (&Decompress->Job);
   return SUCCESS;
 }
 
+#if ASYNC_DECOMPRESS
 /**
+  Wait until the given number of bytes of the payload ELF file are decoded.
 
-  Entry point to the C language phase of Shim Layer before UEFI payload.
-
-  @param[in]   BootloaderParameter    The starting address of bootloader parameter block.
-
-  @retval      It will not return if SUCCESS, and return error when passing bootloader parameter.
+  @param  Decompress         The decompression context.
+  @param  Size               The number of bytes needed, capped to the file size.
 
+  @retval SUCCESS            The bytes are decoded.
+  @retval Others             The decompression failed before reaching them.
 **/
+STATIC
 RETURN_STATUS
-_ModuleEntryPoint (
-  IN  UINTN  BootloaderParameter
+WaitForDecodedPayload (
+  IN PAYLOAD_DECOMPRESS_CONTEXT  *Decompress,
+  IN UINT64                      Size
   )
 {
-  RETURN_STATUS   Status;
-  HOB_POINTERS    Hob;
-  ADDRESS         ImageAddress;
-  UINT64          ImageSize;
-  ADDRESS         UniversalPayloadEntry;
+  SHIM_PAYLOAD_DECOMPRESS_PROGRESS  *Progress;
 
-  SetBootloaderParameter (BootloaderParameter);
-  Status = ConvertCbmemToHob();
-  if (ERROR (Status)) {
-    return Status;
+  Progress = Decompress->Progress;
+  Size     = MIN (Size, Decompress->DestSize);
+  while ((Progress->DecodedSize < Size) && (Progress->State == SHIM_PAYLOAD_DECOMPRESS_STATE_RUNNING)) {
+    CpuPause ();
+  }
+
+  MemoryFence ();
+  if (Progress->DecodedSize >= Size) {
+    return SUCCESS;
+  }
+
+  return ERROR (Decompress->Status) ? Decompress->Status : ABORTED;
+}
+
+/**
+  Wait until everything of the payload ELF file but the .upld.* extra
+  sections is decoded, that is all LoadPayload() needs. Of a compressed
+  extra section only the compression header is needed.
+
+  The headers are waited for first to learn where the sections are. With
+  the section table at the end of the file this waits for the whole file.
+
+  @param  Decompress         The decompression context.
+
+  @retval SUCCESS            The payload can be loaded.
+  @retval Others             The decompression failed or the file is no ELF.
+**/
+STATIC
+RETURN_STATUS
+WaitForPayloadBootData (
+  IN PAYLOAD_DECOMPRESS_CONTEXT  *Decompress
+  )
+{
+  RETURN_STATUS      Status;
+  UINT8              *File;
+  Elf32_Ehdr         *Elf32Hdr;
+  Elf64_Ehdr         *Elf64Hdr;
+  Elf32_Shdr         *Elf32Shdr;
+  Elf64_Shdr         *Elf64Shdr;
+  Elf32_Phdr         *Elf32Phdr;
+  Elf64_Phdr         *Elf64Phdr;
+  ELF_IMAGE_CONTEXT  Context;
+  CHAR8              *SectionName;
+  UINT32             Index;
+  UINT32             Type;
+  UINT64             Flags;
+  UINT64             Offset;
+  UINT64             Size;
+  UINT64             End;
+
+  File   = (UINT8 *)Decompress->Dest;
+  Status = WaitForDecodedPayload (Decompress, sizeof (Elf64_Ehdr));
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Program and section header tables, then the section name table.
+  //
+  Elf32Hdr = (Elf32_Ehdr *)File;
+  Elf64Hdr = (Elf64_Ehdr *)File;
+  if (Elf32Hdr->e_ident[EI_CLASS] == ELFCLASS32) {
+    End = MAX ((UINT64)Elf32Hdr->e_phoff + Elf32Hdr->e_phnum * Elf32Hdr->e_phentsize,
+               (UINT64)Elf32Hdr->e_shoff + Elf32Hdr->e_shnum * Elf32Hdr->e_shentsize);
+  } else if (Elf32Hdr->e_ident[EI_CLASS] == ELFCLASS64) {
+    End = MAX (Elf64Hdr->e_phoff + Elf64Hdr->e_phnum * Elf64Hdr->e_phentsize,
+               Elf64Hdr->e_shoff + Elf64Hdr->e_shnum * Elf64Hdr->e_shentsize);
+  } else {
+    return UNSUPPORTED;
+  }
+
+  Status = WaitForDecodedPayload (Decompress, End);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  if (Elf32Hdr->e_ident[EI_CLASS] == ELFCLASS32) {
+    Elf32Shdr = GetElf32SectionByIndex (File, Elf32Hdr->e_shstrndx);
+    End       = (Elf32Shdr == NULL) ? 0 : (UINT64)Elf32Shdr->sh_offset + Elf32Shdr->sh_size;
+  } else {
+    Elf64Shdr = GetElf64SectionByIndex (File, Elf64Hdr->e_shstrndx);
+    End       = (Elf64Shdr == NULL) ? 0 : Elf64Shdr->sh_offset + Elf64Shdr->sh_size;
+  }
+
+  Status = WaitForDecodedPayload (Decompress, End);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  Status = ParseElfImage (File, &Context);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Everything in the file but the extra sections.
+  //
+  End = 0;
+  for (Index = 0; Index < Context.ShNum; Index++) {
+    if (Context.EiClass == ELFCLASS32) {
+      Elf32Shdr = GetElf32SectionByIndex (File, Index);
+      Type      = Elf32Shdr->sh_type;
+      Flags     = Elf32Shdr->sh_flags;
+      Offset    = Elf32Shdr->sh_offset;
+      Size      = Elf32Shdr->sh_size;
+    } else {
+      Elf64Shdr = GetElf64SectionByIndex (File, Index);
+      Type      = Elf64Shdr->sh_type;
+      Flags     = Elf64Shdr->sh_flags;
+      Offset    = Elf64Shdr->sh_offset;
+      Size      = Elf64Shdr->sh_size;
+    }
+
+    if (Type == SHT_NOBITS) {
+      continue;
+    }
+
+    //
+    // LoadPayload() reads the compression header of compressed extra sections.
+    //
+    Status = GetElfSectionName (&Context, Index, &SectionName);
+    if (!ERROR (Status) &&
+        (AsciiStrnCmp (SectionName, UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX, UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX_LENGTH) == 0))
+    {
+      if ((Flags & SHF_COMPRESSED) == 0) {
+        continue;
+      }
+
+      Size = MIN (Size, (Context.EiClass == ELFCLASS32) ? sizeof (Elf32_Chdr) : sizeof (Elf64_Chdr));
+    }
+
+    End = MAX (End, Offset + Size);
+  }
+
+  for (Index = 0; Index < Context.PhNum; Index++) {
+    if (Context.EiClass == ELFCLASS32) {
+      Elf32Phdr = GetElf32SegmentByIndex (File, Index);
+      Offset    = Elf32Phdr->p_offset;
+      Size      = Elf32Phdr->p_filesz;
+    } else {
+      Elf64Phdr = GetElf64SegmentByIndex (File, Index);
+      Offset    = Elf64Phdr->p_offset;
+      Size      = Elf64Phdr->p_filesz;
+    }
+
+    End = MAX (End, Offset + Size);
+  }
+
+  return WaitForDecodedPayload (Decompress, End);
+}
+
+/**
+  Report the decompression still running on an AP to the payload.
+
+  @param  Decompress         The decompression context.
+**/
+STATIC
+VOID
+BuildPayloadDecompressHob (
+  IN PAYLOAD_DECOMPRESS_CONTEXT  *Decompress
+  )
+{
+  SHIM_PAYLOAD_DECOMPRESS_INFO  *DecompressInfo;
+
+  DecompressInfo = BuildGuidHob (&gShimPayloadDecompressInfoGuid, sizeof (SHIM_PAYLOAD_DECOMPRESS_INFO));
+  if (DecompressInfo == NULL) {
+    return;
+  }
+
+  DecompressInfo->Header.Revision = SHIM_PAYLOAD_DECOMPRESS_INFO_REVISION;
+  DecompressInfo->Header.Length   = sizeof (SHIM_PAYLOAD_DECOMPRESS_INFO);
+  DecompressInfo->FileBase        = (UINTN)Decompress->Dest;
+  DecompressInfo->FileSize        = Decompress->DestSize;
+  DecompressInfo->Progress        = (UINTN)Decompress->Progress;
+  DecompressInfo->ApicId          = Decompress->ApicId;
+}
+#endif
+
+/**
+  Check whether nothing lives in a range of memory, so the payload image
+  can be loaded there.
+
+  The range must be usable DRAM in the bootloader memory map, addressable
+  by the shim and above 1MB, where the AP wake-up buffer is borrowed. It
+  must neither overlap the shim memory region, which holds the shim, its
+  stack, the HOB list and every page allocated so far, nor any memory
+  allocation HOB.
+
+  @param  Base               The base of the range.
+  @param  Size               The size of the range.
+
+  @retval TRUE               The range is free.
+  @retval FALSE              The range is or may be in use.
+**/
+STATIC
+BOOLEAN
+IsFreeMemoryRange (
+  IN ADDRESS  Base,
+  IN UINT64   Size
+  )
+{
+  MEMORY_RANGE_CHECK  Range;
+  HOB_POINTERS        Hob;
+  ADDRESS             AllocationBase;
+  UINT64              AllocationLength;
+
+  if ((Size == 0) || (Base < SIZE_1MB) || (Base + Size > SHIM_ADDRESS_LIMIT)) {
+    return FALSE;
+  }
+
+  Range.Base   = Base;
+  Range.Size   = Size;
+  Range.Usable = FALSE;
+  ParseMemoryInfo (FindUsableRangeCallback, &Range);
+  if (!Range.Usable) {
+    return FALSE;
+  }
+
+  Hob.Raw = GetHobList ();
+  if ((Base < Hob.HandoffInformationTable->MemoryTop) &&
+      (Base + Size > Hob.HandoffInformationTable->MemoryBottom))
+  {
+    return FALSE;
+  }
+
+  while ((Hob.Raw = GetNextHob (HOB_TYPE_MEMORY_ALLOCATION, Hob.Raw)) != NULL) {
+    AllocationBase   = Hob.MemoryAllocation->AllocDescriptor.MemoryBaseAddress;
+    AllocationLength = Hob.MemoryAllocation->AllocDescriptor.MemoryLength;
+    if ((Base < AllocationBase + AllocationLength) && (Base + Size > AllocationBase)) {
+      return FALSE;
+    }
+
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+
+  return TRUE;
+}
+
+/**
+  Order two ELF_SECTION_ENTRY by their offset in the ELF file.
+
+  @param  Buffer1            The first entry.
+  @param  Buffer2            The second entry.
+
+  @return <0, 0 or >0 as the first section starts below, at or above the second.
+**/
+STATIC
+intn
+CompareElfSectionOffset (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  UINTN  Offset1;
+  UINTN  Offset2;
+
+  Offset1 = ((CONST ELF_SECTION_ENTRY *)Buffer1)->Offset;
+  Offset2 = ((CONST ELF_SECTION_ENTRY *)Buffer2)->Offset;
+  if (Offset1 == Offset2) {
+    return 0;
+  }
+
+  return (Offset1 < Offset2) ? -1 : 1;
+}
+
+/**
+  Move the extra sections down so they follow each other from Base.
+
+  The entries must be ordered by Base. A section keeps the alignment its
+  address had and never moves up, so the copies never overwrite a section
+  not moved yet.
+
+  @param  ExtraData          The extra sections, their Base is updated.
+  @param  Base               Where the first section may start.
+
+  @return The end of the last section.
+**/
+STATIC
+UINTN
+PackPayloadExtraData (
+  IN OUT UNIVERSAL_PAYLOAD_EXTRA_DATA  *ExtraData,
+  IN     UINTN                         Base
+  )
+{
+  UINT32  Index;
+  UINTN   Source;
+  UINTN   Target;
+  UINTN   Size;
+
+  for (Index = 0; Index < ExtraData->Count; Index++) {
+    Source = (UINTN)ExtraData->Entry[Index].Base;
+    Size   = (UINTN)ExtraData->Entry[Index].Size;
+    Target = ALIGN_VALUE (Base, Source & (0 - Source));
+    if (Target >= Source) {
+      Base = MAX (Base, Source + Size);
+      continue;
+    }
+
+    CopyMem ((VOID *)Target, (VOID *)Source, Size);
+    ExtraData->Entry[Index].Base = Target;
+    Base                         = Target + Size;
+  }
+
+  return Base;
+}
+
+/**
+  Allocate the pages the payload image is relocated to.
+
+  With LARGE_PAGE_PLACEMENT, a 1GB aligned and padded buffer is tried
+  first, then a 2MB one, before plain pages. The HOB region is only sized
+  for the 2MB placement, 1GB is tried when its free part happens to fit
+  it, so a bound to fail attempt is not counted in the HOB usage.
+
+  @param  ImageSize          The size of the image.
+  @param  ImageSpan          Return the size of the buffer, padded.
+
+  @return The buffer, or NULL if no memory.
+**/
+STATIC
+VOID *
+AllocatePayloadImage (
+  IN  UINTN  ImageSize,
+  OUT UINTN  *ImageSpan
+  )
+{
+  VOID                    *Buffer;
+
+#if LARGE_PAGE_PLACEMENT
+  HOB_HANDOFF_INFO_TABLE  *HandOffHob;
+#endif
+
+#if LARGE_PAGE_PLACEMENT
+  HandOffHob = GetHobList ();
+  if ((ImageSize <= MAX_UINT32 - SIZE_1GB) &&
+      (HandOffHob->FreeMemoryTop - HandOffHob->FreeMemoryBottom >= (ADDRESS)ALIGN_VALUE (ImageSize, SIZE_1GB) + SIZE_1GB))
+  {
+    *ImageSpan = ALIGN_VALUE (ImageSize, SIZE_1GB);
+    Buffer     = AllocateAlignedPages (SIZE_TO_PAGES (*ImageSpan), SIZE_1GB);
+    if (Buffer != NULL) {
+      return Buffer;
+    }
+  }
+
+  *ImageSpan = ALIGN_VALUE (ImageSize, SIZE_2MB);
+  Buffer     = AllocateAlignedPages (SIZE_TO_PAGES (*ImageSpan), SIZE_2MB);
+  if (Buffer != NULL) {
+    return Buffer;
+  }
+#endif
+
+  *ImageSpan = ALIGN_VALUE (ImageSize, SIZE_4KB);
+  Buffer     = AllocatePages (SIZE_TO_PAGES (ImageSize));
+  return Buffer;
+}
+
+/**
+  Load the decompressed payload ELF and report its extra sections.
+
+  @param  Dest                   The decompressed payload ELF file.
+  @param  BufferSize             The size of the buffer at Dest, the image
+                                 may be loaded in place when it fits.
+  @param  Progress               The decompression progress while the ELF
+                                 file is still being decompressed, NULL
+                                 once it is complete. The image is never
+                                 loaded in place into a file in use.
+  @param  ImageAddressArg        The address the image is loaded at.
+  @param  ImageSizeArg           The size of the loaded image, padded as
+                                 its placement was.
+  @param  UniversalPayloadEntry  The entry point of the payload.
+  @param  Is64Bit                Return whether the payload is a 64-bit image.
+
+  @retval SUCCESS            The payload is loaded.
+  @retval ABORTED            No room for the extra data HOBs.
+  @retval Others             The payload is not a valid ELF image.
+**/
+RETURN_STATUS
+LoadPayload (
+  IN     VOID           *Dest,
+  IN     UINTN          BufferSize,
+  IN     SHIM_PAYLOAD_DECOMPRESS_PROGRESS  *Progress  OPTIONAL,
+  OUT    ADDRESS        *ImageAddressArg   OPTIONAL,
+  OUT    UINT64         *ImageSizeArg,
+  OUT    ADDRESS        *UniversalPayloadEntry,
+  OUT    BOOLEAN        *Is64Bit
+  )
+{
+  RETURN_STATUS                  Status;
+  UINT32                         Index;
+  UINTN                          Base;
+  UINTN                          BufferEnd;
+  UINTN                          Size;
+  UINTN                          HeaderSize;
+  UINTN                          Length;
+  UINTN                          SectionPages;
+  UINTN                          ImageSpan;
+  UINT32                         ExtraDataCount;
+  UINT32                         CompressedCount;
+  UINT32                         CompressedIndex;
+  UINT32                         Algorithm;
+  UINT64                         DecompressedSize;
+  UINT64                         Alignment;
+  UINT64                         FvLength;
+  ELF_IMAGE_CONTEXT              Context;
+  ELF_SECTION_ENTRY              *Sections;
+  ELF_SECTION_ENTRY              Swap;
+  UNIVERSAL_PAYLOAD_EXTRA_DATA   *ExtraData;
+  SHIM_COMPRESSED_EXTRA_DATA     *CompressedData;
+
+  Status = ParseElfImage (Dest, &Context);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Run the image where it was decompressed, or load it at its preferred
+  // address when that is free, both skip the relocation. Loading it inside
+  // the decompression buffer moves its segments in place, that may move
+  // sections of the file, so the image is loaded before the extra sections
+  // are reported. Only copy it to allocated pages as the last resort.
+  // The buffer is aligned for large pages, the image is padded to match.
+  //
+  ImageSpan = ALIGN_VALUE (Context.ImageSize, PAYLOAD_IMAGE_ALIGNMENT);
+  if ((Progress == NULL) && (Context.PreferredImageAddress == Context.FileBase) &&
+      !ERROR (PrepareElfInPlaceLoad (&Context, BufferSize)))
+  {
+    mPerfData.Placement = SHIM_PERF_PLACEMENT_IN_PLACE;
+  } else if (IsFreeMemoryRange ((UINTN)Context.PreferredImageAddress, Context.ImageSize)) {
+    ImageSpan            = Context.ImageSize;
+    Context.ImageAddress = Context.PreferredImageAddress;
+    mPerfData.Placement  = SHIM_PERF_PLACEMENT_PREFERRED;
+  } else if ((Progress == NULL) && !ERROR (PrepareElfInPlaceLoad (&Context, BufferSize))) {
+    mPerfData.Placement = SHIM_PERF_PLACEMENT_IN_PLACE_RELOCATED;
+  } else {
+    Context.ImageAddress = AllocatePayloadImage (Context.ImageSize, &ImageSpan);
+    mPerfData.Placement  = SHIM_PERF_PLACEMENT_RELOCATED;
+  }
+  //
+  // Load ELF into the required base
+  //
+  Status = LoadElfImage (&Context);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  *ImageAddressArg        = (UINTN)Context.ImageAddress;
+  *UniversalPayloadEntry  = Context.EntryPoint;
+  *ImageSizeArg           = ImageSpan;
+  *Is64Bit                = (BOOLEAN)(Context.EiClass == ELFCLASS64);
+
+  //
+  // Read the section headers once, the passes below work on the table.
+  //
+  SectionPages = SIZE_TO_PAGES (Context.ShNum * sizeof (ELF_SECTION_ENTRY));
+  Sections     = AllocatePages (SectionPages);
+  if (Sections == NULL) {
+    return ABORTED;
+  }
+
+  GetElfSectionTable (&Context, Sections);
+
+  //
+  // Get UNIVERSAL_PAYLOAD_INFO_HEADER and number of additional PLD sections.
+  // They are gathered at the start of the table in file order, a section
+  // that does not fit in the buffer is dropped.
+  //
+  ExtraDataCount  = 0;
+  CompressedCount = 0;
+  for (Index = 0; Index < Context.ShNum; Index++) {
+    if ((Sections[Index].Name == NULL) ||
+        (AsciiStrnCmp (Sections[Index].Name, UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX, UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX_LENGTH) != 0) ||
+        (Sections[Index].Size > BufferSize) || (Sections[Index].Offset > BufferSize - Sections[Index].Size))
+    {
+      continue;
+    }
+
+    if ((Sections[Index].Flags & ELF_SHF_COMPRESSED) != 0) {
+      Status = GetElfCompressionHeader (
+                 Context.EiClass,
+                 Context.FileBase + Sections[Index].Offset,
+                 Sections[Index].Size,
+                 &Algorithm,
+                 &HeaderSize,
+                 &DecompressedSize,
+                 &Alignment
+                 );
+      if (ERROR (Status)) {
+        Sections[Index].Flags &= ~(UINT64)ELF_SHF_COMPRESSED;
+      } else {
+        CompressedCount++;
+      }
+    }
+
+    if (Index != ExtraDataCount) {
+      CopyMem (&Sections[ExtraDataCount], &Sections[Index], sizeof (ELF_SECTION_ENTRY));
+    }
+
+    ExtraDataCount++;
+  }
+
+  QuickSort (Sections, ExtraDataCount, sizeof (ELF_SECTION_ENTRY), CompareElfSectionOffset, &Swap);
+
+  //
+  // Report the additional PLD sections through HOB.
+  //
+  Length    = sizeof (UNIVERSAL_PAYLOAD_EXTRA_DATA) + ExtraDataCount * sizeof (UNIVERSAL_PAYLOAD_EXTRA_DATA_ENTRY);
+  ExtraData = BuildGuidHob (
+                &gUniversalPayloadExtraDataGuid,
+                Length
+                );
+  if (ExtraData == NULL) {
+    FreePages (Sections, SectionPages);
+    return ABORTED;
+  }
+
+  ExtraData->Count           = ExtraDataCount;
+  ExtraData->Header.Revision = UNIVERSAL_PAYLOAD_EXTRA_DATA_REVISION;
+  ExtraData->Header.Length   = (UINT16)Length;
+
+  //
+  // Compressed sections are left as they are, the payload expands the ones it uses.
+  //
+  CompressedData = NULL;
+  if (CompressedCount != 0) {
+    Length         = sizeof (SHIM_COMPRESSED_EXTRA_DATA) + CompressedCount * sizeof (SHIM_COMPRESSED_EXTRA_DATA_ENTRY);
+    CompressedData = BuildGuidHob (
+                       &gShimCompressedExtraDataGuid,
+                       Length
+                       );
+    if (CompressedData == NULL) {
+      FreePages (Sections, SectionPages);
+      return ABORTED;
+    }
+
+    CompressedData->Count           = CompressedCount;
+    CompressedData->Header.Revision = SHIM_COMPRESSED_EXTRA_DATA_REVISION;
+    CompressedData->Header.Length   = (UINT16)Length;
+  }
+
+  //
+  // The section names live in the ELF file, take them before it is packed.
+  //
+  for (Index = 0; Index < ExtraDataCount; Index++) {
+    AsciiStrCpyS (
+      ExtraData->Entry[Index].Identifier,
+      sizeof (ExtraData->Entry[Index].Identifier),
+      Sections[Index].Name + UNIVERSAL_PAYLOAD_EXTRA_SEC_NAME_PREFIX_LENGTH
+      );
+    ExtraData->Entry[Index].Base = (UINTN)(Context.FileBase + Sections[Index].Offset);
+    ExtraData->Entry[Index].Size = Sections[Index].Size;
+  }
+
+  //
+  // Only the image and the extra sections are used past this point. Pack
+  // the sections after the image when it runs in the buffer, at its start
+  // otherwise, and give the rest of the buffer back. A file still being
+  // decompressed is left alone.
+  //
+  if (Progress == NULL) {
+    Base = (UINTN)Context.FileBase;
+    if (Context.ImageAddress == Context.FileBase) {
+      Base += ImageSpan;
+    }
+
+    Base      = ALIGN_VALUE (PackPayloadExtraData (ExtraData, Base), SIZE_4KB);
+    BufferEnd = ALIGN_VALUE ((UINTN)Context.FileBase + BufferSize, SIZE_4KB);
+    if (Base < BufferEnd) {
+      FreePages ((VOID *)Base, SIZE_TO_PAGES (BufferEnd - Base));
+    }
+  }
+
+  for (Index = 0, CompressedIndex = 0; Index < ExtraDataCount; Index++) {
+    Base = (UINTN)ExtraData->Entry[Index].Base;
+    Size = (UINTN)ExtraData->Entry[Index].Size;
+    if ((Sections[Index].Flags & ELF_SHF_COMPRESSED) != 0) {
+      //
+      // The header was checked above, it moved with the section.
+      //
+      GetElfCompressionHeader (Context.EiClass, (VOID *)Base, Size, &Algorithm, &HeaderSize, &DecompressedSize, &Alignment);
+      Base += HeaderSize;
+      Size -= HeaderSize;
+      CopyMem (
+        CompressedData->Entry[CompressedIndex].Identifier,
+        ExtraData->Entry[Index].Identifier,
+        sizeof (CompressedData->Entry[CompressedIndex].Identifier)
+        );
+      CompressedData->Entry[CompressedIndex].Base             = Base;
+      CompressedData->Entry[CompressedIndex].Size             = Size;
+      CompressedData->Entry[CompressedIndex].DecompressedSize = DecompressedSize;
+      CompressedData->Entry[CompressedIndex].Alignment        = Alignment;
+      CompressedData->Entry[CompressedIndex].Algorithm        = Algorithm;
+      CompressedData->Entry[CompressedIndex].Reserved         = 0;
+      CompressedIndex++;
+    } else if (((Progress == NULL) || (Base + Size <= (UINTN)Context.FileBase + Progress->DecodedSize)) &&
+               IsValidFirmwareVolume ((FIRMWARE_VOLUME_HEADER *)Base, Size))
+    {
+      //
+      // Let the DXE core dispatch FV sections directly. A section still
+      // being decompressed is left to the payload.
+      //
+      FvLength = ((FIRMWARE_VOLUME_HEADER *)Base)->FvLength;
+      ShBuildFvHob (Base, FvLength);
+      ShBuildFv3Hob (Base, FvLength, 0, FALSE, NULL, NULL);
+      BuildFvFileIndexHob ((FIRMWARE_VOLUME_HEADER *)Base);
+#if EXPAND_FV_SECTIONS
+      ExpandFvImageSections ((FIRMWARE_VOLUME_HEADER *)Base);
+#endif
+    }
+
+    ExtraData->Entry[Index].Base = Base;
+    ExtraData->Entry[Index].Size = Size;
+  }
+
+  FreePages (Sections, SectionPages);
+  return SUCCESS;
+}
+
+/**
+  Build the page tables a 64-bit payload is entered with.
+
+  The address space is identity mapped up to the physical address width,
+  with 1GB pages when the processor has them. With 2MB pages the mapping
+  stops at 512GB, the payload maps the rest itself. The tables are
+  described in a gShimPageTableInfoGuid HOB. The page after them holds the
+  GDT the payload is entered with, it is allocated here so the HOB usage
+  taken before the hand-off accounts it.
+
+  @param  Cr3                Return the address of the PML4.
+  @param  Gdtr               Return the descriptor of the long mode GDT.
+
+  @retval SUCCESS            The page tables are built.
+  @retval UNSUPPORTED        The processor has no long mode.
+  @retval ABORTED            No memory for the page tables.
+**/
+RETURN_STATUS
+BuildPayloadPageTables (
+  OUT UINT32          *Cr3,
+  OUT GDT_DESCRIPTOR  *Gdtr
+  )
+{
+  UINT32                RegEax;
+  UINT32                RegEdx;
+  UINT8                 PhysicalAddressBits;
+  BOOLEAN               Page1G;
+  UINTN                 Pml4Entries;
+  UINTN                 PdptEntries;
+  UINTN                 Pages;
+  UINTN                 Pml4Index;
+  UINTN                 PdptIndex;
+  UINTN                 PdIndex;
+  UINT64                *Pml4;
+  UINT64                *Pdpt;
+  UINT64                *Pd;
+  UINT64                Address;
+  UINT64                *Gdt;
+  SHIM_PAGE_TABLE_INFO  *PageTableInfo;
+
+  AsmCpuid (0x80000000, &RegEax, NULL, NULL, NULL);
+  if (RegEax < 0x80000001) {
+    return UNSUPPORTED;
+  }
+
+  PhysicalAddressBits = 36;
+  if (RegEax >= 0x80000008) {
+    AsmCpuid (0x80000008, &RegEax, NULL, NULL, NULL);
+    PhysicalAddressBits = (UINT8)RegEax;
+  }
+
+  AsmCpuid (0x80000001, NULL, NULL, NULL, &RegEdx);
+  if ((RegEdx & BIT29) == 0) {
+    return UNSUPPORTED;
+  }
+
+  Page1G              = (BOOLEAN)((RegEdx & BIT26) != 0);
+  PhysicalAddressBits = MIN (PhysicalAddressBits, Page1G ? 48 : 39);
+  PhysicalAddressBits = MAX (PhysicalAddressBits, 32);
+
+  //
+  // One PML4 page, one PDPT page per 512GB, and with 2MB pages one page
+  // directory per GB.
+  //
+  Pml4Entries = (PhysicalAddressBits > 39) ? ((UINTN)1 << (PhysicalAddressBits - 39)) : 1;
+  PdptEntries = (PhysicalAddressBits > 39) ? 512 : ((UINTN)1 << (PhysicalAddressBits - 30));
+  Pages       = 1 + Pml4Entries;
+  if (!Page1G) {
+    Pages += PdptEntries;
+  }
+
+  Pml4 = AllocatePages (Pages + 1);
+  if (Pml4 == NULL) {
+    return ABORTED;
+  }
+
+  ZeroMem (Pml4, PAGES_TO_SIZE (Pages));
+
+  //
+  // The GDT stays in use until the payload loads its own.
+  //
+  Gdt = Pml4 + Pages * 512;
+  CopyMem (Gdt, mLongModeGdtEntries, sizeof (mLongModeGdtEntries));
+  Gdtr->Limit = sizeof (mLongModeGdtEntries) - 1;
+  Gdtr->Base  = (UINTN)Gdt;
+  Pdpt    = Pml4 + 512;
+  Pd      = Pdpt + Pml4Entries * 512;
+  Address = 0;
+  for (Pml4Index = 0; Pml4Index < Pml4Entries; Pml4Index++, Pdpt += 512) {
+    Pml4[Pml4Index] = (UINTN)Pdpt | PAGE_TABLE_PRESENT | PAGE_TABLE_READ_WRITE;
+    for (PdptIndex = 0; PdptIndex < PdptEntries; PdptIndex++) {
+      if (Page1G) {
+        Pdpt[PdptIndex] = Address | PAGE_TABLE_PRESENT | PAGE_TABLE_READ_WRITE | PAGE_TABLE_PAGE_SIZE;
+        Address        += SIZE_1GB;
+        continue;
+      }
+
+      Pdpt[PdptIndex] = (UINTN)Pd | PAGE_TABLE_PRESENT | PAGE_TABLE_READ_WRITE;
+      for (PdIndex = 0; PdIndex < 512; PdIndex++) {
+        Pd[PdIndex] = Address | PAGE_TABLE_PRESENT | PAGE_TABLE_READ_WRITE | PAGE_TABLE_PAGE_SIZE;
+        Address    += SIZE_2MB;
+      }
+
+      Pd += 512;
+    }
+  }
+
+  PageTableInfo = BuildGuidHob (&gShimPageTableInfoGuid, sizeof (SHIM_PAGE_TABLE_INFO));
+  if (PageTableInfo != NULL) {
+    ZeroMem (PageTableInfo, sizeof (SHIM_PAGE_TABLE_INFO));
+    PageTableInfo->Header.Revision     = SHIM_PAGE_TABLE_INFO_REVISION;
+    PageTableInfo->Header.Length       = sizeof (SHIM_PAGE_TABLE_INFO);
+    PageTableInfo->PhysicalAddressBits = PhysicalAddressBits;
+    PageTableInfo->Flags               = Page1G ? SHIM_PAGE_TABLE_FLAG_1G_PAGES : 0;
+    PageTableInfo->Cr3                 = (UINTN)Pml4;
+    PageTableInfo->Base                = (UINTN)Pml4;
+    PageTableInfo->Size                = PAGES_TO_SIZE (Pages);
+  }
+
+  *Cr3 = (UINT32)(UINTN)Pml4;
+  return SUCCESS;
+}
+
+/**
+  Jump to the payload entry point with the HOB list.
+
+  @param  UniversalPayloadEntry  The entry point of the payload.
+  @param  Hob                    The HOB list.
+  @param  Cr3                    The page tables built by BuildPayloadPageTables()
+                                 for a 64-bit payload, 0 for a 32-bit one.
+  @param  Gdtr                   The long mode GDT built with the page tables.
+
+  @return It does not return.
+**/
+RETURN_STATUS
+HandOffToPayload (
+  IN  ADDRESS         UniversalPayloadEntry,
+  IN  HOB_POINTERS    Hob,
+  IN  UINT32          Cr3,
+  IN  GDT_DESCRIPTOR  *Gdtr
+  )
+{
+  UINTN  HobList;
+
+  HobList = (UINTN)(VOID *)Hob.Raw;
+  if (Cr3 != 0) {
+    AsmEnterLongModePayload (Cr3, Gdtr, UniversalPayloadEntry, (UINT32)HobList);
+  }
+
+  typedef VOID ( *PayloadEntry) (UINTN);
+  ((PayloadEntry) (UINTN) UniversalPayloadEntry) (HobList);
+
+  return SUCCESS;
+}
+
+/**
+
+  Entry point to the C language phase of Shim Layer before UEFI payload.
+
+  @param[in]   BootloaderParameter    The starting address of bootloader parameter block.
+
+  @retval      It will not return if SUCCESS, and return error when passing bootloader parameter.
+
+**/
+RETURN_STATUS
+_ModuleEntryPoint (
+  IN  UINTN  BootloaderParameter
+  )
+{
+  RETURN_STATUS               Status;
+  HOB_POINTERS                Hob;
+  ADDRESS                     ImageAddress;
+  UINT64                      ImageSize;
+  ADDRESS                     UniversalPayloadEntry;
+  PAYLOAD_DECOMPRESS_CONTEXT  *Decompress;
+  BOOLEAN                     Is64Bit;
+  UINT32                      Cr3;
+  GDT_DESCRIPTOR              Gdtr;
+  SHIM_PERF_DATA              *PerfData;
+  SHIM_HOB_USAGE              *HobUsage;
+
+  //
+  // The image may run away from the address it was linked at, fix up its
+  // pointers before anything uses them.
+  //
+  Status = RelocateShimImage ();
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  mPerfData.Timestamp[SHIM_PERF_ID_ENTRY] = AsmReadTsc ();
+
+  SetBootloaderParameter (BootloaderParameter);
+  DebugLibInitialize ();
+  DEBUG ((DEBUG_INFO, "coreboot UPL shim at %p\n", _ModuleEntryPoint));
+
+  //
+  // The HOB region is sized for the payload found in CBFS.
+  //
+  Decompress = &mPayloadDecompress;
+  Status     = GetPayloadDecompressInfo (Decompress);
+  if (ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "No usable %a in CBFS: %r\n", CBFS_UNIVERSAL_PAYLOAD, Status));
+    return Status;
+  }
+
+  Status = InitializeHobRegion (GetHobRegionSize (Decompress));
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+#if PROFILE
+  Status = ProfileInitialize ();
+  if (ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "No memory to profile the shim\n"));
+  }
+#endif
+
+#if MP_SUPPORT || PARK_APS
+  MpInitialize ();
+#endif
+
+  //
+  // Decompress the payload on an AP while the BSP builds the platform HOBs,
+  // the two only share the page and HOB allocators.
+  //
+  Status = StartPayloadDecompression (Decompress);
+  if (ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "No memory to decompress the payload\n"));
+    return Status;
+  }
+
+  Status = ConvertCbmemToHob();
+  if (ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed to build the HOBs from the coreboot tables: %r\n", Status));
+    return Status;
+  }
+
+  mPerfData.Timestamp[SHIM_PERF_ID_HOBS_BUILT] = AsmReadTsc ();
+
+#if ASYNC_DECOMPRESS
+  if (Decompress->Progress != NULL) {
+    //
+    // Decompress on the BSP if no AP got to it, otherwise only wait for the
+    // part of the file needed to load the image. The AP finishes the extra
+    // sections after the handoff.
+    //
+    MpRunUnclaimedWork (&Decompress->Job);
+    Status = WaitForPayloadBootData (Decompress);
+    if (ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "Failed to decompress the payload: %r\n", Status));
+      return Status;
+    }
+  } else
+#endif
+  {
+    MpWaitJob (&Decompress->Job);
+    if (ERROR (Decompress->Status)) {
+      DEBUG ((DEBUG_ERROR, "Failed to decompress the payload: %r\n", Decompress->Status));
+      return Decompress->Status;
+    }
+
+    FreePages (Decompress->Scratch, SIZE_TO_PAGES (Decompress->ScratchSize));
+  }
+
+  mPerfData.Timestamp[SHIM_PERF_ID_PAYLOAD_DECODED] = AsmReadTsc ();
+
+  Status = LoadPayload (
+             Decompress->Dest,
+             Decompress->BufferSize,
+             Decompress->Progress,
+             &ImageAddress,
+             &ImageSize,
+             &UniversalPayloadEntry,
+             &Is64Bit
+             );
+  if (ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed to load the payload: %r\n", Status));
+    return Status;
+  }
+
+  BuildMemoryAllocationHob (ImageAddress, ImageSize, BootServicesData);
+
+#if defined (MDE_CPU_X64)
+  //
+  // The x86-64 build has no way back to 32-bit protected mode.
+  //
+  if (!Is64Bit) {
+    DEBUG ((DEBUG_ERROR, "The x86-64 shim cannot enter a 32-bit payload\n"));
+    return UNSUPPORTED;
+  }
+
+#endif
+  //
+  // A 64-bit payload is entered in long mode on identity mapped page tables.
+  //
+  Cr3 = 0;
+  if (Is64Bit) {
+    Status = BuildPayloadPageTables (&Cr3, &Gdtr);
+    if (ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "No memory for the payload page tables\n"));
+      return Status;
+    }
+  }
+
+  mPerfData.ImageAddress                           = ImageAddress;
+  mPerfData.Timestamp[SHIM_PERF_ID_PAYLOAD_LOADED] = AsmReadTsc ();
+
+#if ASYNC_DECOMPRESS
+  if (Decompress->Progress != NULL) {
+    if (Decompress->Progress->State == SHIM_PAYLOAD_DECOMPRESS_STATE_DONE) {
+      MpWaitJob (&Decompress->Job);
+      FreePages (Decompress->Scratch, SIZE_TO_PAGES (Decompress->ScratchSize));
+    } else {
+      BuildPayloadDecompressHob (Decompress);
+    }
+  }
+#endif
+
+#if MP_SUPPORT || PARK_APS
+  MpQuiesceAps (PARK_APS);
+#endif
+
+  //
+  // Only the memory still allocated is reported to the payload.
+  //
+  HobBuildMemoryAllocationHobs ();
+  HobGetAllocationUsage (&mPerfData.PeakAllocatedSize, &mPerfData.FinalAllocatedSize);
+
+  mPerfData.Header.Revision                 = SHIM_PERF_DATA_REVISION;
+  mPerfData.Header.Length                   = sizeof (SHIM_PERF_DATA);
+  mPerfData.Timestamp[SHIM_PERF_ID_HANDOFF] = AsmReadTsc ();
+  PerfData = HOB_RESERVE_GUID_HOB (&gShimPerfDataGuid, SHIM_PERF_DATA);
+  if (PerfData != NULL) {
+    CopyMem (PerfData, &mPerfData, sizeof (SHIM_PERF_DATA));
+  }
+
+  //
+  // Index the GUID HOBs last so the index covers all of them, the HOB usage
+  // reserved before is filled after so it accounts the index.
+  //
+  HobUsage = HOB_RESERVE_GUID_HOB (&gShimHobUsageGuid, SHIM_HOB_USAGE);
+  HobBuildGuidHobIndex ();
+  if (HobUsage != NULL) {
+    HobGetUsage (HobUsage);
+    DEBUG ((DEBUG_VERBOSE, "HOB list %ld bytes, %ld bytes free\n", HobUsage->HobListSize, HobUsage->FreeSize));
   }
 
-  Status = LoadPayload (&ImageAddress, &ImageSize, &UniversalPayloadEntry);
-  BuildMemoryAllocationHob (ImageAddress, ImageSize, BootServicesData);
   Hob.HandoffInformationTable = (HOB_HANDOFF_INFO_TABLE *)GetFirstHob (HOB_TYPE_HANDOFF);
-  HandOffToPayload (UniversalPayloadEntry, Hob);
+  DEBUG ((
+    DEBUG_INFO,
+    "Enter the %a payload at 0x%lx with the HOB list at %p\n",
+    Is64Bit ? "64-bit" : "32-bit",
+    UniversalPayloadEntry,
+    Hob.Raw
+    ));
+  DebugFlush ();
+  HandOffToPayload (UniversalPayloadEntry, Hob, Cr3, &Gdtr);
 
   return SUCCESS;
 }
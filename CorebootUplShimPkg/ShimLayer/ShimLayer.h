@@ -12,13 +12,25 @@
 #include <BaseLib.h>
 #include <HobLib.h>
 #include <ParseLib.h>
+#include <DebugLib.h>
 #include <ShimLayer/PiFirmware.h>
 #include <ShimLayer/DevicePath.h>
+#include <ShimLayer/Acpi.h>
 #include <ElfLibInternal.h>
 #include <CorebootRelated.h>
 #include <Graphics.h>
 #include <UniversalPayload.h>
 #include <SerialPort.h>
+#include <ShimLayer/ApMailbox.h>
+#include <ShimLayer/PayloadDecompress.h>
+#include <ShimLayer/CompressedExtraData.h>
+#include <ShimLayer/FvFileIndex.h>
+#include <ShimLayer/PerfData.h>
+#include <ShimLayer/PageTable.h>
+#include <ShimLayer/GuidHobIndex.h>
+#include <ShimLayer/LargeGuidHob.h>
+#include <ShimLayer/HobUsage.h>
+#include <ShimLayer/ProfileData.h>
 
 #define LEGACY_8259_MASK_REGISTER_MASTER  0x21
 #define LEGACY_8259_MASK_REGISTER_SLAVE   0xA1
@@ -42,6 +54,373 @@
 #define E820_PMEM      7
 #define E820_UNDEFINED 8
 
+#pragma pack(1)
+///
+/// Patchable data at offset AP_TRAMPOLINE_DATA_OFFSET of the AP trampoline,
+/// keep it in sync with ApStartup.iii.
+///
+typedef struct {
+  UINT16             GdtLimit;
+  UINT32             GdtBase;
+  UINT16             Reserved;
+  UINT32             ProtectedModeEntry;
+  UINT16             ProtectedModeSelector;
+  UINT16             DataSelector;
+  UINT32             StackBase;
+  UINT32             StackSize;
+  UINT32             MaxCpuCount;
+  UINT32             CEntry;
+  volatile UINT32    NextCpuIndex;
+  UINT32             HaltLoop;
+} AP_TRAMPOLINE_DATA;
+#pragma pack()
+
+#define AP_TRAMPOLINE_DATA_OFFSET  8
+
+//
+// The ring of a PROFILE=1 build holds the last PROFILE_ENTRY_COUNT returns.
+//
+#ifndef PROFILE_ENTRY_COUNT
+#define PROFILE_ENTRY_COUNT  0x10000
+#endif
+#define PROFILE_BUFFER_SIZE \
+  ALIGN_VALUE (sizeof (SHIM_PROFILE_BUFFER) + PROFILE_ENTRY_COUNT * sizeof (SHIM_PROFILE_ENTRY), SIZE_4KB)
+
+///
+/// Pages handing out short-lived buffers, all freed together.
+///
+typedef struct {
+  UINT8    *Base;
+  UINTN    Size;
+  UINTN    Used;
+} SHIM_ARENA;
+
+extern UINT8  ApTrampolineStart[];
+extern UINT8  ApTrampolineEnd[];
+extern UINT8  ApProtectedModeEntry[];
+extern UINT8  ApParkLoopStart[];
+extern UINT8  ApParkLoopEnd[];
+extern UINT8  ApHaltLoop[];
+
+#pragma pack(1)
+///
+/// The operand of LGDT, the base is 64-bit in long mode.
+///
+typedef struct {
+  UINT16    Limit;
+  UINTN     Base;
+} GDT_DESCRIPTOR;
+#pragma pack()
+
+/**
+  Switch to long mode and enter a 64-bit payload, see LongMode.iii or
+  X64/LongMode.iii for the x86-64 build.
+
+  @param  Cr3                The identity mapping page tables.
+  @param  Gdtr               A GDT with the long mode selectors.
+  @param  EntryPoint         The 64-bit entry point of the payload.
+  @param  HobList            The HOB list passed to the payload.
+**/
+VOID
+AsmEnterLongModePayload (
+  IN UINT32          Cr3,
+  IN GDT_DESCRIPTOR  *Gdtr,
+  IN UINT64          EntryPoint,
+  IN UINT32          HobList
+  );
+
+/**
+  Allocates one or more pages of type BootServicesData.
+
+  @param   Pages                 The number of 4 KB pages to allocate.
+  @return  A pointer to the allocated buffer or NULL if allocation fails.
+**/
+VOID *
+AllocatePages (
+  IN UINTN  Pages
+  );
+
+/**
+  Allocates one or more pages of type ReservedMemoryType.
+
+  The payload and the OS will not reuse the memory.
+
+  @param   Pages                 The number of 4 KB pages to allocate.
+  @return  A pointer to the allocated buffer or NULL if allocation fails.
+**/
+VOID *
+AllocateReservedPages (
+  IN UINTN  Pages
+  );
+
+/**
+  Allocates one or more pages of type BootServicesData at an alignment.
+
+  @param   Pages                 The number of 4 KB pages to allocate.
+  @param   Alignment             The alignment of the buffer, a power of two.
+  @return  A pointer to the allocated buffer or NULL if allocation fails.
+**/
+VOID *
+AllocateAlignedPages (
+  IN UINTN  Pages,
+  IN UINTN  Alignment
+  );
+
+/**
+  Frees pages allocated by AllocatePages() or AllocateReservedPages().
+
+  @param   Buffer                The first page to free.
+  @param   Pages                 The number of 4 KB pages to free.
+**/
+VOID
+FreePages (
+  IN VOID   *Buffer,
+  IN UINTN  Pages
+  );
+
+/**
+  Allocates the pages backing a scratch arena.
+
+  @param   Arena                 The arena to set up.
+  @param   Size                  The size of the arena.
+
+  @retval  SUCCESS               The arena is ready.
+  @retval  ABORTED               Not enough memory.
+**/
+RETURN_STATUS
+ArenaCreate (
+  OUT SHIM_ARENA  *Arena,
+  IN  UINTN       Size
+  );
+
+/**
+  Carves a buffer from a scratch arena.
+
+  @param   Arena                 The arena set up by ArenaCreate().
+  @param   Size                  The size of the buffer.
+  @param   Alignment             The alignment of the buffer, a power of two
+                                 up to 4 KB.
+  @return  A pointer to the buffer or NULL if the arena is full.
+**/
+VOID *
+ArenaAllocate (
+  IN OUT SHIM_ARENA  *Arena,
+  IN     UINTN       Size,
+  IN     UINTN       Alignment
+  );
+
+/**
+  Frees a scratch arena and every buffer carved from it.
+
+  @param   Arena                 The arena set up by ArenaCreate().
+**/
+VOID
+ArenaDestroy (
+  IN OUT SHIM_ARENA  *Arena
+  );
+
+/**
+  A work item procedure run by the MP services.
+
+  @param  Context            The context given when the job was created.
+  @param  Index              The index of the work item, from 0 to Count - 1.
+**/
+typedef VOID (*SHIM_MP_PROCEDURE) (
+  IN VOID    *Context,
+  IN UINT32  Index
+  );
+
+typedef struct _MP_JOB_SLOT  MP_JOB_SLOT;
+
+typedef struct {
+  SHIM_MP_PROCEDURE    Procedure;
+  VOID                 *Context;
+  UINT32               Count;
+  volatile UINT32      NextIndex;
+  volatile UINT32      DoneCount;
+  MP_JOB_SLOT          *Slot;
+} SHIM_MP_JOB;
+
+struct _MP_JOB_SLOT {
+  SHIM_MP_JOB *volatile    Job;
+  volatile UINT32          Active;
+};
+
+///
+/// Progress is only set when the decompression may outlive the handoff,
+/// ApicId then names the processor running it.
+/// BufferSize counts the room reserved after the ELF file at Dest.
+///
+typedef struct {
+  SHIM_MP_JOB                         Job;
+  ADDRESS                             Source;
+  UINT32                              SourceSize;
+  VOID                                *Dest;
+  UINT32                              DestSize;
+  UINT32                              BufferSize;
+  UINT32                              Alignment;
+  VOID                                *Scratch;
+  UINT32                              ScratchSize;
+  SHIM_PAYLOAD_DECOMPRESS_PROGRESS    *Progress;
+  UINT32                              ApicId;
+  RETURN_STATUS                       Status;
+} PAYLOAD_DECOMPRESS_CONTEXT;
+
+///
+/// A range checked against the bootloader memory map.
+///
+typedef struct {
+  ADDRESS    Base;
+  UINT64     Size;
+  BOOLEAN    Usable;
+} MEMORY_RANGE_CHECK;
+
+///
+/// The usable RAM range picked for the HOB region, Length is 0 until one
+/// fits Size with its top aligned to Alignment.
+///
+typedef struct {
+  UINT64     Size;
+  UINT64     Alignment;
+  ADDRESS    Top;
+  UINT64     Length;
+} HOB_REGION_PLACEMENT;
+
+/**
+  Apply the relative relocations of the shim image for the address it runs at.
+
+  Nothing may read a pointer from the image data before this returns, it is
+  the first call of the entry point.
+
+  @retval SUCCESS            The image can run where it is.
+  @retval UNSUPPORTED        The image has a relocation that is not relative.
+**/
+RETURN_STATUS
+RelocateShimImage (
+  VOID
+  );
+
+/**
+  Get the memory the shim image occupies where it runs, its BSS included.
+
+  @param  Base               Return the base of the image.
+  @param  Size               Return the page aligned size of the image.
+**/
+VOID
+GetShimImageRange (
+  OUT UINTN  *Base,
+  OUT UINTN  *Size
+  );
+
+/**
+  Allocate the profile buffer of a PROFILE=1 build and report it in a HOB.
+
+  The HOB region must have been set up by InitializeHobRegion(). Only the
+  functions returning after this call are recorded, and only on the BSP.
+
+  @retval SUCCESS            The shim functions are profiled.
+  @retval ABORTED            No memory for the profile buffer.
+**/
+RETURN_STATUS
+ProfileInitialize (
+  VOID
+  );
+
+/**
+  Wake up all APs and put them to work on the shim job slots.
+
+  @retval SUCCESS      The APs are running, or there is no AP.
+  @retval NOT_FOUND    No memory below 1MB for the wake-up buffer.
+  @retval ABORTED      Failed to allocate memory for the APs.
+  @retval UNSUPPORTED  The x86-64 build starts no AP.
+**/
+RETURN_STATUS
+MpInitialize (
+  VOID
+  );
+
+/**
+  Get the number of APs serving the shim job slots.
+
+  @return The number of started APs.
+**/
+UINT32
+MpGetApCount (
+  VOID
+  );
+
+/**
+  Get the local APIC ID of the executing processor, only valid once
+  MpInitialize() started APs.
+
+  @return The APIC ID.
+**/
+UINT32
+MpGetApicId (
+  VOID
+  );
+
+/**
+  Call Procedure once for every index in [0, Count), spread over the BSP and
+  all APs. Returns when every call has completed.
+
+  @param  Count              The number of work items.
+  @param  Procedure          The function called for each work item.
+  @param  Context            The context passed to Procedure.
+**/
+VOID
+MpParallelFor (
+  IN UINT32             Count,
+  IN SHIM_MP_PROCEDURE  Procedure,
+  IN VOID               *Context
+  );
+
+/**
+  Start a job in the background on the APs. The caller owns Job and must keep
+  it alive until MpWaitJob() returns.
+
+  @param  Job                The job, Procedure, Context and Count must be set.
+**/
+VOID
+MpStartJob (
+  IN SHIM_MP_JOB  *Job
+  );
+
+/**
+  Run the work items of a job started by MpStartJob() that no AP claimed yet
+  on the BSP. Unlike MpWaitJob() it does not wait for the items the APs run.
+
+  @param  Job                The job to help.
+**/
+VOID
+MpRunUnclaimedWork (
+  IN SHIM_MP_JOB  *Job
+  );
+
+/**
+  Wait for a job started by MpStartJob(), running the work items no AP
+  picked up yet on the BSP.
+
+  @param  Job                The job to wait for.
+**/
+VOID
+MpWaitJob (
+  IN SHIM_MP_JOB  *Job
+  );
+
+/**
+  Move every AP out of the shim into the park loop in reserved memory. Must be
+  called before handing off to the payload.
+
+  @param  PublishMailbox     Report the AP mailboxes through gShimApMailboxInfoGuid HOB.
+**/
+VOID
+MpQuiesceAps (
+  IN BOOLEAN  PublishMailbox
+  );
+
+extern GUID gLzmaCustomDecompressGuid;
+
 RETURN_STATUS
 LzmaUefiDecompressGetInfo (
   IN  CONST VOID  *Source,
@@ -63,6 +442,48 @@ UpdateStackHob (
   IN UINT64         Length
   );
 
+/**
+  Check whether a buffer starts with a valid firmware volume.
+
+  @param  FvHeader           The buffer to check.
+  @param  Size               The size of the buffer.
+
+  @retval TRUE               The buffer holds a firmware volume of FvHeader->FvLength bytes.
+  @retval FALSE              The buffer does not start with a valid firmware volume.
+**/
+BOOLEAN
+IsValidFirmwareVolume (
+  IN CONST FIRMWARE_VOLUME_HEADER  *FvHeader,
+  IN UINT64                        Size
+  );
+
+/**
+  Build the GUID HOB indexing the FFS files of a firmware volume.
+
+  @param  FvHeader           A valid firmware volume.
+
+  @retval SUCCESS            The index HOB was built.
+  @retval NOT_FOUND          The volume holds no file to index.
+  @retval UNSUPPORTED        The index does not fit in a HOB.
+**/
+RETURN_STATUS
+BuildFvFileIndexHob (
+  IN FIRMWARE_VOLUME_HEADER  *FvHeader
+  );
+
+/**
+  Decompress the LZMA GUIDed sections of the firmware volume image files in
+  a firmware volume and report the firmware volumes they hold.
+
+  @param  FvHeader           A valid firmware volume.
+
+  @return The number of firmware volumes reported.
+**/
+UINT32
+ExpandFvImageSections (
+  IN FIRMWARE_VOLUME_HEADER  *FvHeader
+  );
+
 /**
   This function searchs a given section type within a valid FFS file.
 
@@ -111,6 +532,21 @@ LzmaUefiDecompress (
   IN OUT VOID    *Scratch
   );
 
+RETURN_STATUS
+LzmaUefiDecompressBegin (
+  IN CONST VOID  *Source,
+  IN UINTN       SourceSize,
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  );
+
+RETURN_STATUS
+LzmaUefiDecompressContinue (
+  IN OUT VOID   *Scratch,
+  IN     UINTN  Limit,
+  OUT    UINTN  *DecodedSize
+  );
+
 /**
   Auto-generated function that calls the library constructors for all of the module's
   dependent libraries.  This function must be called by the SEC Core once a stack has
@@ -0,0 +1,233 @@
+/** @file
+  Host benchmark of the GUID HOB lookups.
+
+  Builds a HOB list with many GUID HOBs, interleaved with resource descriptor
+  HOBs, with the HobLib of the shim built for the host. Every HOB of every
+  GUID is then looked up with GetFirstGuidHob() and GetNextGuidHob(), first
+  with the linear walk and again after HobBuildGuidHobIndex() indexed the
+  list. Both walks must find the same HOBs.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#undef NULL
+#include "HobLib.h"
+
+/**
+  Return the GUID of benchmark HOB group Index.
+**/
+STATIC
+VOID
+GetBenchGuid (
+  IN  UINT32  Index,
+  OUT GUID    *Guid
+  )
+{
+  UINT32  Hash;
+
+  Hash = Index * 2654435761U;
+  ZeroMem (Guid, sizeof (GUID));
+  Guid->Data1    = Hash;
+  Guid->Data2    = (UINT16)Index;
+  Guid->Data3    = 0x4a5b;
+  Guid->Data4[0] = (UINT8)(Hash >> 24);
+  Guid->Data4[7] = (UINT8)Index;
+}
+
+/**
+  Return the monotonic time in nanoseconds.
+**/
+STATIC
+UINT64
+GetTimeNs (
+  VOID
+  )
+{
+  struct timespec  Now;
+
+  clock_gettime (CLOCK_MONOTONIC, &Now);
+  return (UINT64)Now.tv_sec * 1000000000ULL + (UINT64)Now.tv_nsec;
+}
+
+/**
+  Look up every HOB of every benchmark GUID, and one GUID with no HOB.
+
+  @param  GuidCount        The number of benchmark GUIDs.
+  @param  Found            Return the offsets of the HOBs found in lookup
+                           order, NULL to only count them.
+
+  @return The number of HOBs found.
+**/
+STATIC
+UINT32
+LookupAll (
+  IN  UINT32  GuidCount,
+  OUT UINT32  *Found  OPTIONAL
+  )
+{
+  HOB_POINTERS  Hob;
+  GUID          Guid;
+  UINT32        Count;
+  UINT32        Index;
+
+  Count = 0;
+  for (Index = 0; Index <= GuidCount; Index++) {
+    GetBenchGuid (Index, &Guid);
+    for (Hob.Raw = GetFirstGuidHob (&Guid); Hob.Raw != NULL; Hob.Raw = GetNextGuidHob (&Guid, GET_NEXT_HOB (Hob))) {
+      if (Found != NULL) {
+        Found[Count] = (UINT32)((UINTN)Hob.Raw - (UINTN)GetHobList ());
+      }
+
+      Count++;
+    }
+  }
+
+  return Count;
+}
+
+/**
+  Time LookupAll() and return the fastest of Iterations rounds.
+**/
+STATIC
+UINT64
+TimeLookupAll (
+  IN UINT32  GuidCount,
+  IN UINT32  Iterations
+  )
+{
+  UINT64  Start;
+  UINT64  Elapsed;
+  UINT64  Time;
+  UINT32  Index;
+
+  Time = MAX_UINT64;
+  for (Index = 0; Index < Iterations; Index++) {
+    Start   = GetTimeNs ();
+    LookupAll (GuidCount, NULL);
+    Elapsed = GetTimeNs () - Start;
+    Time    = MIN (Time, Elapsed);
+  }
+
+  return Time;
+}
+
+STATIC
+VOID
+Usage (
+  VOID
+  )
+{
+  printf (
+    "Usage: GuidHobBench [-n hobs] [-g guids] [-i iterations]\n"
+    "  -n  number of GUID HOBs, 2000 by default, the index holds up to 3270\n"
+    "  -g  number of distinct GUIDs they use, 100 by default\n"
+    "  -i  number of timed rounds, the fastest is reported, 50 by default\n"
+    );
+}
+
+int
+main (
+  int   Argc,
+  char  **Argv
+  )
+{
+  UINT32         HobCount;
+  UINT32         GuidCount;
+  UINT32         Iterations;
+  UINT32         Index;
+  UINT32         Count;
+  UINT32         IndexedCount;
+  UINT32         *Linear;
+  UINT32         *Indexed;
+  UINT8          *Region;
+  UINTN          RegionSize;
+  UINT64         *Data;
+  GUID           Guid;
+  RETURN_STATUS  Status;
+  UINT64         LinearTime;
+  UINT64         IndexTime;
+  UINT64         BuildTime;
+  int            Arg;
+
+  HobCount   = 2000;
+  GuidCount  = 100;
+  Iterations = 50;
+  for (Arg = 1; Arg < Argc; Arg++) {
+    if ((Arg + 1 < Argc) && (strcmp (Argv[Arg], "-n") == 0)) {
+      HobCount = (UINT32)strtoul (Argv[++Arg], NULL, 0);
+    } else if ((Arg + 1 < Argc) && (strcmp (Argv[Arg], "-g") == 0)) {
+      GuidCount = (UINT32)strtoul (Argv[++Arg], NULL, 0);
+    } else if ((Arg + 1 < Argc) && (strcmp (Argv[Arg], "-i") == 0)) {
+      Iterations = (UINT32)strtoul (Argv[++Arg], NULL, 0);
+    } else {
+      Usage ();
+      return 1;
+    }
+  }
+
+  if ((HobCount == 0) || (GuidCount == 0) || (Iterations == 0)) {
+    Usage ();
+    return 1;
+  }
+
+  //
+  // Each GUID HOB carries 8 bytes of data and is followed by a resource
+  // descriptor HOB, as the memory map HOBs mix with the GUID HOBs.
+  //
+  RegionSize = SIZE_64KB + (UINTN)HobCount * 128;
+  Region     = aligned_alloc (SIZE_4KB, RegionSize);
+  Linear     = calloc (HobCount + 1, sizeof (UINT32));
+  Indexed    = calloc (HobCount + 1, sizeof (UINT32));
+  if ((Region == NULL) || (Linear == NULL) || (Indexed == NULL)) {
+    fprintf (stderr, "No memory for the HOB list\n");
+    return 1;
+  }
+
+  HobConstructor (Region, Region + RegionSize, Region, Region + RegionSize);
+  for (Index = 0; Index < HobCount; Index++) {
+    GetBenchGuid (Index % GuidCount, &Guid);
+    Data = BuildGuidHob (&Guid, sizeof (UINT64));
+    if (Data == NULL) {
+      fprintf (stderr, "No room for GUID HOB %u\n", Index);
+      return 1;
+    }
+
+    *Data = Index;
+    BuildResourceDescriptorHob (RESOURCE_SYSTEM_MEMORY, 0, (ADDRESS)Index * SIZE_1MB, SIZE_1MB);
+  }
+
+  Count      = LookupAll (GuidCount, Linear);
+  LinearTime = TimeLookupAll (GuidCount, Iterations);
+
+  BuildTime = GetTimeNs ();
+  Status    = HobBuildGuidHobIndex ();
+  BuildTime = GetTimeNs () - BuildTime;
+  if (ERROR (Status)) {
+    fprintf (stderr, "The index of %u GUID HOBs does not fit in a HOB\n", HobCount);
+    return 1;
+  }
+
+  IndexedCount = LookupAll (GuidCount, Indexed);
+  IndexTime    = TimeLookupAll (GuidCount, Iterations);
+
+  printf ("%u GUID HOBs of %u GUIDs, %u lookups per round, fastest of %u rounds\n", HobCount, GuidCount, Count + GuidCount + 1, Iterations);
+  printf ("linear walk: %10.3f us per round, %8.1f ns per lookup\n", LinearTime / 1e3, (double)LinearTime / (Count + GuidCount + 1));
+  printf ("index:       %10.3f us per round, %8.1f ns per lookup, %.3f us to build\n", IndexTime / 1e3, (double)IndexTime / (Count + GuidCount + 1), BuildTime / 1e3);
+
+  if ((Count != HobCount) || (IndexedCount != Count) || (memcmp (Linear, Indexed, Count * sizeof (UINT32)) != 0)) {
+    printf ("The lookups found different HOBs\n");
+    return 1;
+  }
+
+  free (Indexed);
+  free (Linear);
+  free (Region);
+  return 0;
+}
@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+## @file
+#  Decode the HOB usage records of the shim layer from a memory dump.
+#
+#  The dump is a raw image of physical memory starting at --base. Every
+#  SHIM_HOB_USAGE record in it is printed, the live one in the shim data and
+#  the copy handed off in a HOB, then the HOB list it points to is walked to
+#  print its composition and the free room left in the HOB region.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import struct
+import sys
+import uuid
+
+SHIM_HOB_USAGE_SIGNATURE = b'HOBUSAGE'
+SHIM_HOB_USAGE_TYPE_COUNT = 16
+
+#
+# SHIM_HOB_USAGE, Include/ShimLayer/HobUsage.h
+#
+HOB_USAGE_FORMAT = '<BBHIQQQQQQQQII%dI%dI' % (SHIM_HOB_USAGE_TYPE_COUNT, SHIM_HOB_USAGE_TYPE_COUNT)
+HOB_USAGE_SIZE = struct.calcsize(HOB_USAGE_FORMAT)
+
+HOB_GENERIC_HEADER_FORMAT = '<HHI'
+HOB_GENERIC_HEADER_SIZE = struct.calcsize(HOB_GENERIC_HEADER_FORMAT)
+HOB_HANDOFF_FORMAT = '<IIQQQQQ'
+
+HOB_TYPE_HANDOFF = 0x0001
+HOB_TYPE_GUID_EXTENSION = 0x0004
+HOB_TYPE_UNUSED = 0xFFFE
+HOB_TYPE_END_OF_HOB_LIST = 0xFFFF
+
+HOB_TYPE_NAMES = {
+    0x0001: 'Handoff',
+    0x0002: 'MemoryAllocation',
+    0x0003: 'ResourceDescriptor',
+    0x0004: 'GuidExtension',
+    0x0005: 'Fv',
+    0x0006: 'Cpu',
+    0x0007: 'MemoryPool',
+    0x0009: 'Fv2',
+    0x000A: 'LoadPeimUnused',
+    0x000B: 'UCapsule',
+    0x000C: 'Fv3',
+    HOB_TYPE_UNUSED: 'Unused',
+}
+
+GUID_NAMES = {
+    uuid.UUID('39f62cce-6825-4669-bb56-541aba753a07'): 'gGraphicsInfoHobGuid',
+    uuid.UUID('e5cb2ac9-d35d-4430-936e-1de332478de7'): 'gGraphicsDeviceInfoHobGuid',
+    uuid.UUID('590a0d26-06e5-4d20-8a82-59ea1b34982d'): 'gUniversalPayloadSmbiosTableGuid',
+    uuid.UUID('9f9a9506-5597-4515-bab6-8bcde784ba87'): 'gUniversalPayloadAcpiTableGuid',
+    uuid.UUID('15a5baf6-1c91-467d-9dfb-319d178d4bb4'): 'gUniversalPayloadExtraDataGuid',
+    uuid.UUID('aa7e190d-be21-4409-8e67-a2cd0f61e170'): 'gUniversalPayloadSerialPortInfoGuid',
+    uuid.UUID('c7e65e4a-f22a-44e8-b9fa-8e4736d9582f'): 'gShimApMailboxInfoGuid',
+    uuid.UUID('3f6e97a1-c716-4920-a809-ed76e249dd64'): 'gShimPayloadDecompressInfoGuid',
+    uuid.UUID('4c84dd5b-9927-4a9c-b28b-2bd390b68be7'): 'gShimCompressedExtraDataGuid',
+    uuid.UUID('eae24c30-d7c5-464b-adfe-5107ddd8606f'): 'gShimFvFileIndexGuid',
+    uuid.UUID('6e03be25-9062-4263-8587-66a2a70d5f0b'): 'gShimPerfDataGuid',
+    uuid.UUID('583ed297-967a-4d18-8249-473f7436e8a3'): 'gShimPageTableInfoGuid',
+    uuid.UUID('6f421806-8a2b-4260-81ab-f74c94554c1e'): 'gShimHobUsageGuid',
+    uuid.UUID('3ad3e71d-6874-4b1a-88fa-d05c3bd62ad7'): 'gShimGuidHobIndexGuid',
+    uuid.UUID('3f2315c3-82a7-45c7-b08f-01fc8faf90de'): 'gShimLargeGuidHobGuid',
+    uuid.UUID('cc9579e5-d66c-422b-a624-7a5da0a793cd'): 'gShimProfileDataGuid',
+}
+
+SHIM_HOB_USAGE_GUID = uuid.UUID('6f421806-8a2b-4260-81ab-f74c94554c1e')
+
+
+def HobTypeName(HobType):
+    return HOB_TYPE_NAMES.get(HobType, 'Type 0x%04x' % HobType)
+
+
+def GuidName(Guid):
+    return GUID_NAMES.get(Guid, str(Guid))
+
+
+def Size(Value):
+    return '%d (0x%x)' % (Value, Value)
+
+
+class MemoryDump:
+    def __init__(self, Data, Base):
+        self.Data = Data
+        self.Base = Base
+
+    def Read(self, Address, Length):
+        Offset = Address - self.Base
+        if Offset < 0 or Offset + Length > len(self.Data):
+            return None
+        return self.Data[Offset:Offset + Length]
+
+    def FindAll(self, Pattern):
+        Offset = self.Data.find(Pattern)
+        while Offset >= 0:
+            yield self.Base + Offset
+            Offset = self.Data.find(Pattern, Offset + 1)
+
+
+def FindHobUsage(Dump):
+    """Yield (address, fields, is_hob) for each valid SHIM_HOB_USAGE record."""
+    for SignatureAddress in Dump.FindAll(SHIM_HOB_USAGE_SIGNATURE):
+        Address = SignatureAddress - 8
+        Raw = Dump.Read(Address, HOB_USAGE_SIZE)
+        if Raw is None:
+            continue
+
+        Fields = struct.unpack(HOB_USAGE_FORMAT, Raw)
+        if Fields[0] != 1 or Fields[2] != HOB_USAGE_SIZE:
+            continue
+
+        IsHob = False
+        Header = Dump.Read(Address - HOB_GENERIC_HEADER_SIZE - 16, HOB_GENERIC_HEADER_SIZE + 16)
+        if Header is not None:
+            HobType = struct.unpack_from(HOB_GENERIC_HEADER_FORMAT, Header)[0]
+            Name = uuid.UUID(bytes_le=Header[HOB_GENERIC_HEADER_SIZE:])
+            IsHob = HobType == HOB_TYPE_GUID_EXTENSION and Name == SHIM_HOB_USAGE_GUID
+
+        yield Address, Fields, IsHob
+
+
+def PrintHobUsage(Address, Fields, IsHob):
+    (_, _, _, _, _, HobList, HobListSize, FreeSize, MinFreeSize, AllocatedSize,
+     PeakAllocatedSize, PeakScratchSize, FailedHobCount, FailedAllocationCount) = Fields[:14]
+    HobCount = Fields[14:14 + SHIM_HOB_USAGE_TYPE_COUNT]
+    HobBytes = Fields[14 + SHIM_HOB_USAGE_TYPE_COUNT:]
+
+    print('HOB usage at 0x%x, %s' % (Address, 'handed off in a HOB' if IsHob else 'live in the shim data'))
+    print('  HOB list               0x%x' % HobList)
+    print('  HOB list size          %s' % Size(HobListSize))
+    print('  Free size              %s' % Size(FreeSize))
+    print('  Least free size        %s' % Size(MinFreeSize))
+    print('  Allocated size         %s' % Size(AllocatedSize))
+    print('  Peak allocated size    %s' % Size(PeakAllocatedSize))
+    print('  Peak scratch size      %s' % Size(PeakScratchSize))
+    print('  Failed HOBs            %d' % FailedHobCount)
+    print('  Failed allocations     %d' % FailedAllocationCount)
+    for Index in range(SHIM_HOB_USAGE_TYPE_COUNT):
+        if HobCount[Index] != 0:
+            Name = HobTypeName(HOB_TYPE_UNUSED if Index == 0 else Index)
+            print('  %-22s %5d HOBs %8d bytes' % (Name, HobCount[Index], HobBytes[Index]))
+
+    return HobList
+
+
+def PrintHobList(Dump, HobList):
+    Phit = Dump.Read(HobList, HOB_GENERIC_HEADER_SIZE + struct.calcsize(HOB_HANDOFF_FORMAT))
+    if Phit is None:
+        print('HOB list at 0x%x is not in the dump' % HobList)
+        return
+
+    HobType = struct.unpack_from(HOB_GENERIC_HEADER_FORMAT, Phit)[0]
+    if HobType != HOB_TYPE_HANDOFF:
+        print('No PHIT HOB at 0x%x' % HobList)
+        return
+
+    (_, _, MemoryTop, MemoryBottom, FreeMemoryTop, FreeMemoryBottom,
+     EndOfHobList) = struct.unpack_from(HOB_HANDOFF_FORMAT, Phit, HOB_GENERIC_HEADER_SIZE)
+
+    Types = {}
+    Guids = {}
+    Address = HobList
+    while True:
+        Header = Dump.Read(Address, HOB_GENERIC_HEADER_SIZE)
+        if Header is None:
+            print('HOB list runs out of the dump at 0x%x' % Address)
+            break
+
+        HobType, HobLength, _ = struct.unpack(HOB_GENERIC_HEADER_FORMAT, Header)
+        if HobType == HOB_TYPE_END_OF_HOB_LIST:
+            break
+
+        if HobLength < HOB_GENERIC_HEADER_SIZE:
+            print('Bad HOB length %d at 0x%x' % (HobLength, Address))
+            break
+
+        Count, Bytes = Types.get(HobType, (0, 0))
+        Types[HobType] = (Count + 1, Bytes + HobLength)
+        if HobType == HOB_TYPE_GUID_EXTENSION:
+            Name = Dump.Read(Address + HOB_GENERIC_HEADER_SIZE, 16)
+            if Name is not None:
+                Name = uuid.UUID(bytes_le=Name)
+                Count, Bytes = Guids.get(Name, (0, 0))
+                Guids[Name] = (Count + 1, Bytes + HobLength)
+
+        Address += HobLength
+
+    print('HOB list at 0x%x' % HobList)
+    print('  HOB region             0x%x - 0x%x, %s' % (MemoryBottom, MemoryTop, Size(MemoryTop - MemoryBottom)))
+    print('  HOB list               0x%x - 0x%x, %s' % (HobList, FreeMemoryBottom, Size(FreeMemoryBottom - HobList)))
+    print('  Page allocations       0x%x - 0x%x, %s' % (FreeMemoryTop, MemoryTop, Size(MemoryTop - FreeMemoryTop)))
+    print('  Free headroom          %s' % Size(max(FreeMemoryTop - FreeMemoryBottom, 0)))
+    if EndOfHobList != Address:
+        print('  EndOfHobList 0x%x does not match the end of list HOB at 0x%x' % (EndOfHobList, Address))
+
+    for HobType in sorted(Types):
+        Count, Bytes = Types[HobType]
+        print('  %-22s %5d HOBs %8d bytes' % (HobTypeName(HobType), Count, Bytes))
+
+    for Name in sorted(Guids, key=lambda Guid: -Guids[Guid][1]):
+        Count, Bytes = Guids[Name]
+        print('    %-36s %5d HOBs %8d bytes' % (GuidName(Name), Count, Bytes))
+
+
+def Main():
+    Parser = argparse.ArgumentParser(description='Decode the shim HOB usage records from a memory dump.')
+    Parser.add_argument('Dump', help='raw memory dump file')
+    Parser.add_argument('-b', '--base', type=lambda Value: int(Value, 0), default=0,
+                        help='physical address of the first byte of the dump, 0 by default')
+    Args = Parser.parse_args()
+
+    with open(Args.Dump, 'rb') as File:
+        Dump = MemoryDump(File.read(), Args.base)
+
+    HobLists = []
+    for Address, Fields, IsHob in FindHobUsage(Dump):
+        HobList = PrintHobUsage(Address, Fields, IsHob)
+        if HobList not in HobLists:
+            HobLists.append(HobList)
+        print()
+
+    if len(HobLists) == 0:
+        print('No HOB usage record found')
+        return 1
+
+    for HobList in HobLists:
+        PrintHobList(Dump, HobList)
+        print()
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(Main())
@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+## @file
+#  Symbolize the function profile of a PROFILE=1 shim layer build.
+#
+#  The dump is a raw image of physical memory starting at --base, or a copy
+#  of the profile buffer alone. The SHIM_PROFILE_BUFFER in it is found by its
+#  signature, its ring is summed up by function and the functions are named
+#  from the symbol table of ShimLayer.elf. Inclusive cycles count the
+#  functions a function called, self cycles do not.
+#
+#  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+#  SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import argparse
+import struct
+import subprocess
+import sys
+
+SHIM_PROFILE_SIGNATURE = b'SHIMPROF'
+
+#
+# SHIM_PROFILE_BUFFER and SHIM_PROFILE_ENTRY, Include/ShimLayer/ProfileData.h
+#
+PROFILE_BUFFER_FORMAT = '<QIIQQQQ'
+PROFILE_BUFFER_SIZE = struct.calcsize(PROFILE_BUFFER_FORMAT)
+PROFILE_ENTRY_FORMAT = '<IHHQ'
+PROFILE_ENTRY_SIZE = struct.calcsize(PROFILE_ENTRY_FORMAT)
+
+SHT_SYMTAB = 2
+STT_FUNC = 2
+
+
+class ElfSymbols:
+    """The function symbols of an ELF file, looked up by address."""
+
+    def __init__(self, Path):
+        with open(Path, 'rb') as File:
+            Data = File.read()
+
+        if Data[:4] != b'\x7fELF':
+            raise ValueError('%s is not an ELF file' % Path)
+
+        Is64Bit = Data[4] == 2
+        if Is64Bit:
+            ShOff, = struct.unpack_from('<Q', Data, 0x28)
+            ShEntSize, ShNum = struct.unpack_from('<HH', Data, 0x3A)
+            SectionFormat = '<IIQQQQIIQQ'
+            SymbolFormat = '<IBBHQQ'
+        else:
+            ShOff, = struct.unpack_from('<I', Data, 0x20)
+            ShEntSize, ShNum = struct.unpack_from('<HH', Data, 0x2E)
+            SectionFormat = '<IIIIIIIIII'
+            SymbolFormat = '<IIIBBH'
+
+        Sections = [struct.unpack_from(SectionFormat, Data, ShOff + Index * ShEntSize) for Index in range(ShNum)]
+        self.Functions = []
+        for Section in Sections:
+            if Section[1] != SHT_SYMTAB:
+                continue
+
+            Offset, Size, Link, EntSize = Section[4], Section[5], Section[6], Section[9]
+            StringOffset = Sections[Link][4]
+            for SymbolOffset in range(Offset, Offset + Size, EntSize):
+                if Is64Bit:
+                    NameOffset, Info, _, _, Value, SymbolSize = struct.unpack_from(SymbolFormat, Data, SymbolOffset)
+                else:
+                    NameOffset, Value, SymbolSize, Info, _, _ = struct.unpack_from(SymbolFormat, Data, SymbolOffset)
+                if (Info & 0xF) != STT_FUNC or Value == 0:
+                    continue
+
+                End = Data.index(b'\0', StringOffset + NameOffset)
+                Name = Data[StringOffset + NameOffset:End].decode('ascii', 'replace')
+                self.Functions.append((Value, SymbolSize, Name))
+
+        self.Functions.sort()
+
+    def Name(self, Address):
+        Low, High = 0, len(self.Functions)
+        while Low < High:
+            Middle = (Low + High) // 2
+            if self.Functions[Middle][0] <= Address:
+                Low = Middle + 1
+            else:
+                High = Middle
+
+        if Low > 0:
+            Value, Size, Name = self.Functions[Low - 1]
+            if Address == Value:
+                return Name
+            if Address < Value + Size:
+                return '%s+0x%x' % (Name, Address - Value)
+
+        return '0x%x' % Address
+
+
+def SourceLines(ElfPath, Addresses):
+    """Map addresses to 'file:line' with addr2line, empty if it is missing."""
+    try:
+        Output = subprocess.run(['addr2line', '-e', ElfPath] + ['0x%x' % Address for Address in Addresses],
+                                capture_output=True, text=True, check=True).stdout.split('\n')
+    except (OSError, subprocess.CalledProcessError):
+        return {}
+
+    return dict(zip(Addresses, Output))
+
+
+def FindProfile(Data):
+    """Return (offset, fields) of the first valid SHIM_PROFILE_BUFFER."""
+    Offset = Data.find(SHIM_PROFILE_SIGNATURE)
+    while Offset >= 0:
+        if Offset + PROFILE_BUFFER_SIZE <= len(Data):
+            Fields = struct.unpack_from(PROFILE_BUFFER_FORMAT, Data, Offset)
+            if Fields[1] != 0:
+                return Offset, Fields
+        Offset = Data.find(SHIM_PROFILE_SIGNATURE, Offset + 1)
+
+    return None, None
+
+
+def ReadEntries(Data, Offset, EntryCount, Recorded):
+    """Return the ring entries from the oldest to the newest."""
+    if Recorded <= EntryCount:
+        Indexes = range(Recorded)
+    else:
+        First = Recorded % EntryCount
+        Indexes = list(range(First, EntryCount)) + list(range(First))
+
+    Entries = []
+    for Index in Indexes:
+        EntryOffset = Offset + PROFILE_BUFFER_SIZE + Index * PROFILE_ENTRY_SIZE
+        if EntryOffset + PROFILE_ENTRY_SIZE > len(Data):
+            print('The ring runs out of the dump at entry %d' % Index)
+            break
+        Function, Depth, _, Cycles = struct.unpack_from(PROFILE_ENTRY_FORMAT, Data, EntryOffset)
+        Entries.append((Function, Depth, Cycles))
+
+    return Entries
+
+
+def Summarize(Entries):
+    """Sum the calls, inclusive, self and longest cycles of every function.
+
+    A function returns after every function it called, so the cycles of the
+    returns one level deeper since its last sibling are its callees'.
+    """
+    Functions = {}
+    Callees = {}
+    for Function, Depth, Cycles in Entries:
+        Self = max(Cycles - Callees.pop(Depth + 1, 0), 0)
+        Callees[Depth] = Callees.get(Depth, 0) + Cycles
+
+        Calls, Inclusive, SelfTotal, Longest = Functions.get(Function, (0, 0, 0, 0))
+        Functions[Function] = (Calls + 1, Inclusive + Cycles, SelfTotal + Self, max(Longest, Cycles))
+
+    return Functions
+
+
+def Main():
+    Parser = argparse.ArgumentParser(description='Symbolize the function profile of a PROFILE=1 shim build.')
+    Parser.add_argument('Dump', help='raw memory dump or profile buffer file')
+    Parser.add_argument('-e', '--elf', required=True, help='the ShimLayer.elf of the profiled build')
+    Parser.add_argument('-b', '--base', type=lambda Value: int(Value, 0), default=0,
+                        help='physical address of the first byte of the dump, 0 by default')
+    Parser.add_argument('-n', '--count', type=int, default=40, help='the number of functions to print, 40 by default')
+    Parser.add_argument('-s', '--sort', choices=['inclusive', 'self', 'calls'], default='self',
+                        help='the column to sort the functions by, self by default')
+    Parser.add_argument('-l', '--lines', action='store_true', help='print the source line of each function')
+    Parser.add_argument('-t', '--trace', action='store_true', help='print every recorded return in order')
+    Args = Parser.parse_args()
+
+    with open(Args.Dump, 'rb') as File:
+        Data = File.read()
+
+    Offset, Fields = FindProfile(Data)
+    if Offset is None:
+        print('No profile buffer found')
+        return 1
+
+    _, EntryCount, _, Recorded, Dropped, ImageBase, LinkBase = Fields
+    Symbols = ElfSymbols(Args.elf)
+    Entries = ReadEntries(Data, Offset, EntryCount, Recorded)
+
+    print('Profile buffer at 0x%x' % (Args.base + Offset))
+    print('  Image base             0x%x, linked at 0x%x' % (ImageBase, LinkBase))
+    print('  Recorded returns       %d, %d kept' % (Recorded, len(Entries)))
+    print('  Dropped returns        %d' % Dropped)
+    if Recorded > EntryCount:
+        print('  The ring wrapped, the earliest returns are lost')
+    print()
+
+    if Args.trace:
+        for Function, Depth, Cycles in Entries:
+            print('%s%s %d' % ('  ' * Depth, Symbols.Name(LinkBase + Function), Cycles))
+        print()
+
+    Functions = Summarize(Entries)
+    Column = {'calls': 0, 'inclusive': 1, 'self': 2}[Args.sort]
+    Sorted = sorted(Functions, key=lambda Function: -Functions[Function][Column])[:Args.count]
+    Lines = SourceLines(Args.elf, [LinkBase + Function for Function in Sorted]) if Args.lines else {}
+
+    print('%-40s %8s %16s %16s %14s' % ('Function', 'Calls', 'Inclusive', 'Self', 'Longest'))
+    for Function in Sorted:
+        Calls, Inclusive, Self, Longest = Functions[Function]
+        Address = LinkBase + Function
+        print('%-40s %8d %16d %16d %14d' % (Symbols.Name(Address), Calls, Inclusive, Self, Longest))
+        if Address in Lines:
+            print('  %s' % Lines[Address])
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(Main())
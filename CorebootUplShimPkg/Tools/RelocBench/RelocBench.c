@@ -0,0 +1,625 @@
+/** @file
+  Host benchmark of the ELF loader relocation paths.
+
+  Generates a DYN ELF image whose data words are all covered by R_*_RELATIVE
+  relocations, in a RELA table or in a compact RELR one, loads it with the
+  ElfLib of the shim built for the host and reports the time per relocation.
+  The RELA table is loaded with and without DT_RELACOUNT, to compare the
+  relative relocation loop with the generic one.
+  The same image without its relocation table is loaded as the baseline, so
+  the segment copy is not charged to the relocations. Every relocated word is
+  checked after the first load.
+
+  Copyright (c) 2022, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#undef NULL
+#include <Base.h>
+#include <BaseLib.h>
+#include "ElfLibInternal.h"
+
+#define FORMAT_RELA          0
+#define FORMAT_RELR          1
+#define FORMAT_RELA_NOCOUNT  2
+
+#define SECTION_NULL      0
+#define SECTION_DYNAMIC   1
+#define SECTION_RELOC     2
+#define SECTION_DATA      3
+#define SECTION_SHSTRTAB  4
+#define SECTION_COUNT     5
+
+STATIC CONST CHAR8  mShStrTab[] = "\0.dynamic\0.rela.dyn\0.data\0.shstrtab";
+STATIC CONST CHAR8  mRelrName[] = ".relr.dyn";
+
+typedef struct {
+  UINT32    Class;
+  UINT32    Format;
+  UINT32    Count;
+  BOOLEAN   Relocate;
+} IMAGE_OPTIONS;
+
+typedef struct {
+  UINT8    *Buffer;
+  UINTN    WordSize;
+  UINTN    EhdrSize;
+  UINTN    PhdrSize;
+  UINTN    ShdrSize;
+  UINTN    RelaEntrySize;
+  UINTN    DynOffset;
+  UINTN    DynSize;
+  UINTN    RelocOffset;
+  UINTN    RelocSize;
+  UINTN    DataOffset;
+  UINTN    StrOffset;
+  UINTN    ShOffset;
+} IMAGE_LAYOUT;
+
+typedef struct {
+  UINT8    *Buffer;
+  UINTN    Size;
+  UINTN    DataOffset;
+} GENERATED_IMAGE;
+
+/**
+  Return the addend of the relocation of data word Index.
+
+  The words point back into the image at varying offsets.
+**/
+STATIC
+UINT64
+GetAddend (
+  IN UINT32  Index,
+  IN UINTN   ImageSize
+  )
+{
+  return ((UINT64)Index * 2654435761U) % ImageSize;
+}
+
+/**
+  Store a field of the size of the ELF class.
+**/
+STATIC
+VOID
+PutWord (
+  IN UINT8   *Buffer,
+  IN UINT32  Class,
+  IN UINT64  Value
+  )
+{
+  if (Class == ELFCLASS32) {
+    *(UINT32 *)Buffer = (UINT32)Value;
+  } else {
+    *(UINT64 *)Buffer = Value;
+  }
+}
+
+/**
+  Write the ELF header, program headers and section headers of an ELF32
+  benchmark image.
+
+  @param  Options          The image to generate.
+  @param  Layout           The layout of the image.
+**/
+STATIC
+VOID
+WriteElf32Headers (
+  IN IMAGE_OPTIONS  *Options,
+  IN IMAGE_LAYOUT   *Layout
+  )
+{
+  Elf32_Ehdr  *Ehdr;
+  Elf32_Phdr  *Phdr;
+  Elf32_Shdr  *Shdr;
+
+  Ehdr = (Elf32_Ehdr *)Layout->Buffer;
+  CopyMem (Ehdr->e_ident, ELFMAG, SELFMAG);
+  Ehdr->e_ident[EI_CLASS]   = ELFCLASS32;
+  Ehdr->e_ident[EI_DATA]    = ELFDATA2LSB;
+  Ehdr->e_ident[EI_VERSION] = EV_CURRENT;
+  Ehdr->e_type              = ET_DYN;
+  Ehdr->e_machine           = EM_386;
+  Ehdr->e_version           = EV_CURRENT;
+  Ehdr->e_phoff             = (Elf32_Off)Layout->EhdrSize;
+  Ehdr->e_shoff             = (Elf32_Off)Layout->ShOffset;
+  Ehdr->e_ehsize            = (Elf32_Half)Layout->EhdrSize;
+  Ehdr->e_phentsize         = (Elf32_Half)Layout->PhdrSize;
+  Ehdr->e_phnum             = 2;
+  Ehdr->e_shentsize         = (Elf32_Half)Layout->ShdrSize;
+  Ehdr->e_shnum             = SECTION_COUNT;
+  Ehdr->e_shstrndx          = SECTION_SHSTRTAB;
+
+  Phdr             = (Elf32_Phdr *)(Layout->Buffer + Layout->EhdrSize);
+  Phdr[0].p_type   = PT_LOAD;
+  Phdr[0].p_filesz = Phdr[0].p_memsz = (Elf32_Word)Layout->ShOffset;
+  Phdr[0].p_flags  = PF_R | PF_W;
+  Phdr[0].p_align  = SIZE_4KB;
+  Phdr[1].p_type   = PT_DYNAMIC;
+  Phdr[1].p_offset = Phdr[1].p_vaddr = Phdr[1].p_paddr = (Elf32_Off)Layout->DynOffset;
+  Phdr[1].p_filesz = Phdr[1].p_memsz = (Elf32_Word)Layout->DynSize;
+  Phdr[1].p_flags  = PF_R | PF_W;
+  Phdr[1].p_align  = (Elf32_Word)Layout->WordSize;
+
+  Shdr = (Elf32_Shdr *)(Layout->Buffer + Layout->ShOffset);
+  Shdr[SECTION_DYNAMIC].sh_name    = 1;
+  Shdr[SECTION_DYNAMIC].sh_type    = SHT_DYNAMIC;
+  Shdr[SECTION_DYNAMIC].sh_flags   = SHF_ALLOC | SHF_WRITE;
+  Shdr[SECTION_DYNAMIC].sh_addr    = Shdr[SECTION_DYNAMIC].sh_offset = (Elf32_Off)Layout->DynOffset;
+  Shdr[SECTION_DYNAMIC].sh_size    = (Elf32_Word)Layout->DynSize;
+  Shdr[SECTION_DYNAMIC].sh_entsize = (Elf32_Word)(2 * Layout->WordSize);
+  Shdr[SECTION_RELOC].sh_name      = (Options->Format != FORMAT_RELR) ? 10 : (Elf32_Word)sizeof (mShStrTab);
+  Shdr[SECTION_RELOC].sh_type      = (Options->Format != FORMAT_RELR) ? SHT_RELA : SHT_RELR;
+  Shdr[SECTION_RELOC].sh_flags     = SHF_ALLOC;
+  Shdr[SECTION_RELOC].sh_addr      = Shdr[SECTION_RELOC].sh_offset = (Elf32_Off)Layout->RelocOffset;
+  Shdr[SECTION_RELOC].sh_size      = (Elf32_Word)Layout->RelocSize;
+  Shdr[SECTION_RELOC].sh_entsize   = (Elf32_Word)((Options->Format != FORMAT_RELR) ? Layout->RelaEntrySize : Layout->WordSize);
+  Shdr[SECTION_DATA].sh_name       = 20;
+  Shdr[SECTION_DATA].sh_type       = SHT_PROGBITS;
+  Shdr[SECTION_DATA].sh_flags      = SHF_ALLOC | SHF_WRITE;
+  Shdr[SECTION_DATA].sh_addr       = Shdr[SECTION_DATA].sh_offset = (Elf32_Off)Layout->DataOffset;
+  Shdr[SECTION_DATA].sh_size       = (Elf32_Word)(Options->Count * Layout->WordSize);
+  Shdr[SECTION_SHSTRTAB].sh_name   = 26;
+  Shdr[SECTION_SHSTRTAB].sh_type   = SHT_STRTAB;
+  Shdr[SECTION_SHSTRTAB].sh_offset = (Elf32_Off)Layout->StrOffset;
+  Shdr[SECTION_SHSTRTAB].sh_size   = (Elf32_Word)(sizeof (mShStrTab) + sizeof (mRelrName));
+}
+
+/**
+  Write the ELF header, program headers and section headers of an ELF64
+  benchmark image.
+
+  @param  Options          The image to generate.
+  @param  Layout           The layout of the image.
+**/
+STATIC
+VOID
+WriteElf64Headers (
+  IN IMAGE_OPTIONS  *Options,
+  IN IMAGE_LAYOUT   *Layout
+  )
+{
+  Elf64_Ehdr  *Ehdr;
+  Elf64_Phdr  *Phdr;
+  Elf64_Shdr  *Shdr;
+
+  Ehdr = (Elf64_Ehdr *)Layout->Buffer;
+  CopyMem (Ehdr->e_ident, ELFMAG, SELFMAG);
+  Ehdr->e_ident[EI_CLASS]   = ELFCLASS64;
+  Ehdr->e_ident[EI_DATA]    = ELFDATA2LSB;
+  Ehdr->e_ident[EI_VERSION] = EV_CURRENT;
+  Ehdr->e_type              = ET_DYN;
+  Ehdr->e_machine           = EM_X86_64;
+  Ehdr->e_version           = EV_CURRENT;
+  Ehdr->e_phoff             = Layout->EhdrSize;
+  Ehdr->e_shoff             = Layout->ShOffset;
+  Ehdr->e_ehsize            = (Elf64_Half)Layout->EhdrSize;
+  Ehdr->e_phentsize         = (Elf64_Half)Layout->PhdrSize;
+  Ehdr->e_phnum             = 2;
+  Ehdr->e_shentsize         = (Elf64_Half)Layout->ShdrSize;
+  Ehdr->e_shnum             = SECTION_COUNT;
+  Ehdr->e_shstrndx          = SECTION_SHSTRTAB;
+
+  Phdr             = (Elf64_Phdr *)(Layout->Buffer + Layout->EhdrSize);
+  Phdr[0].p_type   = PT_LOAD;
+  Phdr[0].p_filesz = Phdr[0].p_memsz = Layout->ShOffset;
+  Phdr[0].p_flags  = PF_R | PF_W;
+  Phdr[0].p_align  = SIZE_4KB;
+  Phdr[1].p_type   = PT_DYNAMIC;
+  Phdr[1].p_offset = Phdr[1].p_vaddr = Phdr[1].p_paddr = Layout->DynOffset;
+  Phdr[1].p_filesz = Phdr[1].p_memsz = Layout->DynSize;
+  Phdr[1].p_flags  = PF_R | PF_W;
+  Phdr[1].p_align  = Layout->WordSize;
+
+  Shdr = (Elf64_Shdr *)(Layout->Buffer + Layout->ShOffset);
+  Shdr[SECTION_DYNAMIC].sh_name    = 1;
+  Shdr[SECTION_DYNAMIC].sh_type    = SHT_DYNAMIC;
+  Shdr[SECTION_DYNAMIC].sh_flags   = SHF_ALLOC | SHF_WRITE;
+  Shdr[SECTION_DYNAMIC].sh_addr    = Shdr[SECTION_DYNAMIC].sh_offset = Layout->DynOffset;
+  Shdr[SECTION_DYNAMIC].sh_size    = Layout->DynSize;
+  Shdr[SECTION_DYNAMIC].sh_entsize = 2 * Layout->WordSize;
+  Shdr[SECTION_RELOC].sh_name      = (Options->Format != FORMAT_RELR) ? 10 : (Elf64_Word)sizeof (mShStrTab);
+  Shdr[SECTION_RELOC].sh_type      = (Options->Format != FORMAT_RELR) ? SHT_RELA : SHT_RELR;
+  Shdr[SECTION_RELOC].sh_flags     = SHF_ALLOC;
+  Shdr[SECTION_RELOC].sh_addr      = Shdr[SECTION_RELOC].sh_offset = Layout->RelocOffset;
+  Shdr[SECTION_RELOC].sh_size      = Layout->RelocSize;
+  Shdr[SECTION_RELOC].sh_entsize   = (Options->Format != FORMAT_RELR) ? Layout->RelaEntrySize : Layout->WordSize;
+  Shdr[SECTION_DATA].sh_name       = 20;
+  Shdr[SECTION_DATA].sh_type       = SHT_PROGBITS;
+  Shdr[SECTION_DATA].sh_flags      = SHF_ALLOC | SHF_WRITE;
+  Shdr[SECTION_DATA].sh_addr       = Shdr[SECTION_DATA].sh_offset = Layout->DataOffset;
+  Shdr[SECTION_DATA].sh_size       = Options->Count * Layout->WordSize;
+  Shdr[SECTION_SHSTRTAB].sh_name   = 26;
+  Shdr[SECTION_SHSTRTAB].sh_type   = SHT_STRTAB;
+  Shdr[SECTION_SHSTRTAB].sh_offset = Layout->StrOffset;
+  Shdr[SECTION_SHSTRTAB].sh_size   = sizeof (mShStrTab) + sizeof (mRelrName);
+}
+
+/**
+  Generate the benchmark image.
+
+  The layout is the ELF header, two program headers, the dynamic section,
+  the relocation table, the data words, the section name table and the
+  section headers. One PT_LOAD segment covers the whole file at address 0.
+
+  @param  Options          The image to generate.
+  @param  Image            Return the image.
+
+  @retval SUCCESS          The image is generated.
+  @retval ABORTED          No memory for the image.
+**/
+STATIC
+RETURN_STATUS
+GenerateImage (
+  IN  IMAGE_OPTIONS    *Options,
+  OUT GENERATED_IMAGE  *Image
+  )
+{
+  IMAGE_LAYOUT  Layout;
+  UINTN         RelrCount;
+  UINTN         FileSize;
+  UINT8         *Buffer;
+  UINT8         *Entry;
+  UINT32        Index;
+  UINT32        Bit;
+  UINT32        BitmapBits;
+  UINT64        Bitmap;
+  UINT64        Dyn[8][2];
+  UINTN         DynCount;
+
+  Layout.WordSize      = (Options->Class == ELFCLASS32) ? sizeof (UINT32) : sizeof (UINT64);
+  Layout.EhdrSize      = (Options->Class == ELFCLASS32) ? sizeof (Elf32_Ehdr) : sizeof (Elf64_Ehdr);
+  Layout.PhdrSize      = (Options->Class == ELFCLASS32) ? sizeof (Elf32_Phdr) : sizeof (Elf64_Phdr);
+  Layout.ShdrSize      = (Options->Class == ELFCLASS32) ? sizeof (Elf32_Shdr) : sizeof (Elf64_Shdr);
+  Layout.RelaEntrySize = (Options->Class == ELFCLASS32) ? sizeof (Elf32_Rela) : sizeof (Elf64_Rela);
+
+  //
+  // The RELR address entry relocates the first word, each bitmap after it
+  // the next 31 or 63, as the linker packs contiguous relocations.
+  //
+  BitmapBits = (UINT32)(Layout.WordSize * 8 - 1);
+  RelrCount  = 1 + (Options->Count - 1 + BitmapBits - 1) / BitmapBits;
+
+  Layout.RelocSize = 0;
+  if (Options->Relocate) {
+    Layout.RelocSize = (Options->Format != FORMAT_RELR) ? Options->Count * Layout.RelaEntrySize : RelrCount * Layout.WordSize;
+  }
+
+  Layout.DynSize     = 8 * 2 * Layout.WordSize;
+  Layout.DynOffset   = ALIGN_VALUE (Layout.EhdrSize + 2 * Layout.PhdrSize, 16);
+  Layout.RelocOffset = Layout.DynOffset + Layout.DynSize;
+  Layout.DataOffset  = ALIGN_VALUE (Layout.RelocOffset + Layout.RelocSize, 16);
+  Layout.StrOffset   = Layout.DataOffset + Options->Count * Layout.WordSize;
+  Layout.ShOffset    = ALIGN_VALUE (Layout.StrOffset + sizeof (mShStrTab) + sizeof (mRelrName), 16);
+  FileSize           = Layout.ShOffset + SECTION_COUNT * Layout.ShdrSize;
+
+  Buffer = calloc (1, FileSize);
+  if (Buffer == NULL) {
+    return ABORTED;
+  }
+
+  //
+  // The dynamic section, RELA or RELR tags only when relocating.
+  //
+  DynCount = 0;
+  if (Options->Relocate && (Options->Format != FORMAT_RELR)) {
+    Dyn[DynCount][0] = DT_RELA;
+    Dyn[DynCount][1] = Layout.RelocOffset;
+    DynCount++;
+    Dyn[DynCount][0] = DT_RELASZ;
+    Dyn[DynCount][1] = Layout.RelocSize;
+    DynCount++;
+    Dyn[DynCount][0] = DT_RELAENT;
+    Dyn[DynCount][1] = Layout.RelaEntrySize;
+    DynCount++;
+    if (Options->Format == FORMAT_RELA) {
+      Dyn[DynCount][0] = DT_RELACOUNT;
+      Dyn[DynCount][1] = Options->Count;
+      DynCount++;
+    }
+  } else if (Options->Relocate) {
+    Dyn[DynCount][0] = DT_RELR;
+    Dyn[DynCount][1] = Layout.RelocOffset;
+    DynCount++;
+    Dyn[DynCount][0] = DT_RELRSZ;
+    Dyn[DynCount][1] = Layout.RelocSize;
+    DynCount++;
+    Dyn[DynCount][0] = DT_RELRENT;
+    Dyn[DynCount][1] = Layout.WordSize;
+    DynCount++;
+  }
+
+  Dyn[DynCount][0] = DT_NULL;
+  Dyn[DynCount][1] = 0;
+  DynCount++;
+  for (Index = 0; Index < DynCount; Index++) {
+    PutWord (Buffer + Layout.DynOffset + Index * 2 * Layout.WordSize, Options->Class, Dyn[Index][0]);
+    PutWord (Buffer + Layout.DynOffset + Index * 2 * Layout.WordSize + Layout.WordSize, Options->Class, Dyn[Index][1]);
+  }
+
+  //
+  // A RELA entry carries the addend, with RELR the word holds it.
+  //
+  for (Index = 0; Index < Options->Count; Index++) {
+    if (Options->Relocate && (Options->Format != FORMAT_RELR)) {
+      Entry = Buffer + Layout.RelocOffset + Index * Layout.RelaEntrySize;
+      if (Options->Class == ELFCLASS32) {
+        ((Elf32_Rela *)Entry)->r_offset = (Elf32_Addr)(Layout.DataOffset + Index * Layout.WordSize);
+        ((Elf32_Rela *)Entry)->r_info   = ELF32_R_INFO (0, R_386_RELATIVE);
+        ((Elf32_Rela *)Entry)->r_addend = (Elf32_Sword)GetAddend (Index, FileSize);
+      } else {
+        ((Elf64_Rela *)Entry)->r_offset = Layout.DataOffset + Index * Layout.WordSize;
+        ((Elf64_Rela *)Entry)->r_info   = ELF64_R_INFO ((UINT64)0, R_X86_64_RELATIVE);
+        ((Elf64_Rela *)Entry)->r_addend = (Elf64_Sxword)GetAddend (Index, FileSize);
+      }
+    } else {
+      PutWord (Buffer + Layout.DataOffset + Index * Layout.WordSize, Options->Class, GetAddend (Index, FileSize));
+    }
+  }
+
+  if (Options->Relocate && (Options->Format == FORMAT_RELR)) {
+    Entry = Buffer + Layout.RelocOffset;
+    PutWord (Entry, Options->Class, Layout.DataOffset);
+    for (Index = 1; Index < Options->Count; Index += BitmapBits) {
+      Entry += Layout.WordSize;
+      Bitmap = 1;
+      for (Bit = 0; (Bit < BitmapBits) && (Index + Bit < Options->Count); Bit++) {
+        Bitmap |= LShiftU64 (1, Bit + 1);
+      }
+
+      PutWord (Entry, Options->Class, Bitmap);
+    }
+  }
+
+  CopyMem (Buffer + Layout.StrOffset, mShStrTab, sizeof (mShStrTab));
+  CopyMem (Buffer + Layout.StrOffset + sizeof (mShStrTab), mRelrName, sizeof (mRelrName));
+
+  Layout.Buffer = Buffer;
+  if (Options->Class == ELFCLASS32) {
+    WriteElf32Headers (Options, &Layout);
+  } else {
+    WriteElf64Headers (Options, &Layout);
+  }
+
+  Image->Buffer     = Buffer;
+  Image->Size       = FileSize;
+  Image->DataOffset = Layout.DataOffset;
+  return SUCCESS;
+}
+
+/**
+  Return the monotonic time in nanoseconds.
+**/
+STATIC
+UINT64
+GetTimeNs (
+  VOID
+  )
+{
+  struct timespec  Now;
+
+  clock_gettime (CLOCK_MONOTONIC, &Now);
+  return (UINT64)Now.tv_sec * 1000000000ULL + (UINT64)Now.tv_nsec;
+}
+
+/**
+  Load the image Iterations times and return the fastest load.
+
+  @param  Image            The image to load.
+  @param  Iterations       The number of loads.
+  @param  ImageAddress     Return where the image was loaded.
+  @param  Time             Return the fastest load in nanoseconds.
+
+  @retval SUCCESS          The image is loaded.
+  @return Others           ParseElfImage() or LoadElfImage() failed.
+**/
+STATIC
+RETURN_STATUS
+TimeLoad (
+  IN  GENERATED_IMAGE  *Image,
+  IN  UINT32           Iterations,
+  OUT UINT8            **ImageAddress,
+  OUT UINT64           *Time
+  )
+{
+  ELF_IMAGE_CONTEXT  ElfCt;
+  RETURN_STATUS      Status;
+  UINT64             Start;
+  UINT64             Elapsed;
+  UINT32             Index;
+
+  Status = ParseElfImage (Image->Buffer, &ElfCt);
+  if (ERROR (Status)) {
+    return Status;
+  }
+
+  ElfCt.ImageAddress = aligned_alloc (SIZE_4KB, ALIGN_VALUE (ElfCt.ImageSize, SIZE_4KB));
+  if (ElfCt.ImageAddress == NULL) {
+    return ABORTED;
+  }
+
+  *Time = MAX_UINT64;
+  for (Index = 0; Index < Iterations; Index++) {
+    Start  = GetTimeNs ();
+    Status = LoadElfImage (&ElfCt);
+    if (ERROR (Status)) {
+      free (ElfCt.ImageAddress);
+      return Status;
+    }
+
+    Elapsed = GetTimeNs () - Start;
+    *Time   = MIN (*Time, Elapsed);
+  }
+
+  *ImageAddress = ElfCt.ImageAddress;
+  return SUCCESS;
+}
+
+/**
+  Check every relocated word of a loaded image.
+
+  @return The number of words with a wrong value.
+**/
+STATIC
+UINT32
+VerifyImage (
+  IN IMAGE_OPTIONS    *Options,
+  IN GENERATED_IMAGE  *Image,
+  IN UINT8            *ImageAddress
+  )
+{
+  UINT32  Index;
+  UINT32  Errors;
+  UINT64  Expected;
+  UINT64  Actual;
+
+  Errors = 0;
+  for (Index = 0; Index < Options->Count; Index++) {
+    Expected = (UINTN)ImageAddress + GetAddend (Index, Image->Size);
+    if (Options->Class == ELFCLASS32) {
+      Expected = (UINT32)Expected;
+      Actual   = ((UINT32 *)(ImageAddress + Image->DataOffset))[Index];
+    } else {
+      Actual = ((UINT64 *)(ImageAddress + Image->DataOffset))[Index];
+    }
+
+    if (Actual != Expected) {
+      Errors++;
+    }
+  }
+
+  return Errors;
+}
+
+STATIC
+VOID
+Usage (
+  VOID
+  )
+{
+  printf (
+    "Usage: RelocBench [-c 32|64] [-f rela|relr|rela-nocount] [-n relocations] [-i iterations]\n"
+    "  -c  ELF class of the generated image, 64 by default\n"
+    "  -f  relocation table format, all when not given, rela-nocount is a\n"
+    "      RELA table without DT_RELACOUNT\n"
+    "  -n  number of relative relocations, 100000 by default\n"
+    "  -i  number of timed loads, the fastest is reported, 50 by default\n"
+    );
+}
+
+int
+main (
+  int   Argc,
+  char  **Argv
+  )
+{
+  IMAGE_OPTIONS    Options;
+  GENERATED_IMAGE  Image;
+  GENERATED_IMAGE  Baseline;
+  RETURN_STATUS    Status;
+  UINT8            *ImageAddress;
+  UINT8            *BaselineAddress;
+  UINT64           Time;
+  UINT64           BaselineTime;
+  UINT32           Iterations;
+  UINT32           Errors;
+  UINT32           First;
+  UINT32           Last;
+  UINT32           Format;
+  int              Index;
+
+  static CONST CHAR8  *FormatNames[] = { "rela", "relr", "rela-nocount" };
+
+  Options.Class = ELFCLASS64;
+  Options.Count = 100000;
+  Iterations    = 50;
+  First         = FORMAT_RELA;
+  Last          = FORMAT_RELA_NOCOUNT;
+  for (Index = 1; Index < Argc; Index++) {
+    if ((Index + 1 < Argc) && (strcmp (Argv[Index], "-c") == 0)) {
+      Options.Class = (strcmp (Argv[++Index], "32") == 0) ? ELFCLASS32 : ELFCLASS64;
+    } else if ((Index + 1 < Argc) && (strcmp (Argv[Index], "-f") == 0)) {
+      Index++;
+      for (First = FORMAT_RELA; First <= FORMAT_RELA_NOCOUNT; First++) {
+        if (strcmp (Argv[Index], FormatNames[First]) == 0) {
+          break;
+        }
+      }
+
+      if (First > FORMAT_RELA_NOCOUNT) {
+        Usage ();
+        return 1;
+      }
+
+      Last = First;
+    } else if ((Index + 1 < Argc) && (strcmp (Argv[Index], "-n") == 0)) {
+      Options.Count = (UINT32)strtoul (Argv[++Index], NULL, 0);
+    } else if ((Index + 1 < Argc) && (strcmp (Argv[Index], "-i") == 0)) {
+      Iterations = (UINT32)strtoul (Argv[++Index], NULL, 0);
+    } else {
+      Usage ();
+      return 1;
+    }
+  }
+
+  if ((Options.Count == 0) || (Iterations == 0)) {
+    Usage ();
+    return 1;
+  }
+
+  printf ("ELF%u image, %u relative relocations, fastest of %u loads\n", Options.Class == ELFCLASS32 ? 32 : 64, Options.Count, Iterations);
+  for (Format = First; Format <= Last; Format++) {
+    Options.Format   = Format;
+    Options.Relocate = FALSE;
+    Status           = GenerateImage (&Options, &Baseline);
+    if (!ERROR (Status)) {
+      Options.Relocate = TRUE;
+      Status           = GenerateImage (&Options, &Image);
+    }
+
+    if (ERROR (Status)) {
+      fprintf (stderr, "No memory for the image\n");
+      return 1;
+    }
+
+    Status = TimeLoad (&Baseline, Iterations, &BaselineAddress, &BaselineTime);
+    if (!ERROR (Status)) {
+      Status = TimeLoad (&Image, Iterations, &ImageAddress, &Time);
+    }
+
+    if (ERROR (Status)) {
+      fprintf (stderr, "%s: loading the image failed, status 0x%lx\n", FormatNames[Format], (unsigned long)Status);
+      return 1;
+    }
+
+    //
+    // Every load copies the segment again, the image holds one relocation.
+    //
+    Errors = VerifyImage (&Options, &Image, ImageAddress);
+    printf (
+      "%-12s: %8lu byte table, load %8.3f ms, without relocations %8.3f ms, %6.2f ns per relocation%s\n",
+      FormatNames[Format],
+      (unsigned long)(Image.Size - Baseline.Size),
+      Time / 1e6,
+      BaselineTime / 1e6,
+      (Time > BaselineTime) ? (double)(Time - BaselineTime) / Options.Count : 0.0,
+      (Errors != 0) ? ", WRONG VALUES" : ""
+      );
+
+    free (ImageAddress);
+    free (BaselineAddress);
+    free (Image.Buffer);
+    free (Baseline.Buffer);
+    if (Errors != 0) {
+      return 1;
+    }
+  }
+
+  return 0;
+}